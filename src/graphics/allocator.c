@@ -0,0 +1,434 @@
+#include "allocator.h"
+#include "range_allocator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+
+#define ALLOCATOR_DEFAULT_BLOCK_SIZE (64ull * 1024 * 1024)
+#define ALLOCATOR_SMALL_HEAP_SIZE (1024ull * 1024 * 1024)
+#define ALLOCATOR_FALLBACK_BUDGET_PERCENT 80
+
+typedef struct MemoryBlock {
+    VkDeviceMemory memory;
+    void* mapped; // Whole-block mapping for host visible types, kept for the block's lifetime
+    RangeAllocator* ranges;
+    u64 size;
+    u32 memory_type;
+    u32 allocation_count;
+    bool dedicated; // Holds exactly one allocation and is given back once it's released
+    bool optimal_tiling; // Only holds optimal tiling images, linear resources (buffers) live in other blocks
+} MemoryBlock;
+
+typedef struct {
+    MemoryBlock** blocks;
+    u32 block_count;
+    u32 block_capacity;
+    u64 block_size; // Preferred size of new shared blocks for this type
+} MemoryTypePool;
+
+typedef struct Allocator {
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    u64 non_coherent_atom_size;
+    MemoryTypePool pools[VK_MAX_MEMORY_TYPES];
+    AllocatorHeapStats heap_stats[VK_MAX_MEMORY_HEAPS];
+} Allocator;
+
+static u32 memory_type_heap(Allocator* allocator, u32 memory_type) {
+    return allocator->memory_properties.memoryTypes[memory_type].heapIndex;
+}
+
+static bool memory_type_has(Allocator* allocator, u32 memory_type, VkMemoryPropertyFlags flags) {
+    return (allocator->memory_properties.memoryTypes[memory_type].propertyFlags & flags) == flags;
+}
+
+static u64 align_up(u64 value, u64 alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static MemoryBlock* allocator_create_block(Device* device, Allocator* allocator, u32 memory_type, u64 size, bool dedicated, bool optimal_tiling) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    // Any buffer in the block might want its device address, and the flag has to be set on the memory
+    VkMemoryAllocateFlagsInfo memory_flags_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+        .pNext = NULL,
+        .flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT,
+        .deviceMask = 0
+    };
+
+    VkMemoryAllocateInfo memory_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = &memory_flags_info,
+        .allocationSize = size,
+        .memoryTypeIndex = memory_type
+    };
+
+    VkDeviceMemory memory = NULL;
+    VkResult create_memory = vkAllocateMemory(device_handle, &memory_info, NULL, &memory);
+    if (create_memory != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate vulkan memory block of %llu bytes for type %d! %d\n",
+            (unsigned long long)size, memory_type, create_memory);
+        return NULL;
+    }
+
+    void* mapped = NULL;
+    if (memory_type_has(allocator, memory_type, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+        VkResult map_memory = vkMapMemory(device_handle, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+        if (map_memory != VK_SUCCESS) {
+            fprintf(stderr, "Failed to map vulkan memory block for type %d! %d\n", memory_type, map_memory);
+            vkFreeMemory(device_handle, memory, NULL);
+            return NULL;
+        }
+    }
+
+    MemoryBlock* block = malloc(sizeof(MemoryBlock));
+    block->memory = memory;
+    block->mapped = mapped;
+    block->size = size;
+    block->memory_type = memory_type;
+    block->allocation_count = 0;
+    block->dedicated = dedicated;
+    block->optimal_tiling = optimal_tiling;
+    range_allocator_new(size, &block->ranges);
+
+    MemoryTypePool* pool = &allocator->pools[memory_type];
+    if (pool->block_count == pool->block_capacity) {
+        pool->block_capacity = pool->block_capacity == 0 ? 4 : pool->block_capacity * 2;
+        pool->blocks = realloc(pool->blocks, pool->block_capacity * sizeof(MemoryBlock*));
+    }
+    pool->blocks[pool->block_count++] = block;
+
+    AllocatorHeapStats* stats = &allocator->heap_stats[memory_type_heap(allocator, memory_type)];
+    stats->reserved_bytes += size;
+    stats->block_count++;
+    return block;
+}
+
+static void allocator_destroy_block(Device* device, Allocator* allocator, MemoryBlock* block) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    MemoryTypePool* pool = &allocator->pools[block->memory_type];
+    for (u32 i = 0; i < pool->block_count; i++) {
+        if (pool->blocks[i] == block) {
+            pool->blocks[i] = pool->blocks[pool->block_count - 1];
+            pool->block_count--;
+            break;
+        }
+    }
+
+    AllocatorHeapStats* stats = &allocator->heap_stats[memory_type_heap(allocator, block->memory_type)];
+    stats->reserved_bytes -= block->size;
+    stats->block_count--;
+
+    if (block->mapped) {
+        vkUnmapMemory(device_handle, block->memory);
+        block->mapped = NULL;
+    }
+    vkFreeMemory(device_handle, block->memory, NULL);
+    range_allocator_free(block->ranges);
+    free(block);
+}
+
+AllocatorResult allocator_new(Device* device, Allocator** out_allocator) {
+    void* physical_device = NULL;
+    device_get_physical_device(device, &physical_device);
+
+    void* memory_properties = NULL;
+    device_get_memory_properties(device, &memory_properties);
+
+    Allocator* allocator = calloc(1, sizeof(Allocator));
+    allocator->memory_properties = *(VkPhysicalDeviceMemoryProperties*)memory_properties;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    allocator->non_coherent_atom_size = properties.limits.nonCoherentAtomSize;
+
+    for (u32 i = 0; i < allocator->memory_properties.memoryTypeCount; i++) {
+        u64 heap_size = allocator->memory_properties.memoryHeaps[memory_type_heap(allocator, i)].size;
+
+        // Small heaps (e.g. the 256MB BAR window) get smaller blocks so one type can't eat the whole heap
+        allocator->pools[i].block_size = heap_size <= ALLOCATOR_SMALL_HEAP_SIZE
+            ? heap_size / 8
+            : ALLOCATOR_DEFAULT_BLOCK_SIZE;
+    }
+
+    *out_allocator = allocator;
+    return ALLOCATOR_OK;
+}
+
+void allocator_free(Device* device, Allocator* allocator) {
+    for (u32 i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+        MemoryTypePool* pool = &allocator->pools[i];
+        while (pool->block_count > 0) {
+            MemoryBlock* block = pool->blocks[pool->block_count - 1];
+            if (block->allocation_count > 0) {
+                fprintf(stderr, "Freeing allocator with %d live allocations in memory type %d!\n", block->allocation_count, i);
+            }
+            allocator_destroy_block(device, allocator, block);
+        }
+
+        if (pool->blocks) {
+            free(pool->blocks);
+            pool->blocks = NULL;
+        }
+    }
+    free(allocator);
+}
+
+static i32 count_bits(u32 value) {
+    i32 count = 0;
+    for (; value != 0; value &= value - 1) {
+        count++;
+    }
+    return count;
+}
+
+static i32 memory_type_score(Allocator* allocator, u32 memory_type, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) {
+    VkMemoryPropertyFlags flags = allocator->memory_properties.memoryTypes[memory_type].propertyFlags;
+
+    // Every preferred flag outweighs any number of unwanted ones, and unwanted flags
+    // (e.g. DEVICE_LOCAL for staging, HOST_VISIBLE for GPU only data) break ties
+    i32 score = count_bits(flags & preferred) * 16;
+    score -= count_bits(flags & ~(required | preferred));
+    return score;
+}
+
+static AllocatorResult allocator_alloc_from_type(Device* device, Allocator* allocator, u64 size, u64 alignment, u32 memory_type, bool optimal_tiling, Allocation* out_allocation) {
+    // Ranges in non-coherent memory are padded out to whole atoms so flushing
+    // one allocation can never touch a neighbour's bytes
+    if (!memory_type_has(allocator, memory_type, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) &&
+        memory_type_has(allocator, memory_type, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+        u64 atom = allocator->non_coherent_atom_size;
+        alignment = alignment > atom ? alignment : atom;
+        size = align_up(size, atom);
+    }
+
+    MemoryTypePool* pool = &allocator->pools[memory_type];
+    MemoryBlock* block = NULL;
+    u64 offset = 0;
+
+    if (size > pool->block_size / 2) {
+        // Big resources get their own memory object rather than fragmenting a shared block
+        block = allocator_create_block(device, allocator, memory_type, size, true, optimal_tiling);
+        if (block == NULL) {
+            return ALLOCATOR_ERROR_MEM_ALLOC_FAIL;
+        }
+        range_allocator_alloc(block->ranges, size, 1, &offset);
+    } else {
+        for (u32 i = 0; i < pool->block_count; i++) {
+            MemoryBlock* candidate = pool->blocks[i];
+            if (candidate->dedicated || candidate->optimal_tiling != optimal_tiling) {
+                continue;
+            }
+            if (range_allocator_alloc(candidate->ranges, size, alignment, &offset)) {
+                block = candidate;
+                break;
+            }
+        }
+
+        if (block == NULL) {
+            block = allocator_create_block(device, allocator, memory_type, pool->block_size, false, optimal_tiling);
+            if (block == NULL) {
+                return ALLOCATOR_ERROR_MEM_ALLOC_FAIL;
+            }
+            range_allocator_alloc(block->ranges, size, alignment, &offset);
+        }
+    }
+
+    block->allocation_count++;
+
+    AllocatorHeapStats* stats = &allocator->heap_stats[memory_type_heap(allocator, memory_type)];
+    stats->used_bytes += size;
+    stats->allocation_count++;
+
+    *out_allocation = (Allocation){
+        .memory = block->memory,
+        .block = block,
+        .mapped = block->mapped ? (u8*)block->mapped + offset : NULL,
+        .offset = offset,
+        .size = size,
+        .memory_type = memory_type
+    };
+    return ALLOCATOR_OK;
+}
+
+AllocatorResult allocator_alloc(Device* device, Allocator* allocator, AllocationOptions options, Allocation* out_allocation) {
+    if (options.alignment == 0) {
+        options.alignment = 1;
+    }
+
+    u32 candidates[VK_MAX_MEMORY_TYPES];
+    i32 scores[VK_MAX_MEMORY_TYPES];
+    u32 candidate_count = 0;
+
+    for (u32 i = 0; i < allocator->memory_properties.memoryTypeCount; i++) {
+        if (!(options.memory_type_bits & (1u << i)) || !memory_type_has(allocator, i, options.required_flags)) {
+            continue;
+        }
+
+        // Insertion sort by score, ties keep the driver's order which is already ranked by performance
+        i32 score = memory_type_score(allocator, i, options.required_flags, options.preferred_flags);
+        u32 position = candidate_count;
+        while (position > 0 && scores[position - 1] < score) {
+            candidates[position] = candidates[position - 1];
+            scores[position] = scores[position - 1];
+            position--;
+        }
+        candidates[position] = i;
+        scores[position] = score;
+        candidate_count++;
+    }
+
+    if (candidate_count == 0) {
+        fprintf(stderr, "Failed to find a memory type with flags %d in type bits %d!\n", options.required_flags, options.memory_type_bits);
+        return ALLOCATOR_ERROR_NO_MEMORY_TYPE;
+    }
+
+    // A full heap (e.g. the BAR window) falls back to the next best type instead of failing outright
+    for (u32 i = 0; i < candidate_count; i++) {
+        AllocatorResult result = allocator_alloc_from_type(device, allocator, options.size, options.alignment, candidates[i], options.optimal_tiling, out_allocation);
+        if (result == ALLOCATOR_OK) {
+            return ALLOCATOR_OK;
+        }
+    }
+    return ALLOCATOR_ERROR_MEM_ALLOC_FAIL;
+}
+
+void allocator_release(Device* device, Allocator* allocator, Allocation* allocation) {
+    MemoryBlock* block = allocation->block;
+    if (block == NULL) {
+        return;
+    }
+
+    range_allocator_release(block->ranges, allocation->offset, allocation->size);
+    block->allocation_count--;
+
+    AllocatorHeapStats* stats = &allocator->heap_stats[memory_type_heap(allocator, block->memory_type)];
+    stats->used_bytes -= allocation->size;
+    stats->allocation_count--;
+
+    if (block->allocation_count == 0) {
+        // Keep one empty shared block around per type so alloc/free churn doesn't hit the driver
+        bool has_other_empty = false;
+        MemoryTypePool* pool = &allocator->pools[block->memory_type];
+        for (u32 i = 0; i < pool->block_count; i++) {
+            MemoryBlock* other = pool->blocks[i];
+            if (other != block && !other->dedicated && other->optimal_tiling == block->optimal_tiling && other->allocation_count == 0) {
+                has_other_empty = true;
+                break;
+            }
+        }
+
+        if (block->dedicated || has_other_empty) {
+            allocator_destroy_block(device, allocator, block);
+        }
+    }
+
+    *allocation = (Allocation){0};
+}
+
+static bool allocator_mapped_range(Allocator* allocator, Allocation* allocation, u64 offset, u64 size, VkMappedMemoryRange* out_range) {
+    if (allocation->mapped == NULL ||
+        memory_type_has(allocator, allocation->memory_type, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+        return false;
+    }
+
+    if (offset > allocation->size) {
+        fprintf(stderr, "Can't flush/invalidate at offset %llu, the allocation is only %llu bytes!\n",
+            (unsigned long long)offset, (unsigned long long)allocation->size);
+        return false;
+    }
+    if (size == VK_WHOLE_SIZE || size > allocation->size - offset) {
+        size = allocation->size - offset;
+    }
+    if (size == 0) {
+        return false;
+    }
+
+    // The allocation itself is atom aligned, so rounding outwards stays inside it
+    u64 atom = allocator->non_coherent_atom_size;
+    u64 begin = offset / atom * atom;
+    u64 end = align_up(offset + size, atom);
+    if (end > allocation->size) {
+        end = allocation->size;
+    }
+
+    *out_range = (VkMappedMemoryRange){
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .pNext = NULL,
+        .memory = allocation->memory,
+        .offset = allocation->offset + begin,
+        .size = end - begin
+    };
+    return true;
+}
+
+void allocator_flush(Device* device, Allocator* allocator, Allocation* allocation, u64 offset, u64 size) {
+    VkMappedMemoryRange range;
+    if (!allocator_mapped_range(allocator, allocation, offset, size, &range)) {
+        return;
+    }
+
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    VkResult flush = vkFlushMappedMemoryRanges(device_handle, 1, &range);
+    if (flush != VK_SUCCESS) {
+        fprintf(stderr, "Failed to flush mapped vulkan memory! %d\n", flush);
+    }
+}
+
+void allocator_invalidate(Device* device, Allocator* allocator, Allocation* allocation, u64 offset, u64 size) {
+    VkMappedMemoryRange range;
+    if (!allocator_mapped_range(allocator, allocation, offset, size, &range)) {
+        return;
+    }
+
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    VkResult invalidate = vkInvalidateMappedMemoryRanges(device_handle, 1, &range);
+    if (invalidate != VK_SUCCESS) {
+        fprintf(stderr, "Failed to invalidate mapped vulkan memory! %d\n", invalidate);
+    }
+}
+
+void allocator_get_heap_count(Allocator* allocator, u32* out_heap_count) {
+    *out_heap_count = allocator->memory_properties.memoryHeapCount;
+}
+
+void allocator_get_heap_stats(Allocator* allocator, u32 heap_index, AllocatorHeapStats* out_stats) {
+    *out_stats = allocator->heap_stats[heap_index];
+}
+
+void allocator_get_heap_budget(Device* device, Allocator* allocator, u32 heap_index, AllocatorHeapBudget* out_budget) {
+    if (!device_has_capability(device, DEVICE_CAPABILITY_MEMORY_BUDGET)) {
+        *out_budget = (AllocatorHeapBudget){
+            .budget = allocator->memory_properties.memoryHeaps[heap_index].size * ALLOCATOR_FALLBACK_BUDGET_PERCENT / 100,
+            .usage = allocator->heap_stats[heap_index].reserved_bytes
+        };
+        return;
+    }
+
+    void* physical_device = NULL;
+    device_get_physical_device(device, &physical_device);
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+        .pNext = NULL
+    };
+
+    VkPhysicalDeviceMemoryProperties2 memory_properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+        .pNext = &budget_properties
+    };
+
+    vkGetPhysicalDeviceMemoryProperties2(physical_device, &memory_properties);
+
+    *out_budget = (AllocatorHeapBudget){
+        .budget = budget_properties.heapBudget[heap_index],
+        .usage = budget_properties.heapUsage[heap_index]
+    };
+}
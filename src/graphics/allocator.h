@@ -0,0 +1,61 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include "device.h"
+#include "../int_types.h"
+
+typedef struct Allocator Allocator;
+
+typedef struct {
+    void* memory; // The device memory block this allocation lives in (shared with other allocations)
+    void* block; // Internal block that owns the range, used to give the range back
+    void* mapped; // Host pointer to the start of the allocation, NULL when the memory isn't host visible
+    u64 offset; // Offset into the device memory block
+    u64 size;
+    u32 memory_type;
+} Allocation;
+
+typedef struct {
+    u64 size;
+    u64 alignment;
+    u32 memory_type_bits; // Types the resource can live in (VkMemoryRequirements::memoryTypeBits)
+    u32 required_flags; // VkMemoryPropertyFlags a type must have
+    u32 preferred_flags; // VkMemoryPropertyFlags that make a type a better match, types are tried best first
+    bool optimal_tiling; // Optimal tiling images get their own blocks so they never sit next to buffers (bufferImageGranularity)
+} AllocationOptions;
+
+typedef struct {
+    u64 reserved_bytes; // Bytes held in device memory blocks from the driver
+    u64 used_bytes; // Bytes handed out to allocations
+    u32 block_count; // Number of device memory objects from the driver
+    u32 allocation_count; // Number of live allocations sub-allocated from the blocks
+} AllocatorHeapStats;
+
+typedef struct {
+    u64 budget; // Bytes the process can use from the heap before running into trouble
+    u64 usage; // Bytes the process currently uses from the heap
+} AllocatorHeapBudget;
+
+typedef enum {
+    ALLOCATOR_OK, // Successfully allocated memory
+    ALLOCATOR_ERROR_NO_MEMORY_TYPE, // No memory type has the required flags for the resource
+    ALLOCATOR_ERROR_MEM_ALLOC_FAIL, // Failed to allocate a new block of device memory
+} AllocatorResult;
+
+AllocatorResult allocator_new(Device* device, Allocator** out_allocator);
+void allocator_free(Device* device, Allocator* allocator);
+
+AllocatorResult allocator_alloc(Device* device, Allocator* allocator, AllocationOptions options, Allocation* out_allocation);
+void allocator_release(Device* device, Allocator* allocator, Allocation* allocation);
+
+void allocator_flush(Device* device, Allocator* allocator, Allocation* allocation, u64 offset, u64 size);
+void allocator_invalidate(Device* device, Allocator* allocator, Allocation* allocation, u64 offset, u64 size);
+
+void allocator_get_heap_count(Allocator* allocator, u32* out_heap_count);
+void allocator_get_heap_stats(Allocator* allocator, u32 heap_index, AllocatorHeapStats* out_stats);
+
+// Live numbers from VK_EXT_memory_budget when the device has it, otherwise
+// 80% of the heap size and what this allocator has reserved from it
+void allocator_get_heap_budget(Device* device, Allocator* allocator, u32 heap_index, AllocatorHeapBudget* out_budget);
+
+#endif // ALLOCATOR_H
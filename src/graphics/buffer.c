@@ -1,4 +1,5 @@
 #include "buffer.h"
+#include "allocator.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,8 +7,11 @@
 
 typedef struct Buffer {
     VkBuffer buffer;
-    VkDeviceMemory memory;
+    Allocation allocation;
     void* mapped;
+    u64 size;
+    u64 device_address;
+    SharingMode sharing;
 } Buffer;
 
 static VkSharingMode sharing_mode_to_vk[] = {
@@ -15,16 +19,29 @@ static VkSharingMode sharing_mode_to_vk[] = {
     [SHARING_CONCURRENT] = VK_SHARING_MODE_CONCURRENT
 };
 
-static VkMemoryPropertyFlags memory_mode_to_vk[] = {
-    [MEMORY_ACCESS_GPU] = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-    [MEMORY_ACCESS_CPU_TO_GPU] = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
-                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-    [MEMORY_ACCESS_GPU_TO_CPU] = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
-                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
-                          VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
-    [MEMORY_ACCESS_BOTH] = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
-                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+typedef struct {
+    VkMemoryPropertyFlags required;
+    VkMemoryPropertyFlags preferred;
+} MemoryModeFlags;
+
+static MemoryModeFlags memory_mode_to_vk[] = {
+    [MEMORY_ACCESS_GPU] = {
+        .required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        .preferred = 0
+    },
+    [MEMORY_ACCESS_CPU_TO_GPU] = {
+        .required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        .preferred = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    },
+    [MEMORY_ACCESS_GPU_TO_CPU] = {
+        .required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        .preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    },
+    // Resizable BAR when there is one, plain host visible memory otherwise
+    [MEMORY_ACCESS_BOTH] = {
+        .required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        .preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    }
 };
 
 static VkBufferUsageFlags buffer_usage_to_vk(BufferUsage usage) {
@@ -39,26 +56,11 @@ static VkBufferUsageFlags buffer_usage_to_vk(BufferUsage usage) {
     if (usage & BUFFER_INDEX) buffer_usage_flags |= VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
     if (usage & BUFFER_VERTEX) buffer_usage_flags |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
     if (usage & BUFFER_INDIRECT) buffer_usage_flags |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    if (usage & BUFFER_DEVICE_ADDRESS) buffer_usage_flags |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
 
     return buffer_usage_flags;
 }
 
-static u32 find_memory_type(Device* device, u32 type_filter, VkMemoryPropertyFlags properties) {
-    void* physical_device = NULL;
-    device_get_physical_device(device, &physical_device);
-
-    VkPhysicalDeviceMemoryProperties memory_properties;
-    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
-
-    for (u32 i = 0; i < memory_properties.memoryTypeCount; i++) {
-        if (type_filter & (1 << i) && memory_properties.memoryTypes[i].propertyFlags & properties) {
-            return i;
-        }
-    }
-    fprintf(stderr, "Failed to find memory index type for properties %d!\n", properties);
-    return UINT32_MAX;
-}
-
 BufferResult buffer_new(Device* device, BufferOptions options, Buffer** out_buffer) {
     void* device_handle = NULL;
     device_get_device(device, &device_handle);
@@ -66,7 +68,18 @@ BufferResult buffer_new(Device* device, BufferOptions options, Buffer** out_buff
     Buffer* buffer = malloc(sizeof(Buffer));
     buffer->buffer = NULL;
     buffer->mapped = NULL;
-    buffer->memory = NULL;
+    buffer->allocation = (Allocation){0};
+    buffer->size = options.size;
+    buffer->device_address = 0;
+
+    // Concurrent sharing has to name every family that touches the buffer, with only one family it's just exclusive
+    u32 families[DEVICE_MAX_QUEUE_FAMILIES];
+    u32 family_count = 0;
+    device_get_unique_families(device, families, &family_count);
+    if (options.sharing == SHARING_CONCURRENT && family_count < 2) {
+        options.sharing = SHARING_EXCLUSIVE;
+    }
+    buffer->sharing = options.sharing;
 
     VkBufferCreateInfo buffer_info = {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -75,8 +88,8 @@ BufferResult buffer_new(Device* device, BufferOptions options, Buffer** out_buff
         .size = options.size,
         .usage = buffer_usage_to_vk(options.usage),
         .sharingMode = sharing_mode_to_vk[options.sharing],
-        .queueFamilyIndexCount = 0,
-        .pQueueFamilyIndices = NULL
+        .queueFamilyIndexCount = options.sharing == SHARING_CONCURRENT ? family_count : 0,
+        .pQueueFamilyIndices = options.sharing == SHARING_CONCURRENT ? families : NULL
     };
 
     VkResult create_buffer = vkCreateBuffer(
@@ -94,15 +107,18 @@ BufferResult buffer_new(Device* device, BufferOptions options, Buffer** out_buff
     VkMemoryRequirements mem_requirements;
     vkGetBufferMemoryRequirements(device_handle, buffer->buffer, &mem_requirements);
 
-    VkMemoryAllocateInfo memory_info = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = NULL,
-        .allocationSize = options.size,
-        .memoryTypeIndex = find_memory_type(device, mem_requirements.memoryTypeBits, memory_mode_to_vk[options.memory_access])
-    };
-    VkResult create_memory = vkAllocateMemory(device_handle, &memory_info, NULL, &buffer->memory);
-    if (create_memory != VK_SUCCESS) {
-        fprintf(stderr, "Failed to create vulkan buffer memory! %d\n", create_buffer);
+    Allocator* allocator = NULL;
+    device_get_allocator(device, &allocator);
+
+    AllocatorResult create_memory = allocator_alloc(device, allocator, (AllocationOptions){
+        .size = mem_requirements.size,
+        .alignment = mem_requirements.alignment,
+        .memory_type_bits = mem_requirements.memoryTypeBits,
+        .required_flags = memory_mode_to_vk[options.memory_access].required,
+        .preferred_flags = memory_mode_to_vk[options.memory_access].preferred
+    }, &buffer->allocation);
+    if (create_memory != ALLOCATOR_OK) {
+        fprintf(stderr, "Failed to allocate vulkan buffer memory! %d\n", create_memory);
         buffer_free(device, buffer);
         return BUFFER_ERROR_MEM_ALLOC_FAIL;
     }
@@ -110,17 +126,33 @@ BufferResult buffer_new(Device* device, BufferOptions options, Buffer** out_buff
     VkResult bind_buffer_to_memory = vkBindBufferMemory(
         device_handle, 
         buffer->buffer, 
-        buffer->memory, 
-        0
+        buffer->allocation.memory, 
+        buffer->allocation.offset
     );
     if (bind_buffer_to_memory != VK_SUCCESS) {
-        fprintf(stderr, "Failed to bind vulkan buffer memory! %d\n", create_buffer);
+        fprintf(stderr, "Failed to bind vulkan buffer memory! %d\n", bind_buffer_to_memory);
         buffer_free(device, buffer);
         return BUFFER_ERROR_BIND_TO_MEM_FAIL;
     }
 
+    buffer->mapped = buffer->allocation.mapped;
+
+    if (options.usage & BUFFER_DEVICE_ADDRESS) {
+        VkBufferDeviceAddressInfo address_info = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+            .pNext = NULL,
+            .buffer = buffer->buffer
+        };
+        buffer->device_address = vkGetBufferDeviceAddress(device_handle, &address_info);
+    }
+
     if (options.initial_data != NULL) {
-        buffer_map(device, buffer, options.size, options.initial_data);
+        if (buffer->mapped == NULL) {
+            fprintf(stderr, "Can't write initial data to a buffer that isn't host visible!\n");
+            buffer_free(device, buffer);
+            return BUFFER_ERROR_INITIAL_DATA_NOT_MAPPABLE;
+        }
+        buffer_write(device, buffer, 0, options.size, options.initial_data);
     }
 
     *out_buffer = buffer;
@@ -136,24 +168,60 @@ void buffer_free(Device* device, Buffer* buffer) {
         buffer->buffer = NULL;
     }
 
-    if (buffer->memory) {
-        vkFreeMemory(device_handle, buffer->memory, NULL);
-        buffer->memory = NULL;
+    if (buffer->allocation.memory) {
+        Allocator* allocator = NULL;
+        device_get_allocator(device, &allocator);
+        allocator_release(device, allocator, &buffer->allocation);
     }
 
     buffer->mapped = NULL;
     free(buffer);
 }
 
-void buffer_map(Device* device, Buffer* buffer, u64 size, void* data) {
-    void* device_handle = NULL;
-    device_get_device(device, &device_handle);
+void buffer_write(Device* device, Buffer* buffer, u64 offset, u64 size, const void* data) {
+    if (buffer->mapped == NULL) {
+        fprintf(stderr, "Failed to write to buffer, its memory isn't host visible!\n");
+        return;
+    }
+
+    if (offset + size > buffer->size) {
+        fprintf(stderr, "Failed to write %llu bytes at offset %llu into a buffer of %llu bytes!\n",
+            (unsigned long long)size, (unsigned long long)offset, (unsigned long long)buffer->size);
+        return;
+    }
+
+    memcpy((u8*)buffer->mapped + offset, data, size);
+    buffer_flush(device, buffer, offset, size);
+}
+
+void buffer_flush(Device* device, Buffer* buffer, u64 offset, u64 size) {
+    Allocator* allocator = NULL;
+    device_get_allocator(device, &allocator);
+    allocator_flush(device, allocator, &buffer->allocation, offset, size);
+}
 
-    vkMapMemory(device_handle, buffer->memory, 0, size, 0, &buffer->mapped);
-    memcpy(buffer->mapped, data, size);
-    vkUnmapMemory(device_handle, buffer->memory);
+void buffer_invalidate(Device* device, Buffer* buffer, u64 offset, u64 size) {
+    Allocator* allocator = NULL;
+    device_get_allocator(device, &allocator);
+    allocator_invalidate(device, allocator, &buffer->allocation, offset, size);
 }
 
 void buffer_get_buffer(Buffer* buffer, void** out_buffer) {
     *out_buffer = buffer->buffer;
 }
+
+void buffer_get_mapped_ptr(Buffer* buffer, void** out_mapped) {
+    *out_mapped = buffer->mapped;
+}
+
+void buffer_get_size(Buffer* buffer, u64* out_size) {
+    *out_size = buffer->size;
+}
+
+void buffer_get_sharing(Buffer* buffer, SharingMode* out_sharing) {
+    *out_sharing = buffer->sharing;
+}
+
+void buffer_get_device_address(Buffer* buffer, u64* out_address) {
+    *out_address = buffer->device_address;
+}
@@ -9,14 +9,15 @@ typedef struct Buffer Buffer;
 typedef enum BufferUsageFlags {
     BUFFER_NO_USE = 0,
     BUFFER_TRANSFER_SRC = 1 << 0,
-    BUFFER_TRANSFER_DST = 2 << 0,
-    BUFFER_UNIFORM_TEXEL = 4 << 0,
-    BUFFER_STORAGE_TEXEL = 8 << 0,
-    BUFFER_UNIFORM = 1 << 1,
-    BUFFER_STORAGE = 2 << 1,
-    BUFFER_INDEX = 4 << 1,
-    BUFFER_VERTEX = 8 << 1,
-    BUFFER_INDIRECT = 1 << 2
+    BUFFER_TRANSFER_DST = 1 << 1,
+    BUFFER_UNIFORM_TEXEL = 1 << 2,
+    BUFFER_STORAGE_TEXEL = 1 << 3,
+    BUFFER_UNIFORM = 1 << 4,
+    BUFFER_STORAGE = 1 << 5,
+    BUFFER_INDEX = 1 << 6,
+    BUFFER_VERTEX = 1 << 7,
+    BUFFER_INDIRECT = 1 << 8,
+    BUFFER_DEVICE_ADDRESS = 1 << 9 // Lets shaders reach the buffer through a 64-bit pointer, see buffer_get_device_address
 } BufferUsage;
 
 typedef enum SharingMode {
@@ -43,13 +44,24 @@ typedef enum {
     BUFFER_OK, // Successfully created a buffer
     BUFFER_ERROR_CREATE_HANDLE_FAIL, // Failed to create the handle for the buffer
     BUFFER_ERROR_MEM_ALLOC_FAIL, // Failed to allocate memory object for the buffer (For explicit models)
-    BUFFER_ERROR_BIND_TO_MEM_FAIL // Failed to bind the buffer to memory object (For explicit models)
+    BUFFER_ERROR_BIND_TO_MEM_FAIL, // Failed to bind the buffer to memory object (For explicit models)
+    BUFFER_ERROR_INITIAL_DATA_NOT_MAPPABLE // initial_data was given for memory the CPU can't map, use uploader_buffer_new instead
 } BufferResult;
 
 BufferResult buffer_new(Device* device, BufferOptions options, Buffer** out_buffer);
 void buffer_free(Device* device, Buffer* buffer);
 
-void buffer_map(Device* device, Buffer* buffer, u64 size, void* data);
+// CPU_TO_GPU, GPU_TO_CPU and BOTH buffers stay mapped for their whole lifetime,
+// these write/read through that mapping and flush/invalidate non-coherent memory as needed
+void buffer_write(Device* device, Buffer* buffer, u64 offset, u64 size, const void* data);
+void buffer_flush(Device* device, Buffer* buffer, u64 offset, u64 size);
+void buffer_invalidate(Device* device, Buffer* buffer, u64 offset, u64 size);
+
 void buffer_get_buffer(Buffer* buffer, void** out_buffer);
+void buffer_get_mapped_ptr(Buffer* buffer, void** out_mapped);
+void buffer_get_size(Buffer* buffer, u64* out_size);
+void buffer_get_sharing(Buffer* buffer, SharingMode* out_sharing);
+// GPU virtual address of the buffer's first byte, 0 unless it was created with BUFFER_DEVICE_ADDRESS
+void buffer_get_device_address(Buffer* buffer, u64* out_address);
 
 #endif // BUFFER_H
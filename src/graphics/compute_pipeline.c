@@ -0,0 +1,89 @@
+#include "compute_pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+
+typedef struct ComputePipeline {
+    VkPipeline pipeline;
+    PipelineLayout* layout;
+} ComputePipeline;
+
+ComputePipelineResult compute_pipeline_new(Device* device, ComputePipelineOptions options, ComputePipeline** out_pipeline) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    void* pipeline_cache = NULL;
+    device_get_pipeline_cache(device, &pipeline_cache);
+
+    ShaderType type;
+    shader_get_type(options.shader, &type);
+    if (type != SHADER_COMPUTE) {
+        fprintf(stderr, "Failed to create compute pipeline, shader isn't a compute shader!\n");
+        return COMPUTE_PIPELINE_ERROR_NOT_COMPUTE_SHADER;
+    }
+
+    ComputePipeline* pipeline = malloc(sizeof(ComputePipeline));
+    pipeline->pipeline = NULL;
+    pipeline->layout = options.layout;
+
+    void* module = NULL;
+    shader_get_module(options.shader, &module);
+
+    void* layout = NULL;
+    pipeline_layout_get_layout(options.layout, &layout);
+
+    VkComputePipelineCreateInfo compute_pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = module,
+            .pName = "main",
+            .pSpecializationInfo = NULL
+        },
+        .layout = layout,
+        .basePipelineHandle = NULL,
+        .basePipelineIndex = -1
+    };
+
+    VkResult create_compute_pipeline = vkCreateComputePipelines(
+        device_handle,
+        pipeline_cache,
+        1,
+        &compute_pipeline_info,
+        NULL,
+        &pipeline->pipeline
+    );
+    if (create_compute_pipeline != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create a vulkan compute pipeline! %d\n", create_compute_pipeline);
+        pipeline->pipeline = NULL;
+        compute_pipeline_free(device, pipeline);
+        return COMPUTE_PIPELINE_ERROR_CREATE_HANDLE_FAIL;
+    }
+
+    *out_pipeline = pipeline;
+    return COMPUTE_PIPELINE_OK;
+}
+
+void compute_pipeline_free(Device* device, ComputePipeline* pipeline) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    if (pipeline->pipeline) {
+        vkDestroyPipeline(device_handle, pipeline->pipeline, NULL);
+        pipeline->pipeline = NULL;
+    }
+    free(pipeline);
+}
+
+void compute_pipeline_get_pipeline(ComputePipeline* pipeline, void** out_pipeline) {
+    *out_pipeline = pipeline->pipeline;
+}
+
+void compute_pipeline_get_layout(ComputePipeline* pipeline, PipelineLayout** out_layout) {
+    *out_layout = pipeline->layout;
+}
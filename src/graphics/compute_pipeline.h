@@ -0,0 +1,28 @@
+#ifndef COMPUTE_PIPELINE_H
+#define COMPUTE_PIPELINE_H
+
+#include "device.h"
+#include "shader.h"
+#include "pipeline_layout.h"
+#include "../int_types.h"
+
+typedef struct ComputePipeline ComputePipeline;
+
+typedef struct {
+    Shader* shader; // Must be a SHADER_COMPUTE shader
+    PipelineLayout* layout;
+} ComputePipelineOptions;
+
+typedef enum {
+    COMPUTE_PIPELINE_OK, // Successfully created a compute pipeline
+    COMPUTE_PIPELINE_ERROR_NOT_COMPUTE_SHADER, // The shader given isn't a compute shader
+    COMPUTE_PIPELINE_ERROR_CREATE_HANDLE_FAIL, // Failed to create the handle for the compute pipeline
+} ComputePipelineResult;
+
+ComputePipelineResult compute_pipeline_new(Device* device, ComputePipelineOptions options, ComputePipeline** out_pipeline);
+void compute_pipeline_free(Device* device, ComputePipeline* pipeline);
+
+void compute_pipeline_get_pipeline(ComputePipeline* pipeline, void** out_pipeline);
+void compute_pipeline_get_layout(ComputePipeline* pipeline, PipelineLayout** out_layout);
+
+#endif // COMPUTE_PIPELINE_H
@@ -0,0 +1,320 @@
+#include "cull_pass.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+
+#include "compute_pipeline.h"
+#include "pipeline_layout.h"
+
+#define CULL_PASS_GROUP_SIZE 64 // local_size_x in content/cull.comp
+
+// Matches the push constant block in content/cull.comp, exactly the 128 bytes every device guarantees
+typedef struct {
+    f32 planes[6][4];
+    u64 objects;
+    u64 commands;
+    u64 counts;
+    u32 object_count;
+    u32 max_draws_per_batch;
+} CullConstants;
+
+typedef struct CullPass {
+    PipelineLayout* layout;
+    ComputePipeline* pipeline;
+
+    Buffer* objects;
+    Buffer* commands; // frame_count regions of batch_count * max_draws_per_batch commands
+    Buffer* counts; // frame_count regions of batch_count counts
+
+    u64 objects_address;
+    u64 commands_address;
+    u64 counts_address;
+
+    Pipeline** batch_pipelines;
+    u32 batch_count;
+    u32 max_objects;
+    u32 max_draws_per_batch;
+    u32 frame_count;
+    u32 object_count;
+} CullPass;
+
+CullPassResult cull_pass_new(Device* device, CullPassOptions options, CullPass** out_pass) {
+    CullPass* pass = malloc(sizeof(CullPass));
+    pass->layout = NULL;
+    pass->pipeline = NULL;
+    pass->objects = NULL;
+    pass->commands = NULL;
+    pass->counts = NULL;
+    pass->batch_count = options.batch_count;
+    pass->max_objects = options.max_objects;
+    pass->max_draws_per_batch = options.max_draws_per_batch;
+    pass->frame_count = options.frame_count;
+    pass->object_count = 0;
+
+    pass->batch_pipelines = malloc(options.batch_count * sizeof(Pipeline*));
+    for (u32 i = 0; i < options.batch_count; i++) {
+        pass->batch_pipelines[i] = options.batch_pipelines[i];
+    }
+
+    PipelineLayoutResult layout_result = pipeline_layout_new(device, (PipelineLayoutOptions){
+        .push_constant_ranges = &(PushConstantRange){
+            .stages = SHADER_STAGE_COMPUTE,
+            .offset = 0,
+            .size = sizeof(CullConstants)
+        },
+        .push_constant_range_count = 1
+    }, &pass->layout);
+    if (layout_result != PIPELINE_LAYOUT_OK) {
+        fprintf(stderr, "Failed to create cull pass pipeline layout! %d\n", layout_result);
+        pass->layout = NULL;
+        cull_pass_free(device, pass);
+        return CULL_PASS_ERROR_CREATE_LAYOUT_FAIL;
+    }
+
+    ComputePipelineResult pipeline_result = compute_pipeline_new(device, (ComputePipelineOptions){
+        .shader = options.shader,
+        .layout = pass->layout
+    }, &pass->pipeline);
+    if (pipeline_result != COMPUTE_PIPELINE_OK) {
+        fprintf(stderr, "Failed to create cull pass pipeline! %d\n", pipeline_result);
+        pass->pipeline = NULL;
+        cull_pass_free(device, pass);
+        return CULL_PASS_ERROR_CREATE_PIPELINE_FAIL;
+    }
+
+    // Written by the compute queue and read by graphics, the indirect buffers only need to
+    // be shared when those are different families. Objects are also written by the uploader
+    u32 graphics_family = 0;
+    u32 compute_family = 0;
+    device_get_graphics_family(device, &graphics_family);
+    device_get_compute_family(device, &compute_family);
+    SharingMode indirect_sharing = graphics_family == compute_family ? SHARING_EXCLUSIVE : SHARING_CONCURRENT;
+
+    u64 commands_size = (u64)options.frame_count * options.batch_count * options.max_draws_per_batch * sizeof(VkDrawIndexedIndirectCommand);
+    u64 counts_size = (u64)options.frame_count * options.batch_count * sizeof(u32);
+
+    BufferResult objects_result = buffer_new(device, (BufferOptions){
+        .size = (u64)options.max_objects * sizeof(CullObject),
+        .usage = BUFFER_STORAGE | BUFFER_TRANSFER_DST | BUFFER_DEVICE_ADDRESS,
+        .sharing = SHARING_CONCURRENT,
+        .memory_access = MEMORY_ACCESS_GPU,
+        .initial_data = NULL
+    }, &pass->objects);
+    if (objects_result != BUFFER_OK) {
+        fprintf(stderr, "Failed to create cull pass object buffer! %d\n", objects_result);
+        pass->objects = NULL;
+        cull_pass_free(device, pass);
+        return CULL_PASS_ERROR_CREATE_BUFFER_FAIL;
+    }
+
+    BufferResult commands_result = buffer_new(device, (BufferOptions){
+        .size = commands_size,
+        .usage = BUFFER_STORAGE | BUFFER_INDIRECT | BUFFER_DEVICE_ADDRESS,
+        .sharing = indirect_sharing,
+        .memory_access = MEMORY_ACCESS_GPU,
+        .initial_data = NULL
+    }, &pass->commands);
+    if (commands_result != BUFFER_OK) {
+        fprintf(stderr, "Failed to create cull pass command buffer! %d\n", commands_result);
+        pass->commands = NULL;
+        cull_pass_free(device, pass);
+        return CULL_PASS_ERROR_CREATE_BUFFER_FAIL;
+    }
+
+    BufferResult counts_result = buffer_new(device, (BufferOptions){
+        .size = counts_size,
+        .usage = BUFFER_STORAGE | BUFFER_INDIRECT | BUFFER_TRANSFER_DST | BUFFER_DEVICE_ADDRESS,
+        .sharing = indirect_sharing,
+        .memory_access = MEMORY_ACCESS_GPU,
+        .initial_data = NULL
+    }, &pass->counts);
+    if (counts_result != BUFFER_OK) {
+        fprintf(stderr, "Failed to create cull pass count buffer! %d\n", counts_result);
+        pass->counts = NULL;
+        cull_pass_free(device, pass);
+        return CULL_PASS_ERROR_CREATE_BUFFER_FAIL;
+    }
+
+    buffer_get_device_address(pass->objects, &pass->objects_address);
+    buffer_get_device_address(pass->commands, &pass->commands_address);
+    buffer_get_device_address(pass->counts, &pass->counts_address);
+
+    *out_pass = pass;
+    return CULL_PASS_OK;
+}
+
+void cull_pass_free(Device* device, CullPass* pass) {
+    if (pass->counts) {
+        buffer_free(device, pass->counts);
+        pass->counts = NULL;
+    }
+    if (pass->commands) {
+        buffer_free(device, pass->commands);
+        pass->commands = NULL;
+    }
+    if (pass->objects) {
+        buffer_free(device, pass->objects);
+        pass->objects = NULL;
+    }
+    if (pass->pipeline) {
+        compute_pipeline_free(device, pass->pipeline);
+        pass->pipeline = NULL;
+    }
+    if (pass->layout) {
+        pipeline_layout_free(device, pass->layout);
+        pass->layout = NULL;
+    }
+    free(pass->batch_pipelines);
+    free(pass);
+}
+
+CullPassUploadResult cull_pass_set_objects(Device* device, CullPass* pass, Uploader* uploader, const CullObject* objects, u32 object_count) {
+    if (object_count > pass->max_objects) {
+        fprintf(stderr, "Failed to set cull pass objects, %u is more than the max of %u!\n", object_count, pass->max_objects);
+        return CULL_PASS_UPLOAD_ERROR_TOO_MANY_OBJECTS;
+    }
+
+    if (object_count > 0) {
+        UploadResult upload_result = uploader_upload(device, uploader, pass->objects, 0, (u64)object_count * sizeof(CullObject), objects);
+        if (upload_result != UPLOAD_OK) {
+            fprintf(stderr, "Failed to upload cull pass objects! %d\n", upload_result);
+            return CULL_PASS_UPLOAD_ERROR_UPLOAD_FAIL;
+        }
+
+        UploadTicket ticket = 0;
+        UploadResult submit_result = uploader_submit(uploader, &ticket);
+        if (submit_result != UPLOAD_OK) {
+            fprintf(stderr, "Failed to submit cull pass objects! %d\n", submit_result);
+            return CULL_PASS_UPLOAD_ERROR_UPLOAD_FAIL;
+        }
+        uploader_wait(device, uploader, ticket);
+    }
+
+    pass->object_count = object_count;
+    return CULL_PASS_UPLOAD_OK;
+}
+
+// Gribb/Hartmann plane extraction, normalized so the sphere test can compare against the radius
+static void extract_frustum_planes(const f32 m[16], f32 out_planes[6][4]) {
+    for (u32 i = 0; i < 4; i++) {
+        f32 row0 = m[i * 4 + 0];
+        f32 row1 = m[i * 4 + 1];
+        f32 row2 = m[i * 4 + 2];
+        f32 row3 = m[i * 4 + 3];
+
+        out_planes[0][i] = row3 + row0; // Left
+        out_planes[1][i] = row3 - row0; // Right
+        out_planes[2][i] = row3 + row1; // Bottom
+        out_planes[3][i] = row3 - row1; // Top
+        out_planes[4][i] = row2; // Near (Vulkan's depth starts at 0)
+        out_planes[5][i] = row3 - row2; // Far
+    }
+
+    for (u32 i = 0; i < 6; i++) {
+        f32 length = sqrtf(out_planes[i][0] * out_planes[i][0] + out_planes[i][1] * out_planes[i][1] + out_planes[i][2] * out_planes[i][2]);
+        if (length > 0.0f) {
+            for (u32 j = 0; j < 4; j++) {
+                out_planes[i][j] /= length;
+            }
+        }
+    }
+}
+
+void cull_pass_dispatch(Renderer* renderer, CullPass* pass, const f32 view_projection[16]) {
+    // The count reset, push constants and dispatch all have to land in the same command buffer
+    void* cmd = NULL;
+    renderer_get_compute_cmd(renderer, &cmd);
+    if (cmd == NULL) {
+        fprintf(stderr, "Can't cull outside of renderer_begin_compute/renderer_end_compute!\n");
+        return;
+    }
+
+    u32 frame_index = 0;
+    renderer_get_frame_index(renderer, &frame_index);
+
+    u64 counts_offset = (u64)frame_index * pass->batch_count * sizeof(u32);
+    u64 commands_offset = (u64)frame_index * pass->batch_count * pass->max_draws_per_batch * sizeof(VkDrawIndexedIndirectCommand);
+
+    void* counts_handle = NULL;
+    buffer_get_buffer(pass->counts, &counts_handle);
+    vkCmdFillBuffer(cmd, counts_handle, counts_offset, pass->batch_count * sizeof(u32), 0);
+
+    VkMemoryBarrier2 clear_barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext = NULL,
+        .srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+    };
+
+    VkDependencyInfo dependency_info = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = NULL,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &clear_barrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = NULL,
+        .imageMemoryBarrierCount = 0,
+        .pImageMemoryBarriers = NULL
+    };
+    vkCmdPipelineBarrier2(cmd, &dependency_info);
+
+    if (pass->object_count == 0) {
+        return;
+    }
+
+    CullConstants constants = {
+        .objects = pass->objects_address,
+        .commands = pass->commands_address + commands_offset,
+        .counts = pass->counts_address + counts_offset,
+        .object_count = pass->object_count,
+        .max_draws_per_batch = pass->max_draws_per_batch
+    };
+    extract_frustum_planes(view_projection, constants.planes);
+
+    void* layout_handle = NULL;
+    pipeline_layout_get_layout(pass->layout, &layout_handle);
+    vkCmdPushConstants(cmd, layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+
+    // The graphics submission waits on the renderer's compute timeline, which makes the writes visible to the indirect reads
+    renderer_dispatch(renderer, pass->pipeline, (pass->object_count + CULL_PASS_GROUP_SIZE - 1) / CULL_PASS_GROUP_SIZE, 1, 1);
+}
+
+void cull_pass_draw(Renderer* renderer, CullPass* pass, void* cmd, Buffer* vertex_buffer, Buffer* index_buffer) {
+    u32 frame_index = 0;
+    renderer_get_frame_index(renderer, &frame_index);
+
+    void* commands_handle = NULL;
+    void* counts_handle = NULL;
+    void* vertex_buffer_handle = NULL;
+    void* index_buffer_handle = NULL;
+    buffer_get_buffer(pass->commands, &commands_handle);
+    buffer_get_buffer(pass->counts, &counts_handle);
+    buffer_get_buffer(vertex_buffer, &vertex_buffer_handle);
+    buffer_get_buffer(index_buffer, &index_buffer_handle);
+
+    VkDeviceSize vertex_offset = 0;
+    vkCmdBindVertexBuffers(cmd, 0, 1, (VkBuffer*)&vertex_buffer_handle, &vertex_offset);
+    vkCmdBindIndexBuffer(cmd, index_buffer_handle, 0, VK_INDEX_TYPE_UINT32);
+
+    for (u32 batch = 0; batch < pass->batch_count; batch++) {
+        u32 region = frame_index * pass->batch_count + batch;
+
+        void* pipeline_handle = NULL;
+        pipeline_get_pipeline(pass->batch_pipelines[batch], &pipeline_handle);
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_handle);
+
+        vkCmdDrawIndexedIndirectCount(
+            cmd,
+            commands_handle,
+            (u64)region * pass->max_draws_per_batch * sizeof(VkDrawIndexedIndirectCommand),
+            counts_handle,
+            (u64)region * sizeof(u32),
+            pass->max_draws_per_batch,
+            sizeof(VkDrawIndexedIndirectCommand)
+        );
+    }
+}
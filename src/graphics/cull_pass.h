@@ -0,0 +1,62 @@
+#ifndef CULL_PASS_H
+#define CULL_PASS_H
+
+#include "device.h"
+#include "buffer.h"
+#include "shader.h"
+#include "pipeline.h"
+#include "renderer.h"
+#include "uploader.h"
+#include "../int_types.h"
+
+// GPU-driven drawing: a compute pass frustum culls every object and writes the surviving draws
+// into an indirect buffer, graphics then draws each batch (pipeline) with one vkCmdDrawIndexedIndirectCount.
+// The CPU cost of a frame is one dispatch plus one draw per batch, no matter how many objects there are
+typedef struct CullPass CullPass;
+
+// Matches CullObject in content/cull.comp (std430)
+typedef struct {
+    f32 center[3];
+    f32 radius; // Bounding sphere radius
+    u32 index_count;
+    u32 first_index;
+    i32 vertex_offset;
+    u32 batch; // Index into CullPassOptions::batch_pipelines
+} CullObject;
+
+typedef struct {
+    Shader* shader; // content/cull.comp
+    Pipeline** batch_pipelines; // One indirect draw per pipeline
+    u32 batch_count;
+    u32 max_objects;
+    u32 max_draws_per_batch; // Visible draws past this are dropped
+    u32 frame_count; // Frames in flight, each gets its own indirect buffers
+} CullPassOptions;
+
+typedef enum {
+    CULL_PASS_OK, // Successfully created the cull pass
+    CULL_PASS_ERROR_CREATE_LAYOUT_FAIL, // Failed to create the pipeline layout for the cull shader
+    CULL_PASS_ERROR_CREATE_PIPELINE_FAIL, // Failed to create the cull compute pipeline
+    CULL_PASS_ERROR_CREATE_BUFFER_FAIL, // Failed to create the object or indirect buffers
+} CullPassResult;
+
+typedef enum {
+    CULL_PASS_UPLOAD_OK, // Successfully uploaded the objects
+    CULL_PASS_UPLOAD_ERROR_TOO_MANY_OBJECTS, // More objects than max_objects
+    CULL_PASS_UPLOAD_ERROR_UPLOAD_FAIL, // Failed to upload the objects through the uploader
+} CullPassUploadResult;
+
+CullPassResult cull_pass_new(Device* device, CullPassOptions options, CullPass** out_pass);
+void cull_pass_free(Device* device, CullPass* pass);
+
+// Replaces the object list, blocks until the upload lands since this is meant for load time and not every frame
+CullPassUploadResult cull_pass_set_objects(Device* device, CullPass* pass, Uploader* uploader, const CullObject* objects, u32 object_count);
+
+// Records the culling into the frame's compute command buffer, only call between renderer_begin_compute/renderer_end_compute.
+// view_projection is column major and maps to Vulkan clip space (depth 0 to 1)
+void cull_pass_dispatch(Renderer* renderer, CullPass* pass, const f32 view_projection[16]);
+
+// Records one indirect count draw per batch into cmd inside dynamic rendering, every object shares vertex/index buffers
+void cull_pass_draw(Renderer* renderer, CullPass* pass, void* cmd, Buffer* vertex_buffer, Buffer* index_buffer);
+
+#endif // CULL_PASS_H
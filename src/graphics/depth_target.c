@@ -0,0 +1,190 @@
+#include "depth_target.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+
+typedef struct {
+    Image* image;
+    u64 retire_value; // Timeline value after which nothing uses the image anymore
+} RetiredDepthImage;
+
+typedef struct DepthTarget {
+    DepthFormat format;
+    bool prepass;
+    Image* image; // NULL until the first resize
+    Extent extent;
+
+    RetiredDepthImage* retired;
+    u32 retired_count;
+    u32 retired_capacity;
+} DepthTarget;
+
+DepthTargetResult depth_target_new(Device* device, DepthTargetOptions options, DepthTarget** out_target) {
+    (void)device;
+
+    DepthTarget* target = calloc(1, sizeof(DepthTarget));
+    target->format = options.format;
+    target->prepass = options.prepass;
+
+    *out_target = target;
+    return DEPTH_TARGET_OK;
+}
+
+void depth_target_free(Device* device, DepthTarget* target) {
+    if (target->image) {
+        image_free(device, target->image);
+        target->image = NULL;
+    }
+
+    depth_target_release_retired(device, target, UINT64_MAX);
+    free(target->retired);
+    free(target);
+}
+
+DepthTargetResult depth_target_resize(Device* device, DepthTarget* target, Extent extent, u64 retire_value) {
+    if (target->image && target->extent.width == extent.width && target->extent.height == extent.height) {
+        return DEPTH_TARGET_OK;
+    }
+
+    // Without a prepass depth only lives inside one rendering, so tile based GPUs never have to back it with memory
+    ImageUsage usage = IMAGE_DEPTH_ATTACHMENT;
+    ImageMemory memory = IMAGE_MEMORY_DEVICE;
+    if (!target->prepass) {
+        usage |= IMAGE_TRANSIENT_ATTACHMENT;
+        memory = IMAGE_MEMORY_LAZY;
+    }
+
+    Image* image = NULL;
+    ImageResult image_result = image_new(device, (ImageOptions){
+        .extent = extent,
+        .color_format = COLOR_RGBA_UNDEFINED,
+        .depth_format = target->format,
+        .usage = usage,
+        .memory = memory
+    }, &image);
+    if (image_result != IMAGE_OK) {
+        fprintf(stderr, "Failed to create depth target image! %d\n", image_result);
+        return DEPTH_TARGET_ERROR_CREATE_IMAGE_FAIL;
+    }
+
+    // Frames still in flight may be rendering to the old image
+    if (target->image) {
+        if (target->retired_count == target->retired_capacity) {
+            target->retired_capacity = target->retired_capacity > 0 ? target->retired_capacity * 2 : 4;
+            target->retired = realloc(target->retired, target->retired_capacity * sizeof(RetiredDepthImage));
+        }
+        target->retired[target->retired_count++] = (RetiredDepthImage){
+            .image = target->image,
+            .retire_value = retire_value
+        };
+    }
+
+    target->image = image;
+    target->extent = extent;
+    return DEPTH_TARGET_OK;
+}
+
+void depth_target_release_retired(Device* device, DepthTarget* target, u64 completed_value) {
+    u32 kept = 0;
+    for (u32 i = 0; i < target->retired_count; i++) {
+        if (target->retired[i].retire_value <= completed_value) {
+            image_free(device, target->retired[i].image);
+        } else {
+            target->retired[kept++] = target->retired[i];
+        }
+    }
+    target->retired_count = kept;
+}
+
+static void depth_target_barrier(DepthTarget* target, void* cmd, VkImageLayout old_layout, VkAccessFlags2 dst_access) {
+    void* image = NULL;
+    image_get_image(target->image, &image);
+
+    u32 aspect = 0;
+    image_get_aspect(target->image, &aspect);
+
+    VkImageMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext = NULL,
+        .srcStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        .srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        .dstAccessMask = dst_access,
+        .oldLayout = old_layout,
+        .newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {
+            .aspectMask = aspect,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+
+    VkDependencyInfo dependency_info = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = NULL,
+        .dependencyFlags = 0,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &barrier
+    };
+    vkCmdPipelineBarrier2(cmd, &dependency_info);
+}
+
+void depth_target_begin_frame(DepthTarget* target, void* cmd) {
+    // The last frame's depth tests have to finish before the image gets cleared again
+    depth_target_barrier(target, cmd, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+}
+
+void depth_target_end_prepass(DepthTarget* target, void* cmd) {
+    depth_target_barrier(target, cmd, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT);
+}
+
+void depth_target_get_attachment(DepthTarget* target, DepthPass pass, void* out_attachment_info) {
+    void* view = NULL;
+    image_get_view(target->image, &view);
+
+    bool loads_prepass = target->prepass && pass == DEPTH_PASS_MAIN;
+    bool stores = target->prepass && pass == DEPTH_PASS_PREPASS;
+
+    *(VkRenderingAttachmentInfo*)out_attachment_info = (VkRenderingAttachmentInfo){
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .pNext = NULL,
+        .imageView = view,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .resolveMode = VK_RESOLVE_MODE_NONE,
+        .resolveImageView = NULL,
+        .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .loadOp = loads_prepass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = stores ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .clearValue = {
+            .depthStencil = {1.0f, 0}
+        }
+    };
+}
+
+void depth_target_get_depth_stencil(DepthTarget* target, DepthPass pass, PipelineDepthStencilOptions* out_depth_stencil) {
+    bool tests_prepass = target->prepass && pass == DEPTH_PASS_MAIN;
+
+    *out_depth_stencil = (PipelineDepthStencilOptions){
+        .depth_test = true,
+        .depth_write = !tests_prepass,
+        .depth_compare_op = tests_prepass ? COMPARE_OP_EQUAL : COMPARE_OP_LESS,
+        .depth_bounds_test = false,
+        .stencil_test = false,
+        .min_depth_bounds = 0,
+        .max_depth_bounds = 1
+    };
+}
+
+void depth_target_get_format(DepthTarget* target, DepthFormat* out_format) {
+  *out_format = target->format;
+}
+
+void depth_target_get_image(DepthTarget* target, Image** out_image) {
+  *out_image = target->image;
+}
@@ -0,0 +1,59 @@
+#ifndef DEPTH_TARGET_H
+#define DEPTH_TARGET_H
+
+#include <stdbool.h>
+#include "device.h"
+#include "formats.h"
+#include "image.h"
+#include "pipeline.h"
+#include "../int_types.h"
+
+// Depth image that follows the swapchain's size, its contents never outlive the frame
+typedef struct DepthTarget DepthTarget;
+
+typedef struct {
+    DepthFormat format;
+    // Depth is laid down by a depth-only prepass and the main pass tests EQUAL against it without writing,
+    // so every pixel is shaded once. The depth has to survive between the two renderings, which rules
+    // out lazily allocated memory, without the prepass it's never stored at all
+    bool prepass;
+} DepthTargetOptions;
+
+typedef enum {
+    DEPTH_PASS_PREPASS, // Depth-only rendering before the main pass, only with DepthTargetOptions::prepass
+    DEPTH_PASS_MAIN // The color pass, tests against the prepass's depth when there is one
+} DepthPass;
+
+typedef enum {
+    DEPTH_TARGET_OK, // Successfully created/resized the depth target
+    DEPTH_TARGET_ERROR_CREATE_IMAGE_FAIL, // Failed to create the depth image
+} DepthTargetResult;
+
+// Doesn't create an image yet, that happens the first time depth_target_resize gets an extent
+DepthTargetResult depth_target_new(Device* device, DepthTargetOptions options, DepthTarget** out_target);
+void depth_target_free(Device* device, DepthTarget* target);
+
+// Recreates the image when extent changed, the old one is retired until the timeline value retire_value
+// is reached (see depth_target_release_retired). Does nothing when the extent is the same
+DepthTargetResult depth_target_resize(Device* device, DepthTarget* target, Extent extent, u64 retire_value);
+
+// Destroys every retired image whose retire value completed_value has reached
+void depth_target_release_retired(Device* device, DepthTarget* target, u64 completed_value);
+
+// Transitions the image for this frame's first depth pass, discarding last frame's contents
+void depth_target_begin_frame(DepthTarget* target, void* cmd);
+
+// Makes the prepass's depth writes visible to the main pass, record it between the two renderings
+void depth_target_end_prepass(DepthTarget* target, void* cmd);
+
+// Fills out a VkRenderingAttachmentInfo for the pass. The first pass clears, the main pass loads what
+// the prepass wrote, and only the prepass stores
+void depth_target_get_attachment(DepthTarget* target, DepthPass pass, void* out_attachment_info);
+
+// Depth test/write state pipelines drawn in the pass should use
+void depth_target_get_depth_stencil(DepthTarget* target, DepthPass pass, PipelineDepthStencilOptions* out_depth_stencil);
+
+void depth_target_get_format(DepthTarget* target, DepthFormat* out_format);
+void depth_target_get_image(DepthTarget* target, Image** out_image);
+
+#endif // DEPTH_TARGET_H
@@ -1,23 +1,184 @@
 #include "device.h"
+#include "allocator.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vulkan/vulkan.h>
 
+#include <SDL3/SDL_filesystem.h>
 #include <SDL3/SDL_vulkan.h>
 
+#define PIPELINE_CACHE_MAGIC 0x43504343 // "CCPC"
+
+// Written in front of the driver's cache data. The driver's own header doesn't carry the driver version,
+// and some drivers keep their pipelineCacheUUID across updates that change the cache format anyway
+typedef struct {
+    u32 magic;
+    u32 driver_version;
+    u64 data_size; // Bytes of cache data after the header, catches truncated files
+} PipelineCacheFileHeader;
+
 typedef struct Device {
     VkInstance instance;
     VkDevice device;
     VkPhysicalDevice physical_device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    u32 max_push_descriptors; // VkPhysicalDevicePushDescriptorPropertiesKHR::maxPushDescriptors
+    VkPipelineCache pipeline_cache;
+    char* pipeline_cache_path; // NULL when the cache isn't persisted
 
+    u32 capabilities; // DeviceCapability flags for optional extensions that were found and enabled
     u32 graphics_family;
+    u32 transfer_family;
+    u32 compute_family;
+    u32 unique_families[DEVICE_MAX_QUEUE_FAMILIES];
+    u32 unique_family_count;
 
     VkQueue graphics_queue;
+    VkQueue transfer_queue;
+    VkQueue compute_queue;
+
+    Allocator* allocator;
 } Device;
 
-DeviceResult device_new(Device** out_device) {
+static u32 find_queue_family(VkQueueFamilyProperties* queue_families, u32 queue_family_count, VkQueueFlags required, VkQueueFlags excluded) {
+    for (u32 i = 0; i < queue_family_count; i++) {
+      VkQueueFlags flags = queue_families[i].queueFlags;
+      if ((flags & required) == required && (flags & excluded) == 0) {
+        return i;
+      }
+    }
+    return UINT32_MAX;
+}
+
+static void device_add_unique_family(Device* device, u32 family) {
+    for (u32 i = 0; i < device->unique_family_count; i++) {
+      if (device->unique_families[i] == family) {
+        return;
+      }
+    }
+    device->unique_families[device->unique_family_count++] = family;
+}
+
+// Reads the cache file and returns its driver data when it was written by this exact GPU and driver, NULL otherwise
+static void* device_read_pipeline_cache(Device* device, const char* path, usize* out_size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (file_size == 0) {
+        fprintf(stderr, "Ignoring pipeline cache %s, it's empty!\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    PipelineCacheFileHeader file_header;
+    if (fread(&file_header, sizeof(file_header), 1, file) != 1 || file_header.magic != PIPELINE_CACHE_MAGIC) {
+        fprintf(stderr, "Ignoring pipeline cache %s, it isn't a pipeline cache file!\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device->physical_device, &properties);
+
+    if (file_header.driver_version != properties.driverVersion) {
+        fprintf(stderr, "Ignoring pipeline cache %s, it was written by another driver!\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    if (file_header.data_size == 0) {
+        fprintf(stderr, "Ignoring pipeline cache %s, the cache is empty!\n", path);
+        fclose(file);
+        return NULL;
+    }
+    if (file_header.data_size < sizeof(VkPipelineCacheHeaderVersionOne)) {
+        fprintf(stderr, "Ignoring pipeline cache %s, its data is too small to hold a cache header!\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    // The size comes from the file itself, never trust it past what the file actually holds
+    if (file_size < (long)sizeof(file_header) || file_header.data_size > (u64)file_size - sizeof(file_header)) {
+        fprintf(stderr, "Ignoring pipeline cache %s, it's truncated!\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    void* data = malloc(file_header.data_size);
+    if (data == NULL) {
+        fprintf(stderr, "Ignoring pipeline cache %s, failed to allocate %llu bytes for it!\n", path, (unsigned long long)file_header.data_size);
+        fclose(file);
+        return NULL;
+    }
+
+    usize bytes_read = fread(data, 1, file_header.data_size, file);
+    fclose(file);
+    if (bytes_read != file_header.data_size) {
+        fprintf(stderr, "Ignoring pipeline cache %s, it's truncated!\n", path);
+        free(data);
+        return NULL;
+    }
+
+    // Drivers are supposed to reject mismatched data themselves, not all of them do
+    VkPipelineCacheHeaderVersionOne cache_header;
+    memcpy(&cache_header, data, sizeof(cache_header));
+    if (cache_header.headerSize < sizeof(VkPipelineCacheHeaderVersionOne) ||
+        cache_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        cache_header.vendorID != properties.vendorID ||
+        cache_header.deviceID != properties.deviceID ||
+        memcmp(cache_header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        fprintf(stderr, "Ignoring pipeline cache %s, it was written by another GPU or driver!\n", path);
+        free(data);
+        return NULL;
+    }
+
+    *out_size = bytes_read;
+    return data;
+}
+
+static bool device_create_pipeline_cache(Device* device, const char* path) {
+    usize initial_size = 0;
+    void* initial_data = path ? device_read_pipeline_cache(device, path, &initial_size) : NULL;
+
+    VkPipelineCacheCreateInfo pipeline_cache_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .initialDataSize = initial_size,
+      .pInitialData = initial_data
+    };
+
+    VkResult pipeline_cache_create = vkCreatePipelineCache(device->device, &pipeline_cache_info, NULL, &device->pipeline_cache);
+    if (pipeline_cache_create != VK_SUCCESS && initial_data != NULL) {
+      // Data the driver doesn't like shouldn't cost more than a cold start
+      fprintf(stderr, "Failed to create vulkan pipeline cache from %s, starting empty! %d\n", path, pipeline_cache_create);
+      pipeline_cache_info.initialDataSize = 0;
+      pipeline_cache_info.pInitialData = NULL;
+      pipeline_cache_create = vkCreatePipelineCache(device->device, &pipeline_cache_info, NULL, &device->pipeline_cache);
+    }
+    free(initial_data);
+
+    if (pipeline_cache_create != VK_SUCCESS) {
+      fprintf(stderr, "Failed to create vulkan pipeline cache! %d\n", pipeline_cache_create);
+      device->pipeline_cache = NULL;
+      return false;
+    }
+    return true;
+}
+
+DeviceResult device_new(DeviceOptions options, Device** out_device) {
     Device* device = malloc(sizeof(Device));
     device->device = NULL;
+    device->allocator = NULL;
+    device->pipeline_cache = NULL;
+    device->pipeline_cache_path = options.pipeline_cache_path ? strdup(options.pipeline_cache_path) : NULL;
+    device->capabilities = 0;
 
     u32 api_version = VK_MAKE_API_VERSION(0, 1, 3, 0);
     u32 app_version = VK_MAKE_API_VERSION(0, 0, 1, 0);
@@ -124,6 +285,19 @@ DeviceResult device_new(Device** out_device) {
       return DEVICE_ERROR_NO_SUITABLE_GPU;
     }
     device->physical_device = best_device;
+    vkGetPhysicalDeviceMemoryProperties(best_device, &device->memory_properties);
+
+    VkPhysicalDevicePushDescriptorPropertiesKHR push_descriptor_properties = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PUSH_DESCRIPTOR_PROPERTIES_KHR,
+      .pNext = NULL,
+      .maxPushDescriptors = 0
+    };
+    VkPhysicalDeviceProperties2 properties_2 = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext = &push_descriptor_properties
+    };
+    vkGetPhysicalDeviceProperties2(best_device, &properties_2);
+    device->max_push_descriptors = push_descriptor_properties.maxPushDescriptors;
   
     u32 queue_family_count = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(best_device, &queue_family_count, NULL);
@@ -136,33 +310,49 @@ DeviceResult device_new(Device** out_device) {
     VkQueueFamilyProperties queue_families[queue_family_count];
     vkGetPhysicalDeviceQueueFamilyProperties(best_device, &queue_family_count, queue_families);
   
-    u32 graphics_family = UINT32_MAX;
-  
-    for (u32 i = 0; i < queue_family_count; i++) {
-      VkQueueFamilyProperties queue_family = queue_families[i];
-      if (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-        graphics_family = i;
-        break;
-      }
-    }
-  
+    u32 graphics_family = find_queue_family(queue_families, queue_family_count, VK_QUEUE_GRAPHICS_BIT, 0);
     if (graphics_family == UINT32_MAX) {
           fprintf(stderr, "Failed to get graphics support!\n");
           device_free(device);
           return DEVICE_ERROR_NO_QUEUE_FAMILIES;
     }
 
+    // Prefer the copy engine (transfer only), then anything that isn't the graphics family,
+    // graphics queues can always transfer so that's the last resort
+    u32 transfer_family = find_queue_family(queue_families, queue_family_count, VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+    if (transfer_family == UINT32_MAX) {
+      transfer_family = find_queue_family(queue_families, queue_family_count, VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT);
+    }
+    if (transfer_family == UINT32_MAX) {
+      transfer_family = graphics_family;
+    }
+
+    // An async compute family (no graphics) lets compute overlap with rendering, otherwise it shares graphics
+    u32 compute_family = find_queue_family(queue_families, queue_family_count, VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+    if (compute_family == UINT32_MAX) {
+      compute_family = graphics_family;
+    }
+
     device->graphics_family = graphics_family;
+    device->transfer_family = transfer_family;
+    device->compute_family = compute_family;
+    device->unique_family_count = 0;
+    device_add_unique_family(device, graphics_family);
+    device_add_unique_family(device, transfer_family);
+    device_add_unique_family(device, compute_family);
   
     f32 queue_priority = 1.0f;
-    VkDeviceQueueCreateInfo graphics_queue_info = {
-      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-      .pNext = NULL,
-      .flags = 0,
-      .pQueuePriorities = &queue_priority,
-      .queueFamilyIndex = graphics_family,
-      .queueCount = 1,
-    };
+    VkDeviceQueueCreateInfo queue_infos[DEVICE_MAX_QUEUE_FAMILIES];
+    for (u32 i = 0; i < device->unique_family_count; i++) {
+      queue_infos[i] = (VkDeviceQueueCreateInfo){
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .pQueuePriorities = &queue_priority,
+        .queueFamilyIndex = device->unique_families[i],
+        .queueCount = 1,
+      };
+    }
   
     const char* device_extensions[] = {
       "VK_KHR_swapchain",
@@ -184,8 +374,68 @@ DeviceResult device_new(Device** out_device) {
     u32 device_extension_count = sizeof(device_extensions) / sizeof(device_extensions[0]);
     u32 device_layer_count = sizeof(device_layers) / sizeof(device_extensions[0]);
 
+    // Optional extensions are only enabled when the driver has them, callers check device_has_capability
+    // A capability is only there when every extension listed for it is
+    const char* optional_extensions[] = {
+      "VK_EXT_memory_budget",
+      "VK_KHR_pipeline_library",
+      "VK_EXT_graphics_pipeline_library"
+    };
+    DeviceCapability optional_capabilities[] = {
+      DEVICE_CAPABILITY_MEMORY_BUDGET,
+      DEVICE_CAPABILITY_GRAPHICS_PIPELINE_LIBRARY,
+      DEVICE_CAPABILITY_GRAPHICS_PIPELINE_LIBRARY
+    };
+    u32 optional_extension_count = sizeof(optional_extensions) / sizeof(optional_extensions[0]);
+
+    u32 available_extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(best_device, NULL, &available_extension_count, NULL);
+    VkExtensionProperties* available_extensions = malloc(available_extension_count * sizeof(VkExtensionProperties));
+    vkEnumerateDeviceExtensionProperties(best_device, NULL, &available_extension_count, available_extensions);
+
+    const char* enabled_extensions[device_extension_count + optional_extension_count];
+    memcpy(enabled_extensions, device_extensions, device_extension_count * sizeof(char*));
+    u32 enabled_extension_count = device_extension_count;
+
+    u32 missing_capabilities = 0;
+    for (u32 i = 0; i < optional_extension_count; i++) {
+      bool found = false;
+      for (u32 j = 0; j < available_extension_count && !found; j++) {
+        found = strcmp(optional_extensions[i], available_extensions[j].extensionName) == 0;
+      }
+      if (!found) {
+        missing_capabilities |= optional_capabilities[i];
+      }
+    }
+    free(available_extensions);
+
+    for (u32 i = 0; i < optional_extension_count; i++) {
+      if (!(missing_capabilities & optional_capabilities[i])) {
+        enabled_extensions[enabled_extension_count++] = optional_extensions[i];
+        device->capabilities |= optional_capabilities[i];
+      }
+    }
+
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphics_pipeline_library_features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+      .pNext = NULL,
+      .graphicsPipelineLibrary = VK_FALSE
+    };
+
+    if (device->capabilities & DEVICE_CAPABILITY_GRAPHICS_PIPELINE_LIBRARY) {
+      VkPhysicalDeviceFeatures2 supported_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &graphics_pipeline_library_features
+      };
+      vkGetPhysicalDeviceFeatures2(best_device, &supported_features);
+      if (!graphics_pipeline_library_features.graphicsPipelineLibrary) {
+        device->capabilities &= ~DEVICE_CAPABILITY_GRAPHICS_PIPELINE_LIBRARY;
+      }
+    }
+
     VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extended_dynamic_state_features = {
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
+      .pNext = (device->capabilities & DEVICE_CAPABILITY_GRAPHICS_PIPELINE_LIBRARY) ? &graphics_pipeline_library_features : NULL,
       .extendedDynamicState = VK_TRUE
     };
 
@@ -195,23 +445,38 @@ DeviceResult device_new(Device** out_device) {
       .extendedDynamicState2 = VK_TRUE,
     };
   
+    VkPhysicalDeviceVulkan12Features physical_device_vulkan_12_features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+      .pNext = &extended_dynamic_state2_features,
+      .drawIndirectCount = VK_TRUE,
+      .timelineSemaphore = VK_TRUE,
+      .bufferDeviceAddress = VK_TRUE
+    };
+  
     VkPhysicalDeviceVulkan13Features physical_device_vulkan_13_features = {
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
-      .pNext = &extended_dynamic_state2_features,
+      .pNext = &physical_device_vulkan_12_features,
       .dynamicRendering = VK_TRUE,
       .synchronization2 = VK_TRUE
     };
   
+    // GPU-driven draws pass the object index through firstInstance and pack many draws per call
+    VkPhysicalDeviceFeatures physical_device_features = {
+      .multiDrawIndirect = VK_TRUE,
+      .drawIndirectFirstInstance = VK_TRUE
+    };
+  
     VkDeviceCreateInfo device_info = {
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
       .pNext = &physical_device_vulkan_13_features,
       .flags = 0,
-      .pQueueCreateInfos = &graphics_queue_info,
-      .queueCreateInfoCount = 1,
-      .enabledExtensionCount = device_extension_count,
-      .ppEnabledExtensionNames = device_extensions,
+      .pQueueCreateInfos = queue_infos,
+      .queueCreateInfoCount = device->unique_family_count,
+      .enabledExtensionCount = enabled_extension_count,
+      .ppEnabledExtensionNames = enabled_extensions,
       .enabledLayerCount = device_layer_count,
-      .ppEnabledLayerNames = device_layers
+      .ppEnabledLayerNames = device_layers,
+      .pEnabledFeatures = &physical_device_features
     };
     
     VkResult device_create = vkCreateDevice(best_device, &device_info, NULL, &device->device);
@@ -222,11 +487,39 @@ DeviceResult device_new(Device** out_device) {
     }
   
     vkGetDeviceQueue(device->device, graphics_family, 0, &device->graphics_queue);
+    vkGetDeviceQueue(device->device, transfer_family, 0, &device->transfer_queue);
+    vkGetDeviceQueue(device->device, compute_family, 0, &device->compute_queue);
+
+    AllocatorResult allocator_result = allocator_new(device, &device->allocator);
+    if (allocator_result != ALLOCATOR_OK) {
+      fprintf(stderr, "Failed to create device memory allocator! %d\n", allocator_result);
+      device_free(device);
+      return DEVICE_ERROR_CREATE_HANDLE_FAIL;
+    }
+
+    if (!device_create_pipeline_cache(device, device->pipeline_cache_path)) {
+      device_free(device);
+      return DEVICE_ERROR_CREATE_PIPELINE_CACHE_FAIL;
+    }
+
     *out_device = device;
     return DEVICE_OK;
 }
 
 void device_free(Device* device) {
+    if (device->pipeline_cache != NULL) {
+        device_save_pipeline_cache(device);
+        vkDestroyPipelineCache(device->device, device->pipeline_cache, NULL);
+        device->pipeline_cache = NULL;
+    }
+    free(device->pipeline_cache_path);
+    device->pipeline_cache_path = NULL;
+
+    if (device->allocator != NULL) {
+        allocator_free(device, device->allocator);
+        device->allocator = NULL;
+    }
+
     if (device->device != NULL) {
         vkDestroyDevice(device->device, NULL);
         device->device = NULL;
@@ -239,7 +532,11 @@ void device_free(Device* device) {
 
     device->physical_device = NULL;
     device->graphics_family = UINT32_MAX;
+    device->transfer_family = UINT32_MAX;
     device->graphics_queue = NULL;
+    device->transfer_queue = NULL;
+    device->compute_family = UINT32_MAX;
+    device->compute_queue = NULL;
     free(device);
 }
 
@@ -247,6 +544,64 @@ void device_wait(Device* device) {
     vkDeviceWaitIdle(device->device);
 }
 
+bool device_save_pipeline_cache(Device* device) {
+    if (device->pipeline_cache_path == NULL || device->pipeline_cache == NULL) {
+        return false;
+    }
+
+    usize data_size = 0;
+    VkResult get_size = vkGetPipelineCacheData(device->device, device->pipeline_cache, &data_size, NULL);
+    if (get_size != VK_SUCCESS || data_size == 0) {
+        fprintf(stderr, "Failed to get vulkan pipeline cache size! %d\n", get_size);
+        return false;
+    }
+
+    void* data = malloc(data_size);
+    VkResult get_data = vkGetPipelineCacheData(device->device, device->pipeline_cache, &data_size, data);
+    if (get_data != VK_SUCCESS) {
+        fprintf(stderr, "Failed to get vulkan pipeline cache data! %d\n", get_data);
+        free(data);
+        return false;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device->physical_device, &properties);
+
+    PipelineCacheFileHeader file_header = {
+        .magic = PIPELINE_CACHE_MAGIC,
+        .driver_version = properties.driverVersion,
+        .data_size = data_size
+    };
+
+    usize temp_path_size = strlen(device->pipeline_cache_path) + sizeof(".tmp");
+    char* temp_path = malloc(temp_path_size);
+    snprintf(temp_path, temp_path_size, "%s.tmp", device->pipeline_cache_path);
+
+    FILE* file = fopen(temp_path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open %s to save the pipeline cache!\n", temp_path);
+        free(temp_path);
+        free(data);
+        return false;
+    }
+
+    bool written = fwrite(&file_header, sizeof(file_header), 1, file) == 1 &&
+                   fwrite(data, 1, data_size, file) == data_size;
+    written &= fclose(file) == 0;
+    free(data);
+
+    // Only a complete file replaces the old cache
+    if (!written || !SDL_RenamePath(temp_path, device->pipeline_cache_path)) {
+        fprintf(stderr, "Failed to save the pipeline cache to %s! %s\n", device->pipeline_cache_path, written ? SDL_GetError() : "write failed");
+        remove(temp_path);
+        free(temp_path);
+        return false;
+    }
+
+    free(temp_path);
+    return true;
+}
+
 void device_get_instance(Device* device, void** out_instance) {
   *out_instance = device->instance;
 }
@@ -262,4 +617,37 @@ void device_get_graphics_family(Device* device, u32* out_graphics_family) {
 void device_get_graphics_queue(Device* device, void** out_graphics_queue) {
   *out_graphics_queue = device->graphics_queue;
 }
+void device_get_transfer_family(Device* device, u32* out_transfer_family) {
+  *out_transfer_family = device->transfer_family;
+}
+void device_get_transfer_queue(Device* device, void** out_transfer_queue) {
+  *out_transfer_queue = device->transfer_queue;
+}
+void device_get_compute_family(Device* device, u32* out_compute_family) {
+  *out_compute_family = device->compute_family;
+}
+void device_get_compute_queue(Device* device, void** out_compute_queue) {
+  *out_compute_queue = device->compute_queue;
+}
+void device_get_unique_families(Device* device, u32* out_families, u32* out_family_count) {
+  for (u32 i = 0; i < device->unique_family_count; i++) {
+    out_families[i] = device->unique_families[i];
+  }
+  *out_family_count = device->unique_family_count;
+}
+void device_get_allocator(Device* device, Allocator** out_allocator) {
+  *out_allocator = device->allocator;
+}
+void device_get_memory_properties(Device* device, void** out_memory_properties) {
+  *out_memory_properties = &device->memory_properties;
+}
+void device_get_max_push_descriptors(Device* device, u32* out_max_push_descriptors) {
+  *out_max_push_descriptors = device->max_push_descriptors;
+}
+void device_get_pipeline_cache(Device* device, void** out_pipeline_cache) {
+  *out_pipeline_cache = device->pipeline_cache;
+}
 
+bool device_has_capability(Device* device, DeviceCapability capability) {
+  return (device->capabilities & capability) == capability;
+}
@@ -1,27 +1,62 @@
 #ifndef DEVICE_H
 #define DEVICE_H
 
+#include <stdbool.h>
 #include "../int_types.h"
 
+#define DEVICE_MAX_QUEUE_FAMILIES 4
+
 typedef enum {
     DEVICE_OK, // Successfully created a device
     DEVICE_ERROR_CREATE_HANDLE_FAIL, // Failed to create a handle for the device
     DEVICE_ERROR_NO_GPUS, // Failed to find any gpu
     DEVICE_ERROR_NO_SUITABLE_GPU, // Failed to find any gpu that would've been suitable
     DEVICE_ERROR_NO_QUEUE_FAMILIES, // Failed to find any queue family (graphics queue, present queue, compute queue, etc..)
+    DEVICE_ERROR_CREATE_PIPELINE_CACHE_FAIL, // Failed to create the pipeline cache every pipeline is built through
 } DeviceResult;
 
+typedef struct {
+    // File the pipeline cache is loaded from at startup and written back to by device_free, NULL keeps
+    // the cache in memory only. A file from another GPU or driver version is ignored and replaced
+    const char* pipeline_cache_path;
+} DeviceOptions;
+
+typedef enum {
+    DEVICE_CAPABILITY_MEMORY_BUDGET = 1 << 0, // VK_EXT_memory_budget, live per-heap budget/usage from the driver
+    DEVICE_CAPABILITY_GRAPHICS_PIPELINE_LIBRARY = 1 << 1, // VK_EXT_graphics_pipeline_library, pipelines compiled in parts and linked
+} DeviceCapability;
+
 typedef struct Device Device;
+typedef struct Allocator Allocator;
 
-DeviceResult device_new(Device** out_device);
+DeviceResult device_new(DeviceOptions options, Device** out_device);
 void device_free(Device* device);
 
 void device_wait(Device* device);
 
+// Writes the pipeline cache to a temporary file next to pipeline_cache_path and renames it over the old one,
+// so a crash mid-write never leaves a truncated cache behind. Returns false when there's no path or it failed
+bool device_save_pipeline_cache(Device* device);
+
 void device_get_instance(Device* device, void** out_instance);
 void device_get_device(Device* device, void** out_device);
 void device_get_physical_device(Device* device, void** out_physical_device);
 void device_get_graphics_family(Device* device, u32* out_graphics_family);
 void device_get_graphics_queue(Device* device, void** out_graphics_queue);
+// Same as the graphics family/queue when the GPU has no separate family for copies
+void device_get_transfer_family(Device* device, u32* out_transfer_family);
+void device_get_transfer_queue(Device* device, void** out_transfer_queue);
+// Same as the graphics family/queue when the GPU has no async compute family
+void device_get_compute_family(Device* device, u32* out_compute_family);
+void device_get_compute_queue(Device* device, void** out_compute_queue);
+// Every distinct family a queue was created from, out_families needs room for DEVICE_MAX_QUEUE_FAMILIES
+void device_get_unique_families(Device* device, u32* out_families, u32* out_family_count);
+void device_get_allocator(Device* device, Allocator** out_allocator);
+void device_get_memory_properties(Device* device, void** out_memory_properties);
+// Most descriptors a single push descriptor set layout can hold
+void device_get_max_push_descriptors(Device* device, u32* out_max_push_descriptors);
+void device_get_pipeline_cache(Device* device, void** out_pipeline_cache);
+
+bool device_has_capability(Device* device, DeviceCapability capability);
 
 #endif // DEVICE_H
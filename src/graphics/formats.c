@@ -34,6 +34,22 @@ static const VkFormat vertex_format_to_vk_format[] = {
     [VERTEX_UNORM4] = VK_FORMAT_R8G8B8A8_UNORM,
 };
 
+static const u32 vertex_format_sizes[] = {
+    [VERTEX_FLOAT1] = 4,
+    [VERTEX_FLOAT2] = 8,
+    [VERTEX_FLOAT3] = 12,
+    [VERTEX_FLOAT4] = 16,
+    [VERTEX_INT1] = 4,
+    [VERTEX_INT2] = 8,
+    [VERTEX_INT3] = 12,
+    [VERTEX_INT4] = 16,
+    [VERTEX_UINT1] = 4,
+    [VERTEX_UINT2] = 8,
+    [VERTEX_UINT3] = 12,
+    [VERTEX_UINT4] = 16,
+    [VERTEX_UNORM4] = 4,
+};
+
 void color_format_to_vk(ColorFormat format, int* vk_format) {
     *vk_format = color_format_to_vk_format[format];
 }
@@ -46,4 +62,8 @@ void vertex_format_to_vk(VertexFormat format, int* vk_format) {
     *vk_format = vertex_format_to_vk_format[format];
 }
 
+void vertex_format_size(VertexFormat format, u32* out_size) {
+    *out_size = vertex_format_sizes[format];
+}
+
 
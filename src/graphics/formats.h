@@ -1,6 +1,13 @@
 #ifndef FORMATS_H
 #define FORMATS_H
 
+#include "../int_types.h"
+
+typedef struct {
+    u32 width;
+    u32 height;
+} Extent;
+
 typedef enum ColorTypes {
     COLOR_RGBA_UNDEFINED,
     COLOR_RGBA8_UNORM,
@@ -38,4 +45,7 @@ void color_format_to_vk(ColorFormat format, int* vk_format);
 void depth_format_to_vk(DepthFormat format, int* vk_format);
 void vertex_format_to_vk(VertexFormat format, int* vk_format);
 
+// Bytes one attribute of the format takes up
+void vertex_format_size(VertexFormat format, u32* out_size);
+
 #endif // FORMATS_H
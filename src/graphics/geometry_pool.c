@@ -0,0 +1,139 @@
+#include "geometry_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+
+#include "range_allocator.h"
+
+typedef struct GeometryPool {
+    Buffer* vertex_buffer;
+    Buffer* index_buffer;
+
+    RangeAllocator* vertex_ranges; // In vertices
+    RangeAllocator* index_ranges; // In indices
+} GeometryPool;
+
+GeometryPoolResult geometry_pool_new(Device* device, GeometryPoolOptions options, GeometryPool** out_pool) {
+    GeometryPool* pool = malloc(sizeof(GeometryPool));
+    pool->vertex_buffer = NULL;
+    pool->index_buffer = NULL;
+    range_allocator_new(options.max_vertices, &pool->vertex_ranges);
+    range_allocator_new(options.max_indices, &pool->index_ranges);
+
+    BufferResult vertex_buffer_result = buffer_new(device, (BufferOptions){
+        .size = (u64)options.max_vertices * sizeof(Vertex),
+        .usage = BUFFER_VERTEX | BUFFER_TRANSFER_DST,
+        .sharing = SHARING_EXCLUSIVE,
+        .memory_access = MEMORY_ACCESS_GPU,
+        .initial_data = NULL
+    }, &pool->vertex_buffer);
+    if (vertex_buffer_result != BUFFER_OK) {
+        fprintf(stderr, "Failed to create geometry pool vertex buffer! %d\n", vertex_buffer_result);
+        pool->vertex_buffer = NULL;
+        geometry_pool_free(device, pool);
+        return GEOMETRY_POOL_ERROR_CREATE_BUFFER_FAIL;
+    }
+
+    BufferResult index_buffer_result = buffer_new(device, (BufferOptions){
+        .size = (u64)options.max_indices * sizeof(u32),
+        .usage = BUFFER_INDEX | BUFFER_TRANSFER_DST,
+        .sharing = SHARING_EXCLUSIVE,
+        .memory_access = MEMORY_ACCESS_GPU,
+        .initial_data = NULL
+    }, &pool->index_buffer);
+    if (index_buffer_result != BUFFER_OK) {
+        fprintf(stderr, "Failed to create geometry pool index buffer! %d\n", index_buffer_result);
+        pool->index_buffer = NULL;
+        geometry_pool_free(device, pool);
+        return GEOMETRY_POOL_ERROR_CREATE_BUFFER_FAIL;
+    }
+
+    *out_pool = pool;
+    return GEOMETRY_POOL_OK;
+}
+
+void geometry_pool_free(Device* device, GeometryPool* pool) {
+    if (pool->index_buffer) {
+        buffer_free(device, pool->index_buffer);
+        pool->index_buffer = NULL;
+    }
+    if (pool->vertex_buffer) {
+        buffer_free(device, pool->vertex_buffer);
+        pool->vertex_buffer = NULL;
+    }
+    range_allocator_free(pool->index_ranges);
+    range_allocator_free(pool->vertex_ranges);
+    free(pool);
+}
+
+GeometryUploadResult geometry_upload(Device* device, GeometryPool* pool, Uploader* uploader, Geometry* geometry, GeometryRange* out_range) {
+    u64 vertex_offset = 0;
+    if (!range_allocator_alloc(pool->vertex_ranges, geometry->vertex_count, 1, &vertex_offset)) {
+        fprintf(stderr, "Geometry pool has no room for %u vertices!\n", geometry->vertex_count);
+        return GEOMETRY_UPLOAD_ERROR_OUT_OF_VERTEX_SPACE;
+    }
+
+    u64 first_index = 0;
+    if (!range_allocator_alloc(pool->index_ranges, geometry->index_count, 1, &first_index)) {
+        fprintf(stderr, "Geometry pool has no room for %u indices!\n", geometry->index_count);
+        range_allocator_release(pool->vertex_ranges, vertex_offset, geometry->vertex_count);
+        return GEOMETRY_UPLOAD_ERROR_OUT_OF_INDEX_SPACE;
+    }
+
+    UploadResult vertex_upload = uploader_upload(
+        device,
+        uploader,
+        pool->vertex_buffer,
+        vertex_offset * sizeof(Vertex),
+        (u64)geometry->vertex_count * sizeof(Vertex),
+        geometry->vertices
+    );
+    UploadResult index_upload = vertex_upload == UPLOAD_OK ? uploader_upload(
+        device,
+        uploader,
+        pool->index_buffer,
+        first_index * sizeof(u32),
+        (u64)geometry->index_count * sizeof(u32),
+        geometry->indices
+    ) : vertex_upload;
+    if (index_upload != UPLOAD_OK) {
+        fprintf(stderr, "Failed to upload geometry into the pool! %d\n", index_upload);
+        range_allocator_release(pool->vertex_ranges, vertex_offset, geometry->vertex_count);
+        range_allocator_release(pool->index_ranges, first_index, geometry->index_count);
+        return GEOMETRY_UPLOAD_ERROR_UPLOAD_FAIL;
+    }
+
+    // Indices stay relative to the mesh, the draw's vertexOffset moves them into the shared buffer
+    *out_range = (GeometryRange){
+        .vertex_offset = (i32)vertex_offset,
+        .first_index = (u32)first_index,
+        .vertex_count = geometry->vertex_count,
+        .index_count = geometry->index_count
+    };
+    return GEOMETRY_UPLOAD_OK;
+}
+
+void geometry_pool_release(GeometryPool* pool, GeometryRange* range) {
+    range_allocator_release(pool->vertex_ranges, (u64)range->vertex_offset, range->vertex_count);
+    range_allocator_release(pool->index_ranges, range->first_index, range->index_count);
+    *range = (GeometryRange){0};
+}
+
+void geometry_pool_bind(GeometryPool* pool, void* cmd) {
+    void* vertex_buffer_handle = NULL;
+    void* index_buffer_handle = NULL;
+    buffer_get_buffer(pool->vertex_buffer, &vertex_buffer_handle);
+    buffer_get_buffer(pool->index_buffer, &index_buffer_handle);
+
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmd, 0, 1, (VkBuffer*)&vertex_buffer_handle, &offset);
+    vkCmdBindIndexBuffer(cmd, index_buffer_handle, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void geometry_pool_get_vertex_buffer(GeometryPool* pool, Buffer** out_buffer) {
+    *out_buffer = pool->vertex_buffer;
+}
+
+void geometry_pool_get_index_buffer(GeometryPool* pool, Buffer** out_buffer) {
+    *out_buffer = pool->index_buffer;
+}
@@ -0,0 +1,53 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include "device.h"
+#include "buffer.h"
+#include "geometry.h"
+#include "uploader.h"
+#include "../int_types.h"
+
+// Sub-allocates every mesh's vertices and indices out of one shared device local vertex buffer
+// and one index buffer, so all of them draw with a single bind through vertex_offset/first_index
+typedef struct GeometryPool GeometryPool;
+
+typedef struct {
+    i32 vertex_offset; // vertexOffset for the draw
+    u32 first_index; // firstIndex for the draw
+    u32 vertex_count;
+    u32 index_count;
+} GeometryRange;
+
+typedef struct {
+    u32 max_vertices;
+    u32 max_indices;
+} GeometryPoolOptions;
+
+typedef enum {
+    GEOMETRY_POOL_OK, // Successfully created a geometry pool
+    GEOMETRY_POOL_ERROR_CREATE_BUFFER_FAIL, // Failed to create the shared vertex or index buffer
+} GeometryPoolResult;
+
+typedef enum {
+    GEOMETRY_UPLOAD_OK, // Successfully queued the geometry's upload
+    GEOMETRY_UPLOAD_ERROR_OUT_OF_VERTEX_SPACE, // No free range in the vertex buffer is big enough
+    GEOMETRY_UPLOAD_ERROR_OUT_OF_INDEX_SPACE, // No free range in the index buffer is big enough
+    GEOMETRY_UPLOAD_ERROR_UPLOAD_FAIL, // Failed to queue the copies on the uploader
+} GeometryUploadResult;
+
+GeometryPoolResult geometry_pool_new(Device* device, GeometryPoolOptions options, GeometryPool** out_pool);
+void geometry_pool_free(Device* device, GeometryPool* pool);
+
+// Queues the copies on the uploader, they reach the GPU with the next uploader_submit
+GeometryUploadResult geometry_upload(Device* device, GeometryPool* pool, Uploader* uploader, Geometry* geometry, GeometryRange* out_range);
+
+// Gives the range back for later uploads, only call once no frame in flight draws from it
+void geometry_pool_release(GeometryPool* pool, GeometryRange* range);
+
+// Binds the shared vertex buffer at binding 0 and the u32 index buffer
+void geometry_pool_bind(GeometryPool* pool, void* cmd);
+
+void geometry_pool_get_vertex_buffer(GeometryPool* pool, Buffer** out_buffer);
+void geometry_pool_get_index_buffer(GeometryPool* pool, Buffer** out_buffer);
+
+#endif // GEOMETRY_POOL_H
@@ -0,0 +1,213 @@
+#include "image.h"
+#include "allocator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+
+typedef struct Image {
+    VkImage image;
+    VkImageView view;
+    Allocation allocation; // Empty for IMAGE_MEMORY_UNBOUND images
+    VkFormat format;
+    VkImageAspectFlags aspect;
+    Extent extent;
+} Image;
+
+static VkImageUsageFlags image_usage_to_vk(ImageUsage usage) {
+    VkImageUsageFlags image_usage_flags = 0;
+
+    if (usage & IMAGE_TRANSFER_SRC) image_usage_flags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    if (usage & IMAGE_TRANSFER_DST) image_usage_flags |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (usage & IMAGE_SAMPLED) image_usage_flags |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (usage & IMAGE_STORAGE) image_usage_flags |= VK_IMAGE_USAGE_STORAGE_BIT;
+    if (usage & IMAGE_COLOR_ATTACHMENT) image_usage_flags |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (usage & IMAGE_DEPTH_ATTACHMENT) image_usage_flags |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (usage & IMAGE_TRANSIENT_ATTACHMENT) image_usage_flags |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+    return image_usage_flags;
+}
+
+static ImageResult image_create_view(Device* device, Image* image) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    VkImageViewCreateInfo image_view_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .image = image->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = image->format,
+        .components = {
+            .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+        },
+        .subresourceRange = {
+            .aspectMask = image->aspect,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        }
+    };
+
+    VkResult image_view_create = vkCreateImageView(device_handle, &image_view_info, NULL, &image->view);
+    if (image_view_create != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create vulkan image view! %d\n", image_view_create);
+        image->view = NULL;
+        return IMAGE_ERROR_VIEW_FAIL;
+    }
+    return IMAGE_OK;
+}
+
+ImageResult image_new(Device* device, ImageOptions options, Image** out_image) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    Image* image = malloc(sizeof(Image));
+    image->image = NULL;
+    image->view = NULL;
+    image->allocation = (Allocation){0};
+    image->extent = options.extent;
+
+    int format = 0;
+    if (options.depth_format != DEPTH_UNDEFINED) {
+        depth_format_to_vk(options.depth_format, &format);
+        image->aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (options.depth_format != DEPTH32_SFLOAT) {
+            image->aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+    } else {
+        color_format_to_vk(options.color_format, &format);
+        image->aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+    image->format = format;
+
+    VkImageCreateInfo image_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = image->format,
+        .extent = {options.extent.width, options.extent.height, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = image_usage_to_vk(options.usage),
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = NULL,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+
+    VkResult image_create = vkCreateImage(device_handle, &image_info, NULL, &image->image);
+    if (image_create != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create vulkan image! %d\n", image_create);
+        image->image = NULL;
+        image_free(device, image);
+        return IMAGE_ERROR_CREATE_HANDLE_FAIL;
+    }
+
+    if (options.memory == IMAGE_MEMORY_UNBOUND) {
+        *out_image = image;
+        return IMAGE_OK;
+    }
+
+    ImageMemoryRequirements requirements;
+    image_get_memory_requirements(device, image, &requirements);
+
+    Allocator* allocator = NULL;
+    device_get_allocator(device, &allocator);
+
+    AllocatorResult create_memory = allocator_alloc(device, allocator, (AllocationOptions){
+        .size = requirements.size,
+        .alignment = requirements.alignment,
+        .memory_type_bits = requirements.memory_type_bits,
+        .required_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        .preferred_flags = options.memory == IMAGE_MEMORY_LAZY ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0,
+        .optimal_tiling = true
+    }, &image->allocation);
+    if (create_memory != ALLOCATOR_OK) {
+        fprintf(stderr, "Failed to allocate memory for image! %d\n", create_memory);
+        image_free(device, image);
+        return IMAGE_ERROR_MEM_ALLOC_FAIL;
+    }
+
+    ImageResult bind_result = image_bind_memory(device, image, image->allocation.memory, image->allocation.offset);
+    if (bind_result != IMAGE_OK) {
+        image_free(device, image);
+        return bind_result;
+    }
+
+    *out_image = image;
+    return IMAGE_OK;
+}
+
+void image_free(Device* device, Image* image) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    if (image->view) {
+        vkDestroyImageView(device_handle, image->view, NULL);
+        image->view = NULL;
+    }
+
+    if (image->image) {
+        vkDestroyImage(device_handle, image->image, NULL);
+        image->image = NULL;
+    }
+
+    if (image->allocation.block) {
+        Allocator* allocator = NULL;
+        device_get_allocator(device, &allocator);
+        allocator_release(device, allocator, &image->allocation);
+    }
+    free(image);
+}
+
+void image_get_memory_requirements(Device* device, Image* image, ImageMemoryRequirements* out_requirements) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    VkMemoryRequirements mem_requirements;
+    vkGetImageMemoryRequirements(device_handle, image->image, &mem_requirements);
+
+    *out_requirements = (ImageMemoryRequirements){
+        .size = mem_requirements.size,
+        .alignment = mem_requirements.alignment,
+        .memory_type_bits = mem_requirements.memoryTypeBits
+    };
+}
+
+ImageResult image_bind_memory(Device* device, Image* image, void* memory, u64 offset) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    VkResult bind_image_to_memory = vkBindImageMemory(device_handle, image->image, memory, offset);
+    if (bind_image_to_memory != VK_SUCCESS) {
+        fprintf(stderr, "Failed to bind vulkan image to memory! %d\n", bind_image_to_memory);
+        return IMAGE_ERROR_BIND_TO_MEM_FAIL;
+    }
+
+    // Views need bound memory, so they're created here rather than in image_new
+    return image_create_view(device, image);
+}
+
+void image_get_image(Image* image, void** out_image) {
+    *out_image = image->image;
+}
+
+void image_get_view(Image* image, void** out_view) {
+    *out_view = image->view;
+}
+
+void image_get_extent(Image* image, Extent* out_extent) {
+    *out_extent = image->extent;
+}
+
+void image_get_aspect(Image* image, u32* out_aspect) {
+    *out_aspect = image->aspect;
+}
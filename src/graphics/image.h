@@ -0,0 +1,63 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "device.h"
+#include "formats.h"
+#include "../int_types.h"
+
+// 2D single mip, single layer image with optimal tiling and a view over the whole thing
+typedef struct Image Image;
+
+typedef enum ImageUsageFlags {
+    IMAGE_NO_USE = 0,
+    IMAGE_TRANSFER_SRC = 1 << 0,
+    IMAGE_TRANSFER_DST = 1 << 1,
+    IMAGE_SAMPLED = 1 << 2,
+    IMAGE_STORAGE = 1 << 3,
+    IMAGE_COLOR_ATTACHMENT = 1 << 4,
+    IMAGE_DEPTH_ATTACHMENT = 1 << 5,
+    IMAGE_TRANSIENT_ATTACHMENT = 1 << 6 // Only ever used inside one rendering pass
+} ImageUsage;
+
+typedef enum {
+    IMAGE_MEMORY_DEVICE, // Allocates and binds its own device local memory
+    IMAGE_MEMORY_LAZY, // Like IMAGE_MEMORY_DEVICE but prefers lazily allocated memory (tile memory), needs IMAGE_TRANSIENT_ATTACHMENT
+    IMAGE_MEMORY_UNBOUND // Created without memory, image_bind_memory has to be called before it's used (e.g. aliasing)
+} ImageMemory;
+
+typedef struct {
+    Extent extent;
+    ColorFormat color_format; // Set exactly one of color_format/depth_format
+    DepthFormat depth_format;
+    ImageUsage usage;
+    ImageMemory memory;
+} ImageOptions;
+
+typedef struct {
+    u64 size;
+    u64 alignment;
+    u32 memory_type_bits;
+} ImageMemoryRequirements;
+
+typedef enum {
+    IMAGE_OK, // Successfully created/bound the image
+    IMAGE_ERROR_CREATE_HANDLE_FAIL, // Failed to create the handle for the image
+    IMAGE_ERROR_MEM_ALLOC_FAIL, // Failed to allocate memory for the image
+    IMAGE_ERROR_BIND_TO_MEM_FAIL, // Failed to bind the image to memory
+    IMAGE_ERROR_VIEW_FAIL, // Failed to create the image's view
+} ImageResult;
+
+ImageResult image_new(Device* device, ImageOptions options, Image** out_image);
+void image_free(Device* device, Image* image);
+
+// For IMAGE_MEMORY_UNBOUND images, memory is a VkDeviceMemory the caller keeps alive for as long as the image is used
+void image_get_memory_requirements(Device* device, Image* image, ImageMemoryRequirements* out_requirements);
+ImageResult image_bind_memory(Device* device, Image* image, void* memory, u64 offset);
+
+void image_get_image(Image* image, void** out_image);
+void image_get_view(Image* image, void** out_view);
+void image_get_extent(Image* image, Extent* out_extent);
+// VkImageAspectFlags of the view, color or depth (+ stencil)
+void image_get_aspect(Image* image, u32* out_aspect);
+
+#endif // IMAGE_H
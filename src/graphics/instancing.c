@@ -0,0 +1,41 @@
+#include "instancing.h"
+#include <stdio.h>
+
+void instance_layout_build(u32 binding, u32 first_location, const VertexFormat* formats, u32 format_count, InstanceLayout* out_layout) {
+    if (format_count > INSTANCE_LAYOUT_MAX_ATTRIBUTES) {
+        fprintf(stderr, "Instance layout has %u attributes, only the first %d are used!\n", format_count, INSTANCE_LAYOUT_MAX_ATTRIBUTES);
+        format_count = INSTANCE_LAYOUT_MAX_ATTRIBUTES;
+    }
+
+    u32 offset = 0;
+    for (u32 i = 0; i < format_count; i++) {
+        out_layout->attributes[i] = (PipelineInputAttribute){
+            .location = first_location + i,
+            .binding = binding,
+            .format = formats[i],
+            .offset = offset
+        };
+
+        u32 size = 0;
+        vertex_format_size(formats[i], &size);
+        offset += size;
+    }
+
+    out_layout->binding = (PipelineInputBinding){
+        .binding = binding,
+        .stride = offset,
+        .rate = INPUT_INSTANCE
+    };
+    out_layout->attribute_count = format_count;
+}
+
+void instance_layout_default(u32 binding, u32 first_location, InstanceLayout* out_layout) {
+    VertexFormat formats[5] = {
+        VERTEX_FLOAT4,
+        VERTEX_FLOAT4,
+        VERTEX_FLOAT4,
+        VERTEX_FLOAT4,
+        VERTEX_FLOAT4
+    };
+    instance_layout_build(binding, first_location, formats, 5, out_layout);
+}
@@ -0,0 +1,30 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include "pipeline.h"
+#include "formats.h"
+#include "../int_types.h"
+
+#define INSTANCE_LAYOUT_MAX_ATTRIBUTES 16
+
+// Per-instance data for the default layout, a mat4 takes up four consecutive locations (one per column)
+typedef struct {
+    f32 transform[16]; // Column major
+    f32 color[4];
+} Instance;
+
+// A vertex binding that advances once per instance instead of once per vertex,
+// append binding/attributes to the geometry's own in PipelineVertexOptions
+typedef struct {
+    PipelineInputBinding binding;
+    PipelineInputAttribute attributes[INSTANCE_LAYOUT_MAX_ATTRIBUTES];
+    u32 attribute_count;
+} InstanceLayout;
+
+// Tightly packs formats in order starting at first_location, the stride is the sum of their sizes
+void instance_layout_build(u32 binding, u32 first_location, const VertexFormat* formats, u32 format_count, InstanceLayout* out_layout);
+
+// Layout for Instance: transform at first_location..first_location + 3, color at first_location + 4
+void instance_layout_default(u32 binding, u32 first_location, InstanceLayout* out_layout);
+
+#endif // INSTANCING_H
@@ -5,11 +5,27 @@
 
 typedef struct Pipeline {
     VkPipeline pipeline;
+    PipelineDynamicState dynamic_state;
 } Pipeline;
 
+static const struct {
+    PipelineDynamicState flag;
+    VkDynamicState state;
+} dynamic_state_to_vk[] = {
+    {PIPELINE_DYNAMIC_CULL_MODE, VK_DYNAMIC_STATE_CULL_MODE},
+    {PIPELINE_DYNAMIC_FRONT_FACE, VK_DYNAMIC_STATE_FRONT_FACE},
+    {PIPELINE_DYNAMIC_TOPOLOGY, VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY},
+    {PIPELINE_DYNAMIC_DEPTH_TEST, VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE},
+    {PIPELINE_DYNAMIC_DEPTH_WRITE, VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE},
+    {PIPELINE_DYNAMIC_DEPTH_COMPARE_OP, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP},
+    {PIPELINE_DYNAMIC_DEPTH_BIAS, VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE},
+    {PIPELINE_DYNAMIC_PRIMITIVE_RESTART, VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE}
+};
+
 static VkShaderStageFlagBits shader_stage_to_vk[] = {
     [SHADER_VERTEX] = VK_SHADER_STAGE_VERTEX_BIT,
-    [SHADER_FRAGMENT] = VK_SHADER_STAGE_FRAGMENT_BIT
+    [SHADER_FRAGMENT] = VK_SHADER_STAGE_FRAGMENT_BIT,
+    [SHADER_COMPUTE] = VK_SHADER_STAGE_COMPUTE_BIT
 };
 
 static VkVertexInputRate input_rate_to_vk[] = {
@@ -126,27 +142,53 @@ static VkSampleCountFlags sample_count_to_vk(PipelineSamplingFlags sampling_flag
     return sample_count_flags;
 }
 
-static VkPipeline pipeline_build(Device* device, PipelineOptions options) {
+static const VkGraphicsPipelineLibraryFlagsEXT pipeline_part_to_vk[] = {
+    [PIPELINE_PART_VERTEX_INPUT] = VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+    [PIPELINE_PART_PRE_RASTERIZATION] = VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+    [PIPELINE_PART_FRAGMENT] = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+    [PIPELINE_PART_FRAGMENT_OUTPUT] = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT
+};
+
+// library_parts is 0 for a complete pipeline, otherwise the VkGraphicsPipelineLibraryFlagsEXT the library holds.
+// State outside the library's parts is ignored by the driver, shader stages are filtered since they aren't
+static VkPipeline pipeline_build(Device* device, PipelineOptions options, VkGraphicsPipelineLibraryFlagsEXT library_parts) {
     void* device_handle = NULL;
     device_get_device(device, &device_handle);
 
-    VkPipelineShaderStageCreateInfo stages[options.shader_stages.shader_count];
+    void* pipeline_cache = NULL;
+    device_get_pipeline_cache(device, &pipeline_cache);
+
+    u32 stage_count = 0;
+    VkPipelineShaderStageCreateInfo stages[options.shader_stages.shader_count + 1];
+    Shader* stage_shaders[options.shader_stages.shader_count + 1];
     for (u32 i = 0; i < options.shader_stages.shader_count; i++) {
         Shader* shader = options.shader_stages.shaders[i];
 
         ShaderType type;
         shader_get_type(shader, &type);
 
+        if (library_parts != 0) {
+            VkGraphicsPipelineLibraryFlagsEXT stage_part = type == SHADER_FRAGMENT
+                ? VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT
+                : VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+            if (!(library_parts & stage_part)) {
+                continue;
+            }
+        }
+
+        // Held until the pipeline is created, a hot reload can swap the shader's module meanwhile
         void* module = NULL;
-        shader_get_module(shader, &module);
-
-        stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        stages[i].pNext = NULL;
-        stages[i].flags = 0;
-        stages[i].stage = shader_stage_to_vk[type];
-        stages[i].module = module;
-        stages[i].pName = "main";
-        stages[i].pSpecializationInfo = NULL;
+        shader_acquire_module(shader, &module);
+        stage_shaders[stage_count] = shader;
+
+        VkPipelineShaderStageCreateInfo* stage = &stages[stage_count++];
+        stage->sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stage->pNext = NULL;
+        stage->flags = 0;
+        stage->stage = shader_stage_to_vk[type];
+        stage->module = module;
+        stage->pName = "main";
+        stage->pSpecializationInfo = NULL;
     }
 
     VkVertexInputBindingDescription bindings[options.vertex_input.binding_count];
@@ -287,16 +329,21 @@ static VkPipeline pipeline_build(Device* device, PipelineOptions options) {
         .pScissors = NULL
     };
 
-    VkDynamicState dynamic_states[] = {
-        VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_SCISSOR
-    };
+    u32 dynamic_state_count = 0;
+    VkDynamicState dynamic_states[2 + sizeof(dynamic_state_to_vk) / sizeof(dynamic_state_to_vk[0])];
+    dynamic_states[dynamic_state_count++] = VK_DYNAMIC_STATE_VIEWPORT;
+    dynamic_states[dynamic_state_count++] = VK_DYNAMIC_STATE_SCISSOR;
+    for (u32 i = 0; i < sizeof(dynamic_state_to_vk) / sizeof(dynamic_state_to_vk[0]); i++) {
+        if (options.dynamic_state & dynamic_state_to_vk[i].flag) {
+            dynamic_states[dynamic_state_count++] = dynamic_state_to_vk[i].state;
+        }
+    }
 
     VkPipelineDynamicStateCreateInfo dynamic_state_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
         .pNext = NULL,
         .flags = 0,
-        .dynamicStateCount = sizeof(dynamic_states) / sizeof(dynamic_states[0]),
+        .dynamicStateCount = dynamic_state_count,
         .pDynamicStates = dynamic_states
     };
 
@@ -326,11 +373,21 @@ static VkPipeline pipeline_build(Device* device, PipelineOptions options) {
     void* layout = NULL;
     pipeline_layout_get_layout(options.layout, &layout);
 
+    // Libraries keep what the optimized link needs, so the fast-linked pipeline can be replaced later
+    VkGraphicsPipelineLibraryCreateInfoEXT library_info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+        .pNext = NULL,
+        .flags = library_parts
+    };
+    if (library_parts != 0) {
+        pipeline_rendering_info.pNext = &library_info;
+    }
+
     VkGraphicsPipelineCreateInfo graphics_pipeline_info = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
         .pNext = &pipeline_rendering_info,
-        .flags = 0,
-        .stageCount = options.shader_stages.shader_count,
+        .flags = library_parts != 0 ? VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT : 0,
+        .stageCount = stage_count,
         .pStages = stages,
         .pVertexInputState = &vertex_input_info,
         .pInputAssemblyState = &input_assembly_info,
@@ -351,12 +408,15 @@ static VkPipeline pipeline_build(Device* device, PipelineOptions options) {
     VkPipeline pipeline = NULL;
     VkResult create_graphics_pipeline = vkCreateGraphicsPipelines(
         device_handle, 
-        NULL, 
+        pipeline_cache, 
         1, 
         &graphics_pipeline_info, 
         NULL, 
         &pipeline
     );
+    for (u32 i = 0; i < stage_count; i++) {
+        shader_release_module(device, stage_shaders[i], stages[i].module);
+    }
     if (create_graphics_pipeline != VK_SUCCESS) {
         fprintf(stderr, "Failed to create a vulkan graphics pipeline! %d\n", create_graphics_pipeline);
         vkDestroyPipeline(device_handle, pipeline, NULL);
@@ -368,8 +428,9 @@ static VkPipeline pipeline_build(Device* device, PipelineOptions options) {
 PipelineResult pipeline_new(Device* device, PipelineOptions options, Pipeline** out_pipeline) {
     Pipeline* pipeline = malloc(sizeof(Pipeline));
     pipeline->pipeline = NULL;
+    pipeline->dynamic_state = options.dynamic_state;
 
-    VkPipeline pip = pipeline_build(device, options);
+    VkPipeline pip = pipeline_build(device, options, 0);
     if (pip == NULL) {
         pipeline_free(device, pipeline);
         return PIPELINE_ERROR_CREATE_HANDLE_FAIL;
@@ -380,6 +441,68 @@ PipelineResult pipeline_new(Device* device, PipelineOptions options, Pipeline**
     return PIPELINE_OK;
 }
 
+PipelineResult pipeline_new_library(Device* device, PipelineOptions options, PipelinePart part, Pipeline** out_pipeline) {
+    Pipeline* pipeline = malloc(sizeof(Pipeline));
+    pipeline->dynamic_state = options.dynamic_state;
+    pipeline->pipeline = pipeline_build(device, options, pipeline_part_to_vk[part]);
+    if (pipeline->pipeline == NULL) {
+        pipeline_free(device, pipeline);
+        return PIPELINE_ERROR_CREATE_HANDLE_FAIL;
+    }
+
+    *out_pipeline = pipeline;
+    return PIPELINE_OK;
+}
+
+PipelineResult pipeline_link(Device* device, Pipeline** libraries, u32 library_count, PipelineLayout* layout, PipelineLink link, Pipeline** out_pipeline) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    void* pipeline_cache = NULL;
+    device_get_pipeline_cache(device, &pipeline_cache);
+
+    PipelineDynamicState dynamic_state = PIPELINE_DYNAMIC_NONE;
+    VkPipeline library_handles[library_count + 1];
+    for (u32 i = 0; i < library_count; i++) {
+        library_handles[i] = libraries[i]->pipeline;
+        dynamic_state |= libraries[i]->dynamic_state;
+    }
+
+    VkPipelineLibraryCreateInfoKHR library_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+        .pNext = NULL,
+        .libraryCount = library_count,
+        .pLibraries = library_handles
+    };
+
+    void* layout_handle = NULL;
+    pipeline_layout_get_layout(layout, &layout_handle);
+
+    VkGraphicsPipelineCreateInfo graphics_pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = &library_info,
+        .flags = link == PIPELINE_LINK_OPTIMIZED ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0,
+        .layout = layout_handle,
+        .basePipelineHandle = NULL,
+        .basePipelineIndex = -1
+    };
+
+    Pipeline* pipeline = malloc(sizeof(Pipeline));
+    pipeline->pipeline = NULL;
+    pipeline->dynamic_state = dynamic_state;
+
+    VkResult link_graphics_pipeline = vkCreateGraphicsPipelines(device_handle, pipeline_cache, 1, &graphics_pipeline_info, NULL, &pipeline->pipeline);
+    if (link_graphics_pipeline != VK_SUCCESS) {
+        fprintf(stderr, "Failed to link a vulkan graphics pipeline! %d\n", link_graphics_pipeline);
+        pipeline->pipeline = NULL;
+        pipeline_free(device, pipeline);
+        return PIPELINE_ERROR_CREATE_HANDLE_FAIL;
+    }
+
+    *out_pipeline = pipeline;
+    return PIPELINE_OK;
+}
+
 void pipeline_free(Device* device, Pipeline* pipeline) {
     void* device_handle = NULL;
     device_get_device(device, &device_handle);
@@ -394,3 +517,23 @@ void pipeline_free(Device* device, Pipeline* pipeline) {
 void pipeline_get_pipeline(Pipeline* pipeline, void** out_pipeline) {
     *out_pipeline = pipeline->pipeline;
 }
+
+void pipeline_get_dynamic_state(Pipeline* pipeline, PipelineDynamicState* out_dynamic_state) {
+    *out_dynamic_state = pipeline->dynamic_state;
+}
+
+void pipeline_cull_mode_to_vk(PipelineCullMode cull_mode, u32* out_vk_cull_mode) {
+    *out_vk_cull_mode = cull_mode_to_vk[cull_mode];
+}
+
+void pipeline_front_face_to_vk(PipelineFrontFaceDirection front_face, u32* out_vk_front_face) {
+    *out_vk_front_face = front_face_to_vk[front_face];
+}
+
+void pipeline_topology_to_vk(PipelineTopology topology, u32* out_vk_topology) {
+    *out_vk_topology = topology_to_vk[topology];
+}
+
+void pipeline_compare_op_to_vk(PipelineCompareOp compare_op, u32* out_vk_compare_op) {
+    *out_vk_compare_op = compare_op_to_vk[compare_op];
+}
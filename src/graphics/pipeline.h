@@ -225,6 +225,33 @@ typedef struct {
     u32 attachment_count;
 } PipelineColorBlendOptions;
 
+// States set while recording (extended dynamic state) instead of being baked into the pipeline, pipelines
+// that only differ in them collapse into one. The values in PipelineOptions are ignored for dynamic states
+typedef enum PipelineDynamicStateFlags {
+    PIPELINE_DYNAMIC_NONE = 0,
+    PIPELINE_DYNAMIC_CULL_MODE = 1 << 0,
+    PIPELINE_DYNAMIC_FRONT_FACE = 1 << 1,
+    PIPELINE_DYNAMIC_TOPOLOGY = 1 << 2, // Only switches within a class (triangle list <-> triangle strip)
+    PIPELINE_DYNAMIC_DEPTH_TEST = 1 << 3,
+    PIPELINE_DYNAMIC_DEPTH_WRITE = 1 << 4,
+    PIPELINE_DYNAMIC_DEPTH_COMPARE_OP = 1 << 5,
+    PIPELINE_DYNAMIC_DEPTH_BIAS = 1 << 6, // Enable only, the bias factors stay baked in
+    PIPELINE_DYNAMIC_PRIMITIVE_RESTART = 1 << 7,
+    PIPELINE_DYNAMIC_ALL = (1 << 8) - 1
+} PipelineDynamicState;
+
+// Values for the dynamic states, see StateTracker
+typedef struct {
+    PipelineCullMode cull_mode;
+    PipelineFrontFaceDirection front_face_direction;
+    PipelineTopology topology;
+    bool depth_test;
+    bool depth_write;
+    PipelineCompareOp depth_compare_op;
+    bool depth_bias;
+    bool primitive_restart;
+} PipelineDynamicValues;
+
 typedef struct {
     PipelineShaderOptions shader_stages;
     PipelineVertexOptions vertex_input;
@@ -235,8 +262,23 @@ typedef struct {
     PipelineColorBlendOptions color_blending;
     PipelineRenderingOptions rendering;
     PipelineLayout* layout;
+    PipelineDynamicState dynamic_state;
 } PipelineOptions;
 
+// Independently compiled pieces of a graphics pipeline (VK_EXT_graphics_pipeline_library)
+typedef enum {
+    PIPELINE_PART_VERTEX_INPUT, // Vertex input and input assembly
+    PIPELINE_PART_PRE_RASTERIZATION, // Vertex shader, viewport and rasterization
+    PIPELINE_PART_FRAGMENT, // Fragment shader and depth/stencil
+    PIPELINE_PART_FRAGMENT_OUTPUT, // Color blending, multisampling and attachment formats
+    PIPELINE_PART_COUNT
+} PipelinePart;
+
+typedef enum {
+    PIPELINE_LINK_FAST, // Cheap to link, somewhat slower on the GPU than a monolithic pipeline
+    PIPELINE_LINK_OPTIMIZED // Link time optimized, costs about as much as a monolithic compile
+} PipelineLink;
+
 typedef enum {
     PIPELINE_OK, // Successfully created a pipeline
     PIPELINE_ERROR_CREATE_HANDLE_FAIL, // Failed to create the handle for the pipeline
@@ -245,6 +287,18 @@ typedef enum {
 PipelineResult pipeline_new(Device* device, PipelineOptions options, Pipeline** out_pipeline);
 void pipeline_free(Device* device, Pipeline* pipeline);
 
+// Only with DEVICE_CAPABILITY_GRAPHICS_PIPELINE_LIBRARY. A library can only be linked, never bound
+PipelineResult pipeline_new_library(Device* device, PipelineOptions options, PipelinePart part, Pipeline** out_pipeline);
+// Links one library of every part into a pipeline that can be bound, layout has to be the one the libraries used
+PipelineResult pipeline_link(Device* device, Pipeline** libraries, u32 library_count, PipelineLayout* layout, PipelineLink link, Pipeline** out_pipeline);
+
 void pipeline_get_pipeline(Pipeline* pipeline, void** out_pipeline);
+void pipeline_get_dynamic_state(Pipeline* pipeline, PipelineDynamicState* out_dynamic_state);
+
+// Vulkan values for the dynamic state setters (VkCullModeFlags, VkFrontFace, VkPrimitiveTopology, VkCompareOp)
+void pipeline_cull_mode_to_vk(PipelineCullMode cull_mode, u32* out_vk_cull_mode);
+void pipeline_front_face_to_vk(PipelineFrontFaceDirection front_face, u32* out_vk_front_face);
+void pipeline_topology_to_vk(PipelineTopology topology, u32* out_vk_topology);
+void pipeline_compare_op_to_vk(PipelineCompareOp compare_op, u32* out_vk_compare_op);
 
 #endif // PIPELINE_H
@@ -0,0 +1,455 @@
+#include "pipeline_compiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+
+typedef enum {
+    JOB_PART, // One pipeline library
+    JOB_LINK_OPTIMIZED, // Link time optimized pipeline from the finished libraries
+    JOB_MONOLITHIC // Whole pipeline at once, when the device has no pipeline libraries
+} JobKind;
+
+typedef struct Job {
+    JobKind kind;
+    PipelinePart part;
+    AsyncPipeline* pipeline;
+    struct Job* next;
+} Job;
+
+typedef struct AsyncPipeline {
+    // Copy of the requested options, the pointers inside point at the arrays below
+    PipelineOptions options;
+    Shader** shaders;
+    PipelineInputBinding* bindings;
+    PipelineInputAttribute* attributes;
+    PipelineColorBlendState* blend_states;
+    ColorFormat* colors;
+    u32 sample_masks[2];
+
+    Pipeline* libraries[PIPELINE_PART_COUNT];
+    SDL_AtomicInt parts_remaining; // The worker that takes it to 0 links the libraries
+
+    // Guarded by the compiler's lock
+    u32 jobs_in_flight;
+    Pipeline* finished_linked;
+    Pipeline* finished_optimized;
+    bool failed;
+    bool released;
+    bool rebuild_requested; // Starts once the jobs in flight are done
+    bool rebuilding; // The next finished pipeline replaces current even when current is already usable
+    u64 release_value;
+    struct AsyncPipeline* next;
+
+    // Only touched by pipeline_compiler_update and whoever reads the handle
+    Pipeline* current;
+    AsyncPipelineState state;
+} AsyncPipeline;
+
+typedef struct {
+    Pipeline* pipeline;
+    u64 retire_value; // Timeline value after which nothing uses the pipeline anymore
+} RetiredPipeline;
+
+typedef struct PipelineCompiler {
+    Device* device;
+    bool use_libraries;
+
+    SDL_Mutex* lock;
+    SDL_Condition* job_available;
+    Job* job_head;
+    Job* job_tail;
+    bool shutting_down;
+
+    SDL_Thread** threads;
+    u32 thread_count;
+
+    AsyncPipeline* pipelines; // Every handle that hasn't been destroyed yet, guarded by the lock
+
+    // Only touched by pipeline_compiler_update and pipeline_compiler_free
+    RetiredPipeline* retired;
+    u32 retired_count;
+    u32 retired_capacity;
+} PipelineCompiler;
+
+// Caller holds the lock
+static void pipeline_compiler_push_job(PipelineCompiler* compiler, AsyncPipeline* pipeline, JobKind kind, PipelinePart part) {
+    Job* job = malloc(sizeof(Job));
+    job->kind = kind;
+    job->part = part;
+    job->pipeline = pipeline;
+    job->next = NULL;
+
+    if (compiler->job_tail) {
+        compiler->job_tail->next = job;
+    } else {
+        compiler->job_head = job;
+    }
+    compiler->job_tail = job;
+    pipeline->jobs_in_flight++;
+    SDL_SignalCondition(compiler->job_available);
+}
+
+static void pipeline_compiler_finish(PipelineCompiler* compiler, AsyncPipeline* pipeline, PipelineResult result, Pipeline* built, bool optimized) {
+    SDL_LockMutex(compiler->lock);
+    if (result != PIPELINE_OK) {
+        pipeline->failed = true;
+    } else if (optimized) {
+        pipeline->finished_optimized = built;
+    } else {
+        pipeline->finished_linked = built;
+    }
+    SDL_UnlockMutex(compiler->lock);
+}
+
+static void pipeline_compiler_run_job(PipelineCompiler* compiler, Job* job) {
+    AsyncPipeline* pipeline = job->pipeline;
+    Device* device = compiler->device;
+
+    if (job->kind == JOB_MONOLITHIC) {
+        Pipeline* built = NULL;
+        PipelineResult result = pipeline_new(device, pipeline->options, &built);
+        pipeline_compiler_finish(compiler, pipeline, result, built, true);
+        return;
+    }
+
+    if (job->kind == JOB_LINK_OPTIMIZED) {
+        Pipeline* built = NULL;
+        PipelineResult result = pipeline_link(device, pipeline->libraries, PIPELINE_PART_COUNT, pipeline->options.layout, PIPELINE_LINK_OPTIMIZED, &built);
+        pipeline_compiler_finish(compiler, pipeline, result, built, true);
+        return;
+    }
+
+    PipelineResult part_result = pipeline_new_library(device, pipeline->options, job->part, &pipeline->libraries[job->part]);
+    if (part_result != PIPELINE_OK) {
+        pipeline->libraries[job->part] = NULL;
+        pipeline_compiler_finish(compiler, pipeline, part_result, NULL, false);
+    }
+
+    // Last part to finish links, the atomic makes every other worker's library visible here
+    if (SDL_AddAtomicInt(&pipeline->parts_remaining, -1) != 1) {
+        return;
+    }
+    for (u32 i = 0; i < PIPELINE_PART_COUNT; i++) {
+        if (pipeline->libraries[i] == NULL) {
+            return;
+        }
+    }
+
+    Pipeline* linked = NULL;
+    PipelineResult link_result = pipeline_link(device, pipeline->libraries, PIPELINE_PART_COUNT, pipeline->options.layout, PIPELINE_LINK_FAST, &linked);
+    if (link_result != PIPELINE_OK) {
+        linked = NULL;
+    }
+
+    // Queued behind whatever else is waiting, a linked pipeline is good enough until the queue clears
+    SDL_LockMutex(compiler->lock);
+    pipeline->finished_linked = linked;
+    pipeline_compiler_push_job(compiler, pipeline, JOB_LINK_OPTIMIZED, 0);
+    SDL_UnlockMutex(compiler->lock);
+}
+
+static int pipeline_compiler_worker(void* data) {
+    PipelineCompiler* compiler = data;
+
+    SDL_LockMutex(compiler->lock);
+    while (true) {
+        while (compiler->job_head == NULL && !compiler->shutting_down) {
+            SDL_WaitCondition(compiler->job_available, compiler->lock);
+        }
+        if (compiler->shutting_down) {
+            break;
+        }
+
+        Job* job = compiler->job_head;
+        compiler->job_head = job->next;
+        if (compiler->job_head == NULL) {
+            compiler->job_tail = NULL;
+        }
+
+        // Nobody's going to look at a released pipeline, don't waste the time compiling it
+        bool skip = job->pipeline->released;
+        SDL_UnlockMutex(compiler->lock);
+
+        if (!skip) {
+            pipeline_compiler_run_job(compiler, job);
+        }
+
+        SDL_LockMutex(compiler->lock);
+        job->pipeline->jobs_in_flight--;
+        free(job);
+    }
+    SDL_UnlockMutex(compiler->lock);
+    return 0;
+}
+
+PipelineCompilerResult pipeline_compiler_new(Device* device, PipelineCompilerOptions options, PipelineCompiler** out_compiler) {
+    PipelineCompiler* compiler = calloc(1, sizeof(PipelineCompiler));
+    compiler->device = device;
+    compiler->use_libraries = device_has_capability(device, DEVICE_CAPABILITY_GRAPHICS_PIPELINE_LIBRARY);
+
+    compiler->lock = SDL_CreateMutex();
+    compiler->job_available = SDL_CreateCondition();
+    if (compiler->lock == NULL || compiler->job_available == NULL) {
+        fprintf(stderr, "Failed to create pipeline compiler lock! %s\n", SDL_GetError());
+        pipeline_compiler_free(device, compiler);
+        return PIPELINE_COMPILER_ERROR_CREATE_LOCK_FAIL;
+    }
+
+    u32 thread_count = options.thread_count;
+    if (thread_count == 0) {
+        int core_count = SDL_GetNumLogicalCPUCores();
+        thread_count = core_count > 2 ? (u32)core_count - 1 : 1;
+    }
+
+    compiler->threads = calloc(thread_count, sizeof(SDL_Thread*));
+    for (u32 i = 0; i < thread_count; i++) {
+        compiler->threads[i] = SDL_CreateThread(pipeline_compiler_worker, "pipeline compiler", compiler);
+        if (compiler->threads[i] == NULL) {
+            fprintf(stderr, "Failed to start pipeline compiler thread %d! %s\n", i, SDL_GetError());
+            pipeline_compiler_free(device, compiler);
+            return PIPELINE_COMPILER_ERROR_CREATE_THREAD_FAIL;
+        }
+        compiler->thread_count++;
+    }
+
+    *out_compiler = compiler;
+    return PIPELINE_COMPILER_OK;
+}
+
+static void async_pipeline_destroy(Device* device, AsyncPipeline* pipeline) {
+    Pipeline* owned[] = {pipeline->current, pipeline->finished_linked, pipeline->finished_optimized};
+    for (u32 i = 0; i < sizeof(owned) / sizeof(owned[0]); i++) {
+        if (owned[i]) {
+            pipeline_free(device, owned[i]);
+        }
+    }
+    for (u32 i = 0; i < PIPELINE_PART_COUNT; i++) {
+        if (pipeline->libraries[i]) {
+            pipeline_free(device, pipeline->libraries[i]);
+        }
+    }
+
+    free(pipeline->shaders);
+    free(pipeline->bindings);
+    free(pipeline->attributes);
+    free(pipeline->blend_states);
+    free(pipeline->colors);
+    free(pipeline);
+}
+
+void pipeline_compiler_free(Device* device, PipelineCompiler* compiler) {
+    if (compiler->lock) {
+        SDL_LockMutex(compiler->lock);
+        compiler->shutting_down = true;
+        SDL_BroadcastCondition(compiler->job_available);
+        SDL_UnlockMutex(compiler->lock);
+    }
+
+    // Workers finish the job they're on and stop, whatever's still queued is dropped
+    for (u32 i = 0; i < compiler->thread_count; i++) {
+        SDL_WaitThread(compiler->threads[i], NULL);
+    }
+    free(compiler->threads);
+
+    while (compiler->job_head) {
+        Job* job = compiler->job_head;
+        compiler->job_head = job->next;
+        free(job);
+    }
+
+    while (compiler->pipelines) {
+        AsyncPipeline* pipeline = compiler->pipelines;
+        compiler->pipelines = pipeline->next;
+        async_pipeline_destroy(device, pipeline);
+    }
+
+    for (u32 i = 0; i < compiler->retired_count; i++) {
+        pipeline_free(device, compiler->retired[i].pipeline);
+    }
+    free(compiler->retired);
+
+    if (compiler->job_available) {
+        SDL_DestroyCondition(compiler->job_available);
+    }
+    if (compiler->lock) {
+        SDL_DestroyMutex(compiler->lock);
+    }
+    free(compiler);
+}
+
+// Caller holds the lock
+static void pipeline_compiler_queue(PipelineCompiler* compiler, AsyncPipeline* pipeline) {
+    if (compiler->use_libraries) {
+        SDL_SetAtomicInt(&pipeline->parts_remaining, PIPELINE_PART_COUNT);
+        for (u32 i = 0; i < PIPELINE_PART_COUNT; i++) {
+            pipeline_compiler_push_job(compiler, pipeline, JOB_PART, (PipelinePart)i);
+        }
+    } else {
+        pipeline_compiler_push_job(compiler, pipeline, JOB_MONOLITHIC, 0);
+    }
+}
+
+static void* copy_array(const void* data, usize size) {
+    if (data == NULL || size == 0) {
+        return NULL;
+    }
+    void* copy = malloc(size);
+    memcpy(copy, data, size);
+    return copy;
+}
+
+void pipeline_compiler_request(PipelineCompiler* compiler, PipelineOptions options, AsyncPipeline** out_pipeline) {
+    AsyncPipeline* pipeline = calloc(1, sizeof(AsyncPipeline));
+    pipeline->state = ASYNC_PIPELINE_PENDING;
+
+    pipeline->shaders = copy_array(options.shader_stages.shaders, options.shader_stages.shader_count * sizeof(Shader*));
+    pipeline->bindings = copy_array(options.vertex_input.bindings, options.vertex_input.binding_count * sizeof(PipelineInputBinding));
+    pipeline->attributes = copy_array(options.vertex_input.attributes, options.vertex_input.attribute_count * sizeof(PipelineInputAttribute));
+    pipeline->blend_states = copy_array(options.color_blending.color_blend_states, options.color_blending.attachment_count * sizeof(PipelineColorBlendState));
+    pipeline->colors = copy_array(options.rendering.colors, options.rendering.color_count * sizeof(ColorFormat));
+
+    pipeline->options = options;
+    pipeline->options.shader_stages.shaders = pipeline->shaders;
+    pipeline->options.vertex_input.bindings = pipeline->bindings;
+    pipeline->options.vertex_input.attributes = pipeline->attributes;
+    pipeline->options.color_blending.color_blend_states = pipeline->blend_states;
+    pipeline->options.rendering.colors = pipeline->colors;
+    if (options.multisampling.sample_masks) {
+        // One VkSampleMask covers up to 32 samples, past that there's a second
+        u32 mask_count = options.multisampling.sample_flag > PIPELINE_SAMPLECOUNT32 ? 2 : 1;
+        memcpy(pipeline->sample_masks, options.multisampling.sample_masks, mask_count * sizeof(u32));
+        pipeline->options.multisampling.sample_masks = pipeline->sample_masks;
+    }
+
+    SDL_LockMutex(compiler->lock);
+    pipeline->next = compiler->pipelines;
+    compiler->pipelines = pipeline;
+    pipeline_compiler_queue(compiler, pipeline);
+    SDL_UnlockMutex(compiler->lock);
+
+    *out_pipeline = pipeline;
+}
+
+void pipeline_compiler_rebuild(PipelineCompiler* compiler, Shader* shader) {
+    SDL_LockMutex(compiler->lock);
+    for (AsyncPipeline* pipeline = compiler->pipelines; pipeline; pipeline = pipeline->next) {
+        for (u32 i = 0; i < pipeline->options.shader_stages.shader_count; i++) {
+            if (pipeline->shaders[i] == shader) {
+                pipeline->rebuild_requested = true;
+                break;
+            }
+        }
+    }
+    SDL_UnlockMutex(compiler->lock);
+}
+
+void pipeline_compiler_release(PipelineCompiler* compiler, AsyncPipeline* pipeline, u64 retire_value) {
+    SDL_LockMutex(compiler->lock);
+    pipeline->released = true;
+    pipeline->release_value = retire_value;
+    SDL_UnlockMutex(compiler->lock);
+}
+
+static void pipeline_compiler_retire(PipelineCompiler* compiler, Pipeline* pipeline, u64 retire_value) {
+    if (pipeline == NULL) {
+        return;
+    }
+
+    if (compiler->retired_count == compiler->retired_capacity) {
+        compiler->retired_capacity = compiler->retired_capacity > 0 ? compiler->retired_capacity * 2 : 16;
+        compiler->retired = realloc(compiler->retired, compiler->retired_capacity * sizeof(RetiredPipeline));
+    }
+    compiler->retired[compiler->retired_count++] = (RetiredPipeline){
+        .pipeline = pipeline,
+        .retire_value = retire_value
+    };
+}
+
+static void pipeline_compiler_retire_libraries(PipelineCompiler* compiler, AsyncPipeline* pipeline, u64 retire_value) {
+    for (u32 i = 0; i < PIPELINE_PART_COUNT; i++) {
+        pipeline_compiler_retire(compiler, pipeline->libraries[i], retire_value);
+        pipeline->libraries[i] = NULL;
+    }
+}
+
+void pipeline_compiler_update(Device* device, PipelineCompiler* compiler, u64 completed_value, u64 retire_value) {
+    SDL_LockMutex(compiler->lock);
+
+    AsyncPipeline** link = &compiler->pipelines;
+    while (*link) {
+        AsyncPipeline* pipeline = *link;
+
+        if (pipeline->released) {
+            // Workers may still be writing into it until its last job is done
+            if (pipeline->jobs_in_flight == 0) {
+                pipeline_compiler_retire(compiler, pipeline->current, pipeline->release_value);
+                pipeline_compiler_retire(compiler, pipeline->finished_linked, pipeline->release_value);
+                pipeline_compiler_retire(compiler, pipeline->finished_optimized, pipeline->release_value);
+                pipeline_compiler_retire_libraries(compiler, pipeline, pipeline->release_value);
+                pipeline->current = NULL;
+                pipeline->finished_linked = NULL;
+                pipeline->finished_optimized = NULL;
+
+                *link = pipeline->next;
+                async_pipeline_destroy(device, pipeline);
+                continue;
+            }
+        } else if (pipeline->finished_optimized) {
+            // Frames already recorded may still bind the linked pipeline
+            pipeline_compiler_retire(compiler, pipeline->current, retire_value);
+            pipeline_compiler_retire(compiler, pipeline->finished_linked, retire_value);
+            pipeline_compiler_retire_libraries(compiler, pipeline, retire_value);
+            pipeline->current = pipeline->finished_optimized;
+            pipeline->finished_optimized = NULL;
+            pipeline->finished_linked = NULL;
+            pipeline->state = ASYNC_PIPELINE_OPTIMIZED;
+            pipeline->rebuilding = false;
+        } else if (pipeline->finished_linked && (pipeline->current == NULL || pipeline->rebuilding)) {
+            pipeline_compiler_retire(compiler, pipeline->current, retire_value);
+            pipeline->current = pipeline->finished_linked;
+            pipeline->finished_linked = NULL;
+            pipeline->state = ASYNC_PIPELINE_LINKED;
+            pipeline->rebuilding = false;
+        } else if (pipeline->failed && pipeline->jobs_in_flight == 0) {
+            // A failed rebuild keeps the last working pipeline
+            if (pipeline->current == NULL) {
+                pipeline->state = ASYNC_PIPELINE_FAILED;
+            }
+            pipeline->rebuilding = false;
+        }
+
+        if (!pipeline->released && pipeline->rebuild_requested && pipeline->jobs_in_flight == 0) {
+            // Libraries left over from a failed compile belong to the old shaders
+            pipeline_compiler_retire(compiler, pipeline->finished_linked, retire_value);
+            pipeline_compiler_retire_libraries(compiler, pipeline, retire_value);
+            pipeline->finished_linked = NULL;
+            pipeline->failed = false;
+            pipeline->rebuild_requested = false;
+            pipeline->rebuilding = true;
+            pipeline_compiler_queue(compiler, pipeline);
+        }
+
+        link = &pipeline->next;
+    }
+    SDL_UnlockMutex(compiler->lock);
+
+    u32 kept = 0;
+    for (u32 i = 0; i < compiler->retired_count; i++) {
+        if (compiler->retired[i].retire_value <= completed_value) {
+            pipeline_free(device, compiler->retired[i].pipeline);
+        } else {
+            compiler->retired[kept++] = compiler->retired[i];
+        }
+    }
+    compiler->retired_count = kept;
+}
+
+void async_pipeline_get(AsyncPipeline* pipeline, Pipeline** out_pipeline, AsyncPipelineState* out_state) {
+    *out_pipeline = pipeline->current;
+    *out_state = pipeline->state;
+}
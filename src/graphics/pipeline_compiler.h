@@ -0,0 +1,56 @@
+#ifndef PIPELINE_COMPILER_H
+#define PIPELINE_COMPILER_H
+
+#include "device.h"
+#include "pipeline.h"
+#include "../int_types.h"
+
+// Compiles graphics pipelines on worker threads so a new material never stalls a frame.
+// With DEVICE_CAPABILITY_GRAPHICS_PIPELINE_LIBRARY the four pipeline parts compile in parallel and are
+// fast-linked as soon as they're done, then a link time optimized pipeline replaces the linked one.
+// Without it a monolithic pipeline is compiled in the background instead
+typedef struct PipelineCompiler PipelineCompiler;
+
+// Handle to a pipeline that's compiling or compiled, what it resolves to only changes in pipeline_compiler_update
+typedef struct AsyncPipeline AsyncPipeline;
+
+typedef struct {
+    u32 thread_count; // Worker threads, 0 uses one less than the number of cores
+} PipelineCompilerOptions;
+
+typedef enum {
+    ASYNC_PIPELINE_PENDING, // Nothing to bind yet, skip draws that need it
+    ASYNC_PIPELINE_LINKED, // Fast-linked from libraries, usable while the optimized pipeline compiles
+    ASYNC_PIPELINE_OPTIMIZED, // Final pipeline, won't change anymore
+    ASYNC_PIPELINE_FAILED // Compiling failed, never resolves to anything
+} AsyncPipelineState;
+
+typedef enum {
+    PIPELINE_COMPILER_OK, // Successfully created a pipeline compiler
+    PIPELINE_COMPILER_ERROR_CREATE_LOCK_FAIL, // Failed to create the lock/condition guarding the job queue
+    PIPELINE_COMPILER_ERROR_CREATE_THREAD_FAIL, // Failed to start a worker thread
+} PipelineCompilerResult;
+
+PipelineCompilerResult pipeline_compiler_new(Device* device, PipelineCompilerOptions options, PipelineCompiler** out_compiler);
+// Waits for compiles in flight and destroys every pipeline it made, the GPU has to be done with them
+void pipeline_compiler_free(Device* device, PipelineCompiler* compiler);
+
+// Queues a compile and returns right away. Everything options points at is copied, except shaders and
+// the layout which have to stay alive until the handle resolves to ASYNC_PIPELINE_OPTIMIZED or ASYNC_PIPELINE_FAILED
+void pipeline_compiler_request(PipelineCompiler* compiler, PipelineOptions options, AsyncPipeline** out_pipeline);
+
+// The pipeline is destroyed once the timeline reaches retire_value (see pipeline_compiler_update)
+void pipeline_compiler_release(PipelineCompiler* compiler, AsyncPipeline* pipeline, u64 retire_value);
+
+// Recompiles every handle built from shader (e.g. after shader_reload). The handle keeps resolving to the
+// old pipeline until the new one is linked, then pipeline_compiler_update swaps it in and retires the old one
+void pipeline_compiler_rebuild(PipelineCompiler* compiler, Shader* shader);
+
+// Call once per frame before recording. Swaps finished compiles into their handles, pipelines they replace
+// stay alive until completed_value reaches retire_value (e.g. renderer_get_completed_value and renderer_get_frame_value)
+void pipeline_compiler_update(Device* device, PipelineCompiler* compiler, u64 completed_value, u64 retire_value);
+
+// out_pipeline is NULL while the state is ASYNC_PIPELINE_PENDING or ASYNC_PIPELINE_FAILED
+void async_pipeline_get(AsyncPipeline* pipeline, Pipeline** out_pipeline, AsyncPipelineState* out_state);
+
+#endif // PIPELINE_COMPILER_H
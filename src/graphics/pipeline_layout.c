@@ -1,29 +1,123 @@
 #include "pipeline_layout.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <SDL3/SDL_atomic.h>
 #include <vulkan/vulkan.h>
 
 
+#define PIPELINE_LAYOUT_NO_PUSH_SET UINT32_MAX
+
 typedef struct PipelineLayout {
+    u64 id; // Never reused, unlike the handle once the layout is freed
     VkPipelineLayout layout;
+    VkDescriptorSetLayout* set_layouts;
+    u32 set_layout_count;
+    u32 push_set; // PIPELINE_LAYOUT_NO_PUSH_SET when no set is a push set
 } PipelineLayout;
 
+static SDL_AtomicInt next_layout_id;
+
+static const VkDescriptorType descriptor_type_to_vk[] = {
+    [DESCRIPTOR_UNIFORM_BUFFER] = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+    [DESCRIPTOR_STORAGE_BUFFER] = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    [DESCRIPTOR_SAMPLED_IMAGE] = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    [DESCRIPTOR_STORAGE_IMAGE] = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+    [DESCRIPTOR_COMBINED_IMAGE_SAMPLER] = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+};
+
+static VkShaderStageFlags shader_stages_to_vk(ShaderStage stages) {
+    VkShaderStageFlags shader_stage_flags = 0;
+
+    if (stages & SHADER_STAGE_VERTEX) shader_stage_flags |= VK_SHADER_STAGE_VERTEX_BIT;
+    if (stages & SHADER_STAGE_FRAGMENT) shader_stage_flags |= VK_SHADER_STAGE_FRAGMENT_BIT;
+    if (stages & SHADER_STAGE_COMPUTE) shader_stage_flags |= VK_SHADER_STAGE_COMPUTE_BIT;
+
+    return shader_stage_flags;
+}
+
 
-PipelineLayoutResult pipeline_layout_new(Device* device, PipelineLayout** out_layout) {
+PipelineLayoutResult pipeline_layout_new(Device* device, PipelineLayoutOptions options, PipelineLayout** out_layout) {
     void* device_handle = NULL;
     device_get_device(device, &device_handle);
 
     PipelineLayout* layout = malloc(sizeof(PipelineLayout));
+    layout->id = (u64)(u32)SDL_AddAtomicInt(&next_layout_id, 1) + 1;
     layout->layout = NULL;
+    layout->set_layouts = calloc(options.set_layout_count + 1, sizeof(VkDescriptorSetLayout));
+    layout->set_layout_count = options.set_layout_count;
+    layout->push_set = PIPELINE_LAYOUT_NO_PUSH_SET;
+
+    for (u32 i = 0; i < options.set_layout_count; i++) {
+        DescriptorSetLayoutOptions set = options.set_layouts[i];
+        if (set.push) {
+            if (layout->push_set != PIPELINE_LAYOUT_NO_PUSH_SET) {
+                fprintf(stderr, "Failed to create pipeline layout, sets %d and %d are both push sets!\n", layout->push_set, i);
+                pipeline_layout_free(device, layout);
+                return PIPELINE_LAYOUT_ERROR_MULTIPLE_PUSH_SETS;
+            }
+            layout->push_set = i;
+
+            u32 max_push_descriptors = 0;
+            device_get_max_push_descriptors(device, &max_push_descriptors);
+
+            u32 descriptor_count = 0;
+            for (u32 j = 0; j < set.binding_count; j++) {
+                descriptor_count += set.bindings[j].count > 0 ? set.bindings[j].count : 1;
+            }
+            if (descriptor_count > max_push_descriptors) {
+                fprintf(stderr, "Failed to create pipeline layout, push set %d has %d descriptors but the device allows %d!\n", i, descriptor_count, max_push_descriptors);
+                pipeline_layout_free(device, layout);
+                return PIPELINE_LAYOUT_ERROR_TOO_MANY_PUSH_DESCRIPTORS;
+            }
+        }
+
+        VkDescriptorSetLayoutBinding bindings[set.binding_count + 1];
+        for (u32 j = 0; j < set.binding_count; j++) {
+            DescriptorBinding binding = set.bindings[j];
+            bindings[j] = (VkDescriptorSetLayoutBinding){
+                .binding = binding.binding,
+                .descriptorType = descriptor_type_to_vk[binding.type],
+                .descriptorCount = binding.count > 0 ? binding.count : 1,
+                .stageFlags = shader_stages_to_vk(binding.stages),
+                .pImmutableSamplers = NULL
+            };
+        }
+
+        VkDescriptorSetLayoutCreateInfo set_layout_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = NULL,
+            .flags = set.push ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0,
+            .bindingCount = set.binding_count,
+            .pBindings = bindings
+        };
+
+        VkResult create_set_layout = vkCreateDescriptorSetLayout(device_handle, &set_layout_info, NULL, &layout->set_layouts[i]);
+        if (create_set_layout != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create vulkan descriptor set layout for set %d! %d\n", i, create_set_layout);
+            layout->set_layouts[i] = NULL;
+            pipeline_layout_free(device, layout);
+            return PIPELINE_LAYOUT_ERROR_CREATE_SET_LAYOUT_FAIL;
+        }
+    }
+
+    VkPushConstantRange push_constant_ranges[options.push_constant_range_count + 1]; // +1 keeps the array non-empty
+    for (u32 i = 0; i < options.push_constant_range_count; i++) {
+        PushConstantRange range = options.push_constant_ranges[i];
+        push_constant_ranges[i] = (VkPushConstantRange){
+            .stageFlags = shader_stages_to_vk(range.stages),
+            .offset = range.offset,
+            .size = range.size
+        };
+    }
 
     VkPipelineLayoutCreateInfo pipeline_layout_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .pNext = NULL,
         .flags = 0,
-        .setLayoutCount = 0,
-        .pSetLayouts = NULL,
-        .pushConstantRangeCount = 0,
-        .pPushConstantRanges = NULL
+        .setLayoutCount = options.set_layout_count,
+        .pSetLayouts = layout->set_layouts,
+        .pushConstantRangeCount = options.push_constant_range_count,
+        .pPushConstantRanges = push_constant_ranges
     };
 
     VkResult create_pipeline_layout = vkCreatePipelineLayout(
@@ -50,9 +144,35 @@ void pipeline_layout_free(Device* device, PipelineLayout* layout) {
         vkDestroyPipelineLayout(device_handle, layout->layout, NULL);
         layout->layout = NULL;
     }
+    for (u32 i = 0; i < layout->set_layout_count; i++) {
+        if (layout->set_layouts[i]) {
+            vkDestroyDescriptorSetLayout(device_handle, layout->set_layouts[i], NULL);
+        }
+    }
+    free(layout->set_layouts);
     free(layout);
 }
 
 void pipeline_layout_get_layout(PipelineLayout* layout, void** out_layout) {
     *out_layout = layout->layout;
-}
\ No newline at end of file
+}
+
+void pipeline_layout_get_id(PipelineLayout* layout, u64* out_id) {
+    *out_id = layout->id;
+}
+
+void pipeline_layout_get_set_layout(PipelineLayout* layout, u32 set, void** out_set_layout) {
+    *out_set_layout = layout->set_layouts[set];
+}
+
+bool pipeline_layout_get_push_set(PipelineLayout* layout, u32* out_set) {
+    if (layout->push_set == PIPELINE_LAYOUT_NO_PUSH_SET) {
+        return false;
+    }
+    *out_set = layout->push_set;
+    return true;
+}
+
+void pipeline_layout_descriptor_type_to_vk(DescriptorType type, u32* out_vk_type) {
+    *out_vk_type = descriptor_type_to_vk[type];
+}
@@ -2,17 +2,72 @@
 #define PIPELINE_LAYOUT_H
 
 #include "device.h"
+#include "shader.h"
+#include "../int_types.h"
 
 typedef struct PipelineLayout PipelineLayout;
 
+typedef struct {
+    ShaderStage stages; // Stages that read this range
+    u32 offset;
+    u32 size;
+} PushConstantRange;
+
+typedef enum {
+    DESCRIPTOR_UNIFORM_BUFFER,
+    DESCRIPTOR_STORAGE_BUFFER,
+    DESCRIPTOR_SAMPLED_IMAGE,
+    DESCRIPTOR_STORAGE_IMAGE,
+    DESCRIPTOR_COMBINED_IMAGE_SAMPLER
+} DescriptorType;
+
+typedef enum {
+    BIND_POINT_GRAPHICS,
+    BIND_POINT_COMPUTE
+} PipelineBindPoint;
+
+typedef struct {
+    u32 binding;
+    DescriptorType type;
+    u32 count; // Array size, 0 is treated as 1
+    ShaderStage stages; // Stages that read the binding
+} DescriptorBinding;
+
+typedef struct {
+    DescriptorBinding* bindings;
+    u32 binding_count;
+    // Written straight into the command buffer with renderer_push_descriptors instead of being allocated
+    // from a pool, only one set per layout can be a push set and its descriptor counts can't add up past
+    // the device's maxPushDescriptors (see device_get_max_push_descriptors)
+    bool push;
+} DescriptorSetLayoutOptions;
+
+typedef struct {
+    PushConstantRange* push_constant_ranges; // e.g. buffer device addresses handed to shaders per draw
+    u32 push_constant_range_count;
+    DescriptorSetLayoutOptions* set_layouts; // Set i in the shaders is set_layouts[i]
+    u32 set_layout_count;
+} PipelineLayoutOptions;
+
 typedef enum {
     PIPELINE_LAYOUT_OK, // Successfully created a pipeline layout
     PIPELINE_LAYOUT_ERROR_CREATE_HANDLE_FAIL, // Failed to create the handle for the pipeline layout
+    PIPELINE_LAYOUT_ERROR_CREATE_SET_LAYOUT_FAIL, // Failed to create the handle for a descriptor set layout
+    PIPELINE_LAYOUT_ERROR_MULTIPLE_PUSH_SETS, // More than one set layout is flagged as a push set
+    PIPELINE_LAYOUT_ERROR_TOO_MANY_PUSH_DESCRIPTORS, // The push set holds more descriptors than the device's maxPushDescriptors
 } PipelineLayoutResult;
 
-PipelineLayoutResult pipeline_layout_new(Device* device, PipelineLayout** out_layout);
+PipelineLayoutResult pipeline_layout_new(Device* device, PipelineLayoutOptions options, PipelineLayout** out_layout);
 void pipeline_layout_free(Device* device, PipelineLayout* layout);
 
 void pipeline_layout_get_layout(PipelineLayout* layout, void** out_layout);
+// Unique for the life of the process, unlike the Vulkan handle which the driver can hand out again after a free
+void pipeline_layout_get_id(PipelineLayout* layout, u64* out_id);
+void pipeline_layout_get_set_layout(PipelineLayout* layout, u32 set, void** out_set_layout);
+// Returns false when none of the layout's sets is a push set
+bool pipeline_layout_get_push_set(PipelineLayout* layout, u32* out_set);
+
+// VkDescriptorType for a DescriptorType
+void pipeline_layout_descriptor_type_to_vk(DescriptorType type, u32* out_vk_type);
 
 #endif // PIPELINE_LAYOUT_H
@@ -0,0 +1,387 @@
+#include "pipeline_registry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_mutex.h>
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+// Load factor the map grows past, counting tombstones since they lengthen probes just the same
+#define PIPELINE_REGISTRY_MAX_LOAD 0.7
+
+typedef enum {
+    ENTRY_EMPTY,
+    ENTRY_LIVE,
+    ENTRY_TOMBSTONE // Released entry, keeps probe chains through it intact
+} EntryState;
+
+typedef struct {
+    EntryState state;
+    u64 hash;
+    u8* key; // Serialized options, compared on hash matches so a collision can't hand out the wrong pipeline
+    u32 key_size;
+    Pipeline* pipeline;
+    SDL_AtomicInt references; // Bumped under the read lock, so it has to be atomic
+} Entry;
+
+typedef struct PipelineRegistry {
+    SDL_RWLock* lock; // Readers look up and add references, writers insert, release and grow
+    Entry* entries;
+    u32 capacity; // Power of two
+    u32 live_count;
+    u32 used_count; // Live plus tombstones
+
+    SDL_AtomicInt hit_count;
+    SDL_AtomicInt miss_count;
+} PipelineRegistry;
+
+typedef struct {
+    u8* data;
+    u32 size;
+    u32 capacity;
+} KeyWriter;
+
+static void key_write(KeyWriter* writer, const void* data, u32 size) {
+    if (writer->size + size > writer->capacity) {
+        while (writer->size + size > writer->capacity) {
+            writer->capacity = writer->capacity > 0 ? writer->capacity * 2 : 256;
+        }
+        writer->data = realloc(writer->data, writer->capacity);
+    }
+    memcpy(writer->data + writer->size, data, size);
+    writer->size += size;
+}
+
+// Every field is written on its own so padding never ends up in the key
+static void key_write_u32(KeyWriter* writer, u32 value) {
+    key_write(writer, &value, sizeof(value));
+}
+
+static void key_write_u64(KeyWriter* writer, u64 value) {
+    key_write(writer, &value, sizeof(value));
+}
+
+static void key_write_f32(KeyWriter* writer, f32 value) {
+    key_write(writer, &value, sizeof(value));
+}
+
+// Baked values of dynamic states are left out so pipelines that only differ in them share an entry
+static void key_write_baked_u32(KeyWriter* writer, PipelineDynamicState dynamic_state, PipelineDynamicState flag, u32 value) {
+    if (!(dynamic_state & flag)) {
+        key_write_u32(writer, value);
+    }
+}
+
+static void pipeline_options_write_key(PipelineOptions options, KeyWriter* writer) {
+    PipelineDynamicState dynamic = options.dynamic_state;
+    key_write_u32(writer, dynamic);
+
+    key_write_u32(writer, options.shader_stages.shader_count);
+    for (u32 i = 0; i < options.shader_stages.shader_count; i++) {
+        // The shader and its version rather than the module, a reloaded module's handle can be reused
+        Shader* shader = options.shader_stages.shaders[i];
+        u32 version = 0;
+        shader_get_version(shader, &version);
+        ShaderType type;
+        shader_get_type(shader, &type);
+        key_write_u64(writer, (u64)(uintptr_t)shader);
+        key_write_u32(writer, version);
+        key_write_u32(writer, type);
+    }
+
+    key_write_u32(writer, options.vertex_input.binding_count);
+    for (u32 i = 0; i < options.vertex_input.binding_count; i++) {
+        PipelineInputBinding binding = options.vertex_input.bindings[i];
+        key_write_u32(writer, binding.binding);
+        key_write_u32(writer, binding.stride);
+        key_write_u32(writer, binding.rate);
+    }
+    key_write_u32(writer, options.vertex_input.attribute_count);
+    for (u32 i = 0; i < options.vertex_input.attribute_count; i++) {
+        PipelineInputAttribute attribute = options.vertex_input.attributes[i];
+        key_write_u32(writer, attribute.location);
+        key_write_u32(writer, attribute.binding);
+        key_write_u32(writer, attribute.format);
+        key_write_u32(writer, attribute.offset);
+    }
+
+    // Every PipelineTopology is in the triangle class, so a dynamic topology never needs a separate entry
+    key_write_baked_u32(writer, dynamic, PIPELINE_DYNAMIC_TOPOLOGY, options.input_assembly.topology);
+    key_write_baked_u32(writer, dynamic, PIPELINE_DYNAMIC_PRIMITIVE_RESTART, options.input_assembly.primitive_restart);
+
+    PipelineRasterizationOptions rasterization = options.rasterization;
+    key_write_u32(writer, rasterization.depth_clamping);
+    key_write_u32(writer, rasterization.discard_prims_until_rasterization);
+    key_write_u32(writer, rasterization.polygon_mode);
+    key_write_baked_u32(writer, dynamic, PIPELINE_DYNAMIC_CULL_MODE, rasterization.cull_mode);
+    key_write_baked_u32(writer, dynamic, PIPELINE_DYNAMIC_FRONT_FACE, rasterization.front_face_direction);
+    key_write_baked_u32(writer, dynamic, PIPELINE_DYNAMIC_DEPTH_BIAS, rasterization.bias_fragment_depth);
+    key_write_f32(writer, rasterization.depth_bias_factor);
+    key_write_f32(writer, rasterization.depth_bias_clamp);
+    key_write_f32(writer, rasterization.depth_bias_slope);
+    key_write_f32(writer, rasterization.line_width);
+
+    PipelineMultisampleOptions multisampling = options.multisampling;
+    key_write_u32(writer, multisampling.sample_flag);
+    key_write_u32(writer, multisampling.sample_shading);
+    key_write_f32(writer, multisampling.min_sample_shading);
+    key_write_u32(writer, multisampling.sample_masks != NULL);
+    if (multisampling.sample_masks) {
+        // One VkSampleMask covers up to 32 samples, past that there's a second
+        u32 mask_count = multisampling.sample_flag > PIPELINE_SAMPLECOUNT32 ? 2 : 1;
+        key_write(writer, multisampling.sample_masks, mask_count * sizeof(u32));
+    }
+    key_write_u32(writer, multisampling.alpha_to_coverage);
+    key_write_u32(writer, multisampling.alpha_to_one);
+
+    PipelineDepthStencilOptions depth_stencil = options.depth_stencil;
+    key_write_baked_u32(writer, dynamic, PIPELINE_DYNAMIC_DEPTH_TEST, depth_stencil.depth_test);
+    key_write_baked_u32(writer, dynamic, PIPELINE_DYNAMIC_DEPTH_WRITE, depth_stencil.depth_write);
+    key_write_baked_u32(writer, dynamic, PIPELINE_DYNAMIC_DEPTH_COMPARE_OP, depth_stencil.depth_compare_op);
+    key_write_u32(writer, depth_stencil.depth_bounds_test);
+    key_write_u32(writer, depth_stencil.stencil_test);
+    PipelineStencilOpState faces[2] = {depth_stencil.front, depth_stencil.back};
+    for (u32 i = 0; i < 2; i++) {
+        key_write_u32(writer, faces[i].fail_op);
+        key_write_u32(writer, faces[i].pass_op);
+        key_write_u32(writer, faces[i].depth_fail);
+        key_write_u32(writer, faces[i].compare_op);
+        key_write_u32(writer, faces[i].compare_mask);
+        key_write_u32(writer, faces[i].write_mask);
+    }
+    key_write_f32(writer, depth_stencil.min_depth_bounds);
+    key_write_f32(writer, depth_stencil.max_depth_bounds);
+
+    PipelineColorBlendOptions color_blending = options.color_blending;
+    key_write_u32(writer, color_blending.blend);
+    key_write_u32(writer, color_blending.logic_op_enable);
+    key_write_u32(writer, color_blending.color_blend_op);
+    key_write_u32(writer, color_blending.attachment_count);
+    for (u32 i = 0; i < color_blending.attachment_count; i++) {
+        PipelineColorBlendState state = color_blending.color_blend_states[i];
+        key_write_u32(writer, state.blend_enable);
+        key_write_u32(writer, state.src_color_factor);
+        key_write_u32(writer, state.dst_color_factor);
+        key_write_u32(writer, state.color_blend_op);
+        key_write_u32(writer, state.src_alpha_factor);
+        key_write_u32(writer, state.dst_alpha_factor);
+        key_write_u32(writer, state.alpha_blend_op);
+        key_write_u32(writer, state.color_write_mask);
+    }
+
+    key_write_u32(writer, options.rendering.color_count);
+    for (u32 i = 0; i < options.rendering.color_count; i++) {
+        key_write_u32(writer, options.rendering.colors[i]);
+    }
+    key_write_u32(writer, options.rendering.depth);
+    key_write_u32(writer, options.rendering.stencil);
+
+    // Not the handle, a freed layout's handle can come back for a different layout and hit its stale pipelines
+    u64 layout_id = 0;
+    pipeline_layout_get_id(options.layout, &layout_id);
+    key_write_u64(writer, layout_id);
+}
+
+static u64 fnv1a(const u8* data, u32 size) {
+    u64 hash = FNV_OFFSET_BASIS;
+    for (u32 i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+void pipeline_registry_hash(PipelineOptions options, u64* out_hash) {
+    KeyWriter writer = {0};
+    pipeline_options_write_key(options, &writer);
+    *out_hash = fnv1a(writer.data, writer.size);
+    free(writer.data);
+}
+
+PipelineRegistryResult pipeline_registry_new(u32 initial_capacity, PipelineRegistry** out_registry) {
+    PipelineRegistry* registry = malloc(sizeof(PipelineRegistry));
+    registry->lock = SDL_CreateRWLock();
+    if (registry->lock == NULL) {
+        fprintf(stderr, "Failed to create pipeline registry lock! %s\n", SDL_GetError());
+        free(registry);
+        return PIPELINE_REGISTRY_ERROR_CREATE_LOCK_FAIL;
+    }
+
+    registry->capacity = 16;
+    while (registry->capacity < initial_capacity * 2) {
+        registry->capacity *= 2;
+    }
+    registry->entries = calloc(registry->capacity, sizeof(Entry));
+    registry->live_count = 0;
+    registry->used_count = 0;
+    SDL_SetAtomicInt(&registry->hit_count, 0);
+    SDL_SetAtomicInt(&registry->miss_count, 0);
+
+    *out_registry = registry;
+    return PIPELINE_REGISTRY_OK;
+}
+
+void pipeline_registry_free(Device* device, PipelineRegistry* registry) {
+    for (u32 i = 0; i < registry->capacity; i++) {
+        Entry* entry = &registry->entries[i];
+        if (entry->state == ENTRY_LIVE) {
+            pipeline_free(device, entry->pipeline);
+            free(entry->key);
+        }
+    }
+    free(registry->entries);
+    SDL_DestroyRWLock(registry->lock);
+    free(registry);
+}
+
+// Live entry with the key, or NULL. Caller holds the lock either way
+static Entry* pipeline_registry_find(PipelineRegistry* registry, u64 hash, const u8* key, u32 key_size) {
+    u32 mask = registry->capacity - 1;
+    for (u32 i = (u32)hash & mask;; i = (i + 1) & mask) {
+        Entry* entry = &registry->entries[i];
+        if (entry->state == ENTRY_EMPTY) {
+            return NULL;
+        }
+        if (entry->state == ENTRY_LIVE && entry->hash == hash && entry->key_size == key_size &&
+            memcmp(entry->key, key, key_size) == 0) {
+            return entry;
+        }
+    }
+}
+
+// Caller holds the write lock and has checked the key isn't registered yet
+static Entry* pipeline_registry_insert(PipelineRegistry* registry, u64 hash) {
+    u32 mask = registry->capacity - 1;
+    for (u32 i = (u32)hash & mask;; i = (i + 1) & mask) {
+        Entry* entry = &registry->entries[i];
+        if (entry->state != ENTRY_LIVE) {
+            if (entry->state == ENTRY_EMPTY) {
+                registry->used_count++;
+            }
+            registry->live_count++;
+            return entry;
+        }
+    }
+}
+
+// Rehashes into a table sized for the live entries, which also drops every tombstone
+static void pipeline_registry_grow(PipelineRegistry* registry) {
+    Entry* old_entries = registry->entries;
+    u32 old_capacity = registry->capacity;
+
+    while ((f64)(registry->live_count + 1) > registry->capacity * PIPELINE_REGISTRY_MAX_LOAD / 2) {
+        registry->capacity *= 2;
+    }
+    registry->entries = calloc(registry->capacity, sizeof(Entry));
+    registry->live_count = 0;
+    registry->used_count = 0;
+
+    for (u32 i = 0; i < old_capacity; i++) {
+        if (old_entries[i].state == ENTRY_LIVE) {
+            Entry* entry = pipeline_registry_insert(registry, old_entries[i].hash);
+            *entry = old_entries[i];
+        }
+    }
+    free(old_entries);
+}
+
+PipelineResult pipeline_registry_acquire(Device* device, PipelineRegistry* registry, PipelineOptions options, Pipeline** out_pipeline) {
+    KeyWriter writer = {0};
+    pipeline_options_write_key(options, &writer);
+    u64 hash = fnv1a(writer.data, writer.size);
+
+    SDL_LockRWLockForReading(registry->lock);
+    Entry* existing = pipeline_registry_find(registry, hash, writer.data, writer.size);
+    if (existing) {
+        SDL_AddAtomicInt(&existing->references, 1);
+        *out_pipeline = existing->pipeline;
+        SDL_UnlockRWLock(registry->lock);
+
+        SDL_AddAtomicInt(&registry->hit_count, 1);
+        free(writer.data);
+        return PIPELINE_OK;
+    }
+    SDL_UnlockRWLock(registry->lock);
+
+    // Built without the lock so lookups of other pipelines never wait on a compile
+    Pipeline* pipeline = NULL;
+    PipelineResult pipeline_result = pipeline_new(device, options, &pipeline);
+    if (pipeline_result != PIPELINE_OK) {
+        free(writer.data);
+        return pipeline_result;
+    }
+
+    SDL_LockRWLockForWriting(registry->lock);
+    existing = pipeline_registry_find(registry, hash, writer.data, writer.size);
+    if (existing) {
+        // Another thread built the same pipeline in the meantime, theirs is already handed out
+        SDL_AddAtomicInt(&existing->references, 1);
+        *out_pipeline = existing->pipeline;
+        SDL_UnlockRWLock(registry->lock);
+
+        pipeline_free(device, pipeline);
+        free(writer.data);
+        return PIPELINE_OK;
+    }
+
+    if ((f64)(registry->used_count + 1) > registry->capacity * PIPELINE_REGISTRY_MAX_LOAD) {
+        pipeline_registry_grow(registry);
+    }
+
+    Entry* entry = pipeline_registry_insert(registry, hash);
+    entry->state = ENTRY_LIVE;
+    entry->hash = hash;
+    entry->key = writer.data;
+    entry->key_size = writer.size;
+    entry->pipeline = pipeline;
+    SDL_SetAtomicInt(&entry->references, 1);
+    SDL_UnlockRWLock(registry->lock);
+
+    SDL_AddAtomicInt(&registry->miss_count, 1);
+    *out_pipeline = pipeline;
+    return PIPELINE_OK;
+}
+
+void pipeline_registry_release(Device* device, PipelineRegistry* registry, Pipeline* pipeline) {
+    SDL_LockRWLockForWriting(registry->lock);
+
+    // Releases are rare next to acquires (material unloads), so they scan instead of keeping a second index
+    Entry* entry = NULL;
+    for (u32 i = 0; i < registry->capacity; i++) {
+        if (registry->entries[i].state == ENTRY_LIVE && registry->entries[i].pipeline == pipeline) {
+            entry = &registry->entries[i];
+            break;
+        }
+    }
+
+    if (entry == NULL) {
+        fprintf(stderr, "Released a pipeline the registry doesn't know about!\n");
+        SDL_UnlockRWLock(registry->lock);
+        return;
+    }
+
+    if (SDL_AddAtomicInt(&entry->references, -1) > 1) {
+        SDL_UnlockRWLock(registry->lock);
+        return;
+    }
+
+    free(entry->key);
+    *entry = (Entry){0};
+    entry->state = ENTRY_TOMBSTONE;
+    registry->live_count--;
+    SDL_UnlockRWLock(registry->lock);
+
+    pipeline_free(device, pipeline);
+}
+
+void pipeline_registry_get_stats(PipelineRegistry* registry, PipelineRegistryStats* out_stats) {
+    SDL_LockRWLockForReading(registry->lock);
+    out_stats->pipeline_count = registry->live_count;
+    SDL_UnlockRWLock(registry->lock);
+
+    out_stats->hit_count = (u32)SDL_GetAtomicInt(&registry->hit_count);
+    out_stats->miss_count = (u32)SDL_GetAtomicInt(&registry->miss_count);
+}
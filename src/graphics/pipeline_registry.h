@@ -0,0 +1,41 @@
+#ifndef PIPELINE_REGISTRY_H
+#define PIPELINE_REGISTRY_H
+
+#include "device.h"
+#include "pipeline.h"
+#include "../int_types.h"
+
+// Hands out one shared pipeline per distinct PipelineOptions, so materials can ask for a pipeline
+// every draw and only the first request pays for the compile. Safe to use from any thread
+typedef struct PipelineRegistry PipelineRegistry;
+
+typedef struct {
+    u32 pipeline_count; // Distinct pipelines currently registered
+    u32 hit_count; // Acquires that found an existing pipeline
+    u32 miss_count; // Acquires that had to build one
+} PipelineRegistryStats;
+
+typedef enum {
+    PIPELINE_REGISTRY_OK, // Successfully created a registry
+    PIPELINE_REGISTRY_ERROR_CREATE_LOCK_FAIL, // Failed to create the lock guarding the map
+} PipelineRegistryResult;
+
+PipelineRegistryResult pipeline_registry_new(u32 initial_capacity, PipelineRegistry** out_registry);
+// Destroys every pipeline still registered, whatever its reference count
+void pipeline_registry_free(Device* device, PipelineRegistry* registry);
+
+// Returns the registered pipeline for options with its reference count bumped, or builds and registers it.
+// Everything options points at is read (shaders, vertex layout, blend states, color formats), not the
+// pointers themselves, except shaders and the layout which are identified by their handles
+PipelineResult pipeline_registry_acquire(Device* device, PipelineRegistry* registry, PipelineOptions options, Pipeline** out_pipeline);
+
+// Drops a reference from pipeline_registry_acquire, the last one destroys the pipeline,
+// so the GPU has to be done with it by then just like with pipeline_free
+void pipeline_registry_release(Device* device, PipelineRegistry* registry, Pipeline* pipeline);
+
+// 64-bit FNV-1a of every field that ends up in the VkPipeline
+void pipeline_registry_hash(PipelineOptions options, u64* out_hash);
+
+void pipeline_registry_get_stats(PipelineRegistry* registry, PipelineRegistryStats* out_stats);
+
+#endif // PIPELINE_REGISTRY_H
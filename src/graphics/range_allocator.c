@@ -0,0 +1,187 @@
+#include "range_allocator.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    u64 offset;
+    u64 size;
+} FreeRange;
+
+typedef struct RangeAllocator {
+    FreeRange* ranges; // Sorted by offset, never adjacent (adjacent ranges are merged)
+    u32 range_count;
+    u32 range_capacity;
+
+    u64 capacity;
+    u64 used;
+} RangeAllocator;
+
+static u64 align_up(u64 value, u64 alignment) {
+    if (alignment <= 1) {
+        return value;
+    }
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static void range_allocator_insert(RangeAllocator* allocator, u32 index, FreeRange range) {
+    if (allocator->range_count == allocator->range_capacity) {
+        allocator->range_capacity = allocator->range_capacity == 0 ? 16 : allocator->range_capacity * 2;
+        allocator->ranges = realloc(allocator->ranges, allocator->range_capacity * sizeof(FreeRange));
+    }
+
+    memmove(
+        &allocator->ranges[index + 1],
+        &allocator->ranges[index],
+        (allocator->range_count - index) * sizeof(FreeRange)
+    );
+    allocator->ranges[index] = range;
+    allocator->range_count++;
+}
+
+static void range_allocator_remove(RangeAllocator* allocator, u32 index) {
+    memmove(
+        &allocator->ranges[index],
+        &allocator->ranges[index + 1],
+        (allocator->range_count - index - 1) * sizeof(FreeRange)
+    );
+    allocator->range_count--;
+}
+
+void range_allocator_new(u64 capacity, RangeAllocator** out_allocator) {
+    RangeAllocator* allocator = malloc(sizeof(RangeAllocator));
+    allocator->ranges = NULL;
+    allocator->range_count = 0;
+    allocator->range_capacity = 0;
+    allocator->capacity = capacity;
+    allocator->used = 0;
+
+    range_allocator_reset(allocator);
+    *out_allocator = allocator;
+}
+
+void range_allocator_free(RangeAllocator* allocator) {
+    if (allocator->ranges) {
+        free(allocator->ranges);
+        allocator->ranges = NULL;
+    }
+    free(allocator);
+}
+
+bool range_allocator_alloc(RangeAllocator* allocator, u64 size, u64 alignment, u64* out_offset) {
+    if (size == 0) {
+        return false;
+    }
+
+    // Best fit: pick the smallest free range that still fits once aligned,
+    // which keeps the big ranges intact for big requests.
+    u32 best_index = UINT32_MAX;
+    u64 best_waste = UINT64_MAX;
+    for (u32 i = 0; i < allocator->range_count; i++) {
+        FreeRange range = allocator->ranges[i];
+        u64 aligned = align_up(range.offset, alignment);
+        u64 padding = aligned - range.offset;
+        if (padding + size > range.size) {
+            continue;
+        }
+
+        u64 waste = range.size - size;
+        if (waste < best_waste) {
+            best_waste = waste;
+            best_index = i;
+            if (waste == padding) {
+                break;
+            }
+        }
+    }
+
+    if (best_index == UINT32_MAX) {
+        return false;
+    }
+
+    FreeRange range = allocator->ranges[best_index];
+    u64 aligned = align_up(range.offset, alignment);
+    u64 padding = aligned - range.offset;
+    u64 remainder = range.size - padding - size;
+
+    range_allocator_remove(allocator, best_index);
+    if (remainder > 0) {
+        range_allocator_insert(allocator, best_index, (FreeRange){
+            .offset = aligned + size,
+            .size = remainder
+        });
+    }
+    if (padding > 0) {
+        range_allocator_insert(allocator, best_index, (FreeRange){
+            .offset = range.offset,
+            .size = padding
+        });
+    }
+
+    allocator->used += size;
+    *out_offset = aligned;
+    return true;
+}
+
+void range_allocator_release(RangeAllocator* allocator, u64 offset, u64 size) {
+    if (size == 0) {
+        return;
+    }
+
+    // Find the first free range past the released one
+    u32 low = 0;
+    u32 high = allocator->range_count;
+    while (low < high) {
+        u32 mid = (low + high) / 2;
+        if (allocator->ranges[mid].offset < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    u32 index = low;
+
+    bool merge_prev = index > 0 &&
+        allocator->ranges[index - 1].offset + allocator->ranges[index - 1].size == offset;
+    bool merge_next = index < allocator->range_count &&
+        offset + size == allocator->ranges[index].offset;
+
+    if (merge_prev && merge_next) {
+        allocator->ranges[index - 1].size += size + allocator->ranges[index].size;
+        range_allocator_remove(allocator, index);
+    } else if (merge_prev) {
+        allocator->ranges[index - 1].size += size;
+    } else if (merge_next) {
+        allocator->ranges[index].offset = offset;
+        allocator->ranges[index].size += size;
+    } else {
+        range_allocator_insert(allocator, index, (FreeRange){
+            .offset = offset,
+            .size = size
+        });
+    }
+
+    allocator->used -= size;
+}
+
+void range_allocator_reset(RangeAllocator* allocator) {
+    allocator->range_count = 0;
+    allocator->used = 0;
+    if (allocator->capacity > 0) {
+        range_allocator_insert(allocator, 0, (FreeRange){
+            .offset = 0,
+            .size = allocator->capacity
+        });
+    }
+}
+
+void range_allocator_get_capacity(RangeAllocator* allocator, u64* out_capacity) {
+    *out_capacity = allocator->capacity;
+}
+
+void range_allocator_get_used(RangeAllocator* allocator, u64* out_used) {
+    *out_used = allocator->used;
+}
+
+bool range_allocator_is_empty(RangeAllocator* allocator) {
+    return allocator->used == 0;
+}
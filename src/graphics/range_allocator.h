@@ -0,0 +1,22 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <stdbool.h>
+#include "../int_types.h"
+
+// Hands out aligned [offset, offset + size) ranges from a fixed capacity,
+// keeping freed ranges in a sorted free-list that merges neighbours back together.
+typedef struct RangeAllocator RangeAllocator;
+
+void range_allocator_new(u64 capacity, RangeAllocator** out_allocator);
+void range_allocator_free(RangeAllocator* allocator);
+
+bool range_allocator_alloc(RangeAllocator* allocator, u64 size, u64 alignment, u64* out_offset);
+void range_allocator_release(RangeAllocator* allocator, u64 offset, u64 size);
+void range_allocator_reset(RangeAllocator* allocator);
+
+void range_allocator_get_capacity(RangeAllocator* allocator, u64* out_capacity);
+void range_allocator_get_used(RangeAllocator* allocator, u64* out_used);
+bool range_allocator_is_empty(RangeAllocator* allocator);
+
+#endif // RANGE_ALLOCATOR_H
@@ -0,0 +1,815 @@
+#include "render_graph.h"
+#include "allocator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+#define RENDER_GRAPH_MAX_PASS_USES 16
+
+typedef struct {
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 read_access;
+    VkAccessFlags2 write_access;
+    VkImageLayout read_layout;
+    VkImageLayout write_layout;
+    ImageUsage image_usage; // What a transient image used this way has to be created with
+} AccessInfo;
+
+static const AccessInfo access_infos[] = {
+    [RENDER_GRAPH_UNDEFINED] = {
+        .stages = VK_PIPELINE_STAGE_2_NONE,
+        .read_access = VK_ACCESS_2_NONE,
+        .write_access = VK_ACCESS_2_NONE,
+        .read_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .write_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .image_usage = IMAGE_NO_USE
+    },
+    [RENDER_GRAPH_COLOR_ATTACHMENT] = {
+        .stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .read_access = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT,
+        .write_access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+        .read_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .write_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .image_usage = IMAGE_COLOR_ATTACHMENT
+    },
+    [RENDER_GRAPH_DEPTH_ATTACHMENT] = {
+        .stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        .read_access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+        .write_access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .read_layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+        .write_layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .image_usage = IMAGE_DEPTH_ATTACHMENT
+    },
+    [RENDER_GRAPH_SAMPLED_FRAGMENT] = {
+        .stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+        .read_access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+        .write_access = VK_ACCESS_2_NONE,
+        .read_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .write_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .image_usage = IMAGE_SAMPLED
+    },
+    [RENDER_GRAPH_SAMPLED_COMPUTE] = {
+        .stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .read_access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+        .write_access = VK_ACCESS_2_NONE,
+        .read_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .write_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .image_usage = IMAGE_SAMPLED
+    },
+    [RENDER_GRAPH_STORAGE_COMPUTE] = {
+        .stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .read_access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+        .write_access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .read_layout = VK_IMAGE_LAYOUT_GENERAL,
+        .write_layout = VK_IMAGE_LAYOUT_GENERAL,
+        .image_usage = IMAGE_STORAGE
+    },
+    [RENDER_GRAPH_STORAGE_VERTEX] = {
+        .stages = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+        .read_access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+        .write_access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .read_layout = VK_IMAGE_LAYOUT_GENERAL,
+        .write_layout = VK_IMAGE_LAYOUT_GENERAL,
+        .image_usage = IMAGE_STORAGE
+    },
+    [RENDER_GRAPH_TRANSFER] = {
+        .stages = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+        .read_access = VK_ACCESS_2_TRANSFER_READ_BIT,
+        .write_access = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .read_layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .write_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .image_usage = IMAGE_TRANSFER_SRC | IMAGE_TRANSFER_DST
+    },
+    [RENDER_GRAPH_VERTEX_INPUT] = {
+        .stages = VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT,
+        .read_access = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT,
+        .write_access = VK_ACCESS_2_NONE,
+        .read_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .write_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .image_usage = IMAGE_NO_USE
+    },
+    [RENDER_GRAPH_INDIRECT] = {
+        .stages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+        .read_access = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+        .write_access = VK_ACCESS_2_NONE,
+        .read_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .write_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .image_usage = IMAGE_NO_USE
+    },
+    [RENDER_GRAPH_PRESENT] = {
+        .stages = VK_PIPELINE_STAGE_2_NONE,
+        .read_access = VK_ACCESS_2_NONE,
+        .write_access = VK_ACCESS_2_NONE,
+        .read_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .write_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .image_usage = IMAGE_NO_USE
+    }
+};
+
+typedef enum {
+    RESOURCE_TRANSIENT_IMAGE,
+    RESOURCE_IMPORTED_IMAGE,
+    RESOURCE_IMPORTED_BUFFER
+} ResourceKind;
+
+typedef struct {
+    ResourceKind kind;
+    RenderGraphImageOptions image_options; // Transient images only
+    Image* image; // Transient images only, created by render_graph_compile
+    Buffer* buffer; // Imported buffers only
+
+    VkImage image_handle;
+    VkImageView view;
+    VkImageAspectFlags aspect;
+
+    RenderGraphAccess initial_access;
+    RenderGraphAccess final_access;
+    bool output;
+
+    // Filled in by render_graph_compile
+    ImageUsage usage;
+    u32 first_use; // Position among the active passes
+    u32 last_use;
+    u64 memory_size;
+    u32 slot; // Memory slot a transient image aliases into
+    bool used;
+} Resource;
+
+typedef struct {
+    RenderGraphResource resource;
+    RenderGraphAccess access;
+    bool read;
+    bool write;
+} PassUse;
+
+typedef struct {
+    RenderGraphResource resource;
+    VkPipelineStageFlags2 src_stages;
+    VkAccessFlags2 src_access;
+    VkPipelineStageFlags2 dst_stages;
+    VkAccessFlags2 dst_access;
+    VkImageLayout old_layout;
+    VkImageLayout new_layout;
+} PlannedBarrier;
+
+// One vkCmdPipelineBarrier2: image barriers plus every buffer hazard merged into a single memory barrier
+typedef struct {
+    u32 barrier_start;
+    u32 barrier_count;
+    VkMemoryBarrier2 memory_barrier;
+    bool has_memory_barrier;
+} BarrierBatch;
+
+typedef struct {
+    const char* name;
+    RenderGraphExecute execute;
+    void* user_data;
+    PassUse uses[RENDER_GRAPH_MAX_PASS_USES];
+    u32 use_count;
+    bool active;
+    BarrierBatch batch;
+} Pass;
+
+// Where a resource stands while barriers are planned
+typedef struct {
+    VkPipelineStageFlags2 write_stages; // Last write or layout transition, 0 when there's nothing to wait for
+    VkAccessFlags2 write_access;
+    VkPipelineStageFlags2 read_stages; // Readers since the last write, later writes have to wait for them too
+    VkPipelineStageFlags2 visible_stages; // Stages the last write is already visible to
+    VkAccessFlags2 visible_access;
+    VkImageLayout layout;
+} ResourceState;
+
+typedef struct {
+    Allocation allocation;
+    u64 size;
+    u64 alignment;
+    u32 memory_type_bits;
+    VkPipelineStageFlags2 stages; // Every stage any image in the slot is used in
+    VkAccessFlags2 write_access;
+} MemorySlot;
+
+// A transient image or a slot's memory, one of the two is set
+typedef struct {
+    Image* image;
+    Allocation allocation;
+    u64 retire_value; // Timeline value after which no frame uses it anymore
+} RetiredTransient;
+
+typedef struct RenderGraph {
+    Resource* resources;
+    u32 resource_count;
+    u32 resource_capacity;
+
+    Pass* passes;
+    u32 pass_count;
+    u32 pass_capacity;
+
+    PlannedBarrier* barriers;
+    u32 barrier_count;
+    u32 barrier_capacity;
+
+    MemorySlot* slots;
+    u32 slot_count;
+
+    RetiredTransient* retired;
+    u32 retired_count;
+    u32 retired_capacity;
+
+    BarrierBatch final_batch; // Hands imports over in their final access after the last pass
+    RenderGraphStats stats;
+} RenderGraph;
+
+void render_graph_new(RenderGraph** out_graph) {
+    RenderGraph* graph = calloc(1, sizeof(RenderGraph));
+    *out_graph = graph;
+}
+
+static void render_graph_retire(RenderGraph* graph, RetiredTransient retired) {
+    if (graph->retired_count == graph->retired_capacity) {
+        graph->retired_capacity = graph->retired_capacity > 0 ? graph->retired_capacity * 2 : 16;
+        graph->retired = realloc(graph->retired, graph->retired_capacity * sizeof(RetiredTransient));
+    }
+    graph->retired[graph->retired_count++] = retired;
+}
+
+// Frames recorded from the current compile may still be running, so nothing is destroyed before retire_value
+static void render_graph_retire_transients(RenderGraph* graph, u64 retire_value) {
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        Resource* resource = &graph->resources[i];
+        if (resource->kind == RESOURCE_TRANSIENT_IMAGE && resource->image) {
+            render_graph_retire(graph, (RetiredTransient){
+                .image = resource->image,
+                .retire_value = retire_value
+            });
+            resource->image = NULL;
+            resource->image_handle = NULL;
+            resource->view = NULL;
+        }
+    }
+
+    for (u32 i = 0; i < graph->slot_count; i++) {
+        if (graph->slots[i].allocation.block) {
+            render_graph_retire(graph, (RetiredTransient){
+                .image = NULL,
+                .allocation = graph->slots[i].allocation,
+                .retire_value = retire_value
+            });
+        }
+    }
+    free(graph->slots);
+    graph->slots = NULL;
+    graph->slot_count = 0;
+}
+
+void render_graph_release_retired(Device* device, RenderGraph* graph, u64 completed_value) {
+    Allocator* allocator = NULL;
+    device_get_allocator(device, &allocator);
+
+    u32 kept = 0;
+    for (u32 i = 0; i < graph->retired_count; i++) {
+        RetiredTransient* retired = &graph->retired[i];
+        if (retired->retire_value > completed_value) {
+            graph->retired[kept++] = *retired;
+        } else if (retired->image) {
+            image_free(device, retired->image);
+        } else {
+            allocator_release(device, allocator, &retired->allocation);
+        }
+    }
+    graph->retired_count = kept;
+}
+
+void render_graph_free(Device* device, RenderGraph* graph) {
+    render_graph_retire_transients(graph, 0);
+    render_graph_release_retired(device, graph, UINT64_MAX);
+    free(graph->retired);
+    free(graph->resources);
+    free(graph->passes);
+    free(graph->barriers);
+    free(graph);
+}
+
+void render_graph_reset(RenderGraph* graph, u64 retire_value) {
+    render_graph_retire_transients(graph, retire_value);
+    graph->resource_count = 0;
+    graph->pass_count = 0;
+    graph->barrier_count = 0;
+    graph->final_batch = (BarrierBatch){0};
+    graph->stats = (RenderGraphStats){0};
+}
+
+static Resource* render_graph_add_resource(RenderGraph* graph, ResourceKind kind, RenderGraphResource* out_resource) {
+    if (graph->resource_count == graph->resource_capacity) {
+        graph->resource_capacity = graph->resource_capacity > 0 ? graph->resource_capacity * 2 : 16;
+        graph->resources = realloc(graph->resources, graph->resource_capacity * sizeof(Resource));
+    }
+
+    *out_resource = graph->resource_count;
+    Resource* resource = &graph->resources[graph->resource_count++];
+    *resource = (Resource){0};
+    resource->kind = kind;
+    return resource;
+}
+
+void render_graph_create_image(RenderGraph* graph, RenderGraphImageOptions options, RenderGraphResource* out_resource) {
+    Resource* resource = render_graph_add_resource(graph, RESOURCE_TRANSIENT_IMAGE, out_resource);
+    resource->image_options = options;
+}
+
+void render_graph_import_image(RenderGraph* graph, RenderGraphImportOptions options, RenderGraphResource* out_resource) {
+    Resource* resource = render_graph_add_resource(graph, RESOURCE_IMPORTED_IMAGE, out_resource);
+    resource->image_handle = options.image;
+    resource->view = options.view;
+    resource->aspect = options.aspect;
+    resource->initial_access = options.initial_access;
+    resource->final_access = options.final_access;
+}
+
+void render_graph_import_buffer(RenderGraph* graph, Buffer* buffer, RenderGraphResource* out_resource) {
+    Resource* resource = render_graph_add_resource(graph, RESOURCE_IMPORTED_BUFFER, out_resource);
+    resource->buffer = buffer;
+}
+
+void render_graph_set_image(RenderGraph* graph, RenderGraphResource resource, void* image, void* view) {
+    graph->resources[resource].image_handle = image;
+    graph->resources[resource].view = view;
+}
+
+void render_graph_mark_output(RenderGraph* graph, RenderGraphResource resource) {
+    graph->resources[resource].output = true;
+}
+
+void render_graph_add_pass(RenderGraph* graph, const char* name, RenderGraphExecute execute, void* user_data, RenderGraphPass* out_pass) {
+    if (graph->pass_count == graph->pass_capacity) {
+        graph->pass_capacity = graph->pass_capacity > 0 ? graph->pass_capacity * 2 : 16;
+        graph->passes = realloc(graph->passes, graph->pass_capacity * sizeof(Pass));
+    }
+
+    *out_pass = graph->pass_count;
+    Pass* pass = &graph->passes[graph->pass_count++];
+    *pass = (Pass){0};
+    pass->name = name;
+    pass->execute = execute;
+    pass->user_data = user_data;
+}
+
+static void render_graph_use(RenderGraph* graph, RenderGraphPass pass_index, RenderGraphResource resource, RenderGraphAccess access, bool write) {
+    Pass* pass = &graph->passes[pass_index];
+
+    // Reading and writing the same resource the same way (e.g. a loaded attachment) is one use that does both
+    for (u32 i = 0; i < pass->use_count; i++) {
+        if (pass->uses[i].resource == resource && pass->uses[i].access == access) {
+            pass->uses[i].read |= !write;
+            pass->uses[i].write |= write;
+            return;
+        }
+    }
+
+    if (pass->use_count == RENDER_GRAPH_MAX_PASS_USES) {
+        fprintf(stderr, "Render graph pass %s uses more than %d resources!\n", pass->name, RENDER_GRAPH_MAX_PASS_USES);
+        return;
+    }
+
+    pass->uses[pass->use_count++] = (PassUse){
+        .resource = resource,
+        .access = access,
+        .read = !write,
+        .write = write
+    };
+}
+
+void render_graph_read(RenderGraph* graph, RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access) {
+    render_graph_use(graph, pass, resource, access, false);
+}
+
+void render_graph_write(RenderGraph* graph, RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access) {
+    render_graph_use(graph, pass, resource, access, true);
+}
+
+// Walks the passes backwards from the outputs, a pass is only kept if something after it needs what it writes
+static void render_graph_cull(RenderGraph* graph) {
+    bool* needed = calloc(graph->resource_count + 1, sizeof(bool));
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        needed[i] = graph->resources[i].output;
+    }
+
+    for (u32 i = graph->pass_count; i-- > 0;) {
+        Pass* pass = &graph->passes[i];
+        pass->active = false;
+        for (u32 j = 0; j < pass->use_count; j++) {
+            if (pass->uses[j].write && needed[pass->uses[j].resource]) {
+                pass->active = true;
+                break;
+            }
+        }
+
+        if (!pass->active) {
+            continue;
+        }
+
+        // Earlier writes are overwritten by this one unless this pass reads them as well
+        for (u32 j = 0; j < pass->use_count; j++) {
+            if (pass->uses[j].write) {
+                needed[pass->uses[j].resource] = false;
+            }
+        }
+        for (u32 j = 0; j < pass->use_count; j++) {
+            if (pass->uses[j].read) {
+                needed[pass->uses[j].resource] = true;
+            }
+        }
+    }
+    free(needed);
+}
+
+static bool lifetimes_overlap(Resource* a, Resource* b) {
+    return !(a->last_use < b->first_use || b->last_use < a->first_use);
+}
+
+static RenderGraphResult render_graph_create_transients(Device* device, RenderGraph* graph) {
+    u32 transient_count = 0;
+    RenderGraphResource order[graph->resource_count + 1]; // +1 so the VLA is never zero sized
+
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        Resource* resource = &graph->resources[i];
+        if (resource->kind != RESOURCE_TRANSIENT_IMAGE || !resource->used) {
+            continue;
+        }
+
+        ImageResult image_result = image_new(device, (ImageOptions){
+            .extent = resource->image_options.extent,
+            .color_format = resource->image_options.color_format,
+            .depth_format = resource->image_options.depth_format,
+            .usage = resource->usage,
+            .memory = IMAGE_MEMORY_UNBOUND
+        }, &resource->image);
+        if (image_result != IMAGE_OK) {
+            fprintf(stderr, "Failed to create render graph transient image! %d\n", image_result);
+            resource->image = NULL;
+            return RENDER_GRAPH_ERROR_CREATE_IMAGE_FAIL;
+        }
+
+        ImageMemoryRequirements requirements;
+        image_get_memory_requirements(device, resource->image, &requirements);
+        resource->memory_size = requirements.size;
+        graph->stats.transient_memory_unaliased += requirements.size;
+
+        // Biggest first, so smaller images fill in around the ones that set the slot sizes
+        u32 position = transient_count++;
+        while (position > 0 && graph->resources[order[position - 1]].memory_size < resource->memory_size) {
+            order[position] = order[position - 1];
+            position--;
+        }
+        order[position] = i;
+    }
+
+    graph->slots = calloc(transient_count + 1, sizeof(MemorySlot));
+    graph->slot_count = 0;
+
+    for (u32 i = 0; i < transient_count; i++) {
+        Resource* resource = &graph->resources[order[i]];
+
+        ImageMemoryRequirements requirements;
+        image_get_memory_requirements(device, resource->image, &requirements);
+
+        u32 slot_index = graph->slot_count;
+        for (u32 slot = 0; slot < graph->slot_count && slot_index == graph->slot_count; slot++) {
+            if (!(graph->slots[slot].memory_type_bits & requirements.memory_type_bits)) {
+                continue;
+            }
+
+            bool free_for_lifetime = true;
+            for (u32 j = 0; j < i; j++) {
+                Resource* other = &graph->resources[order[j]];
+                if (other->slot == slot && lifetimes_overlap(resource, other)) {
+                    free_for_lifetime = false;
+                    break;
+                }
+            }
+            if (free_for_lifetime) {
+                slot_index = slot;
+            }
+        }
+
+        MemorySlot* slot = &graph->slots[slot_index];
+        if (slot_index == graph->slot_count) {
+            graph->slot_count++;
+            slot->memory_type_bits = requirements.memory_type_bits;
+        }
+
+        slot->memory_type_bits &= requirements.memory_type_bits;
+        slot->size = slot->size > requirements.size ? slot->size : requirements.size;
+        slot->alignment = slot->alignment > requirements.alignment ? slot->alignment : requirements.alignment;
+        resource->slot = slot_index;
+    }
+
+    Allocator* allocator = NULL;
+    device_get_allocator(device, &allocator);
+
+    for (u32 i = 0; i < graph->slot_count; i++) {
+        MemorySlot* slot = &graph->slots[i];
+        AllocatorResult alloc_result = allocator_alloc(device, allocator, (AllocationOptions){
+            .size = slot->size,
+            .alignment = slot->alignment,
+            .memory_type_bits = slot->memory_type_bits,
+            .required_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            .preferred_flags = 0,
+            .optimal_tiling = true
+        }, &slot->allocation);
+        if (alloc_result != ALLOCATOR_OK) {
+            fprintf(stderr, "Failed to allocate render graph transient memory! %d\n", alloc_result);
+            return RENDER_GRAPH_ERROR_MEM_ALLOC_FAIL;
+        }
+        graph->stats.transient_memory += slot->size;
+    }
+
+    for (u32 i = 0; i < transient_count; i++) {
+        Resource* resource = &graph->resources[order[i]];
+        MemorySlot* slot = &graph->slots[resource->slot];
+
+        ImageResult bind_result = image_bind_memory(device, resource->image, slot->allocation.memory, slot->allocation.offset);
+        if (bind_result != IMAGE_OK) {
+            fprintf(stderr, "Failed to bind render graph transient image! %d\n", bind_result);
+            return RENDER_GRAPH_ERROR_BIND_FAIL;
+        }
+
+        void* image_handle = NULL;
+        void* view = NULL;
+        u32 aspect = 0;
+        image_get_image(resource->image, &image_handle);
+        image_get_view(resource->image, &view);
+        image_get_aspect(resource->image, &aspect);
+        resource->image_handle = image_handle;
+        resource->view = view;
+        resource->aspect = aspect;
+    }
+    return RENDER_GRAPH_OK;
+}
+
+static void render_graph_push_barrier(RenderGraph* graph, BarrierBatch* batch, PlannedBarrier barrier) {
+    if (graph->barrier_count == graph->barrier_capacity) {
+        graph->barrier_capacity = graph->barrier_capacity > 0 ? graph->barrier_capacity * 2 : 32;
+        graph->barriers = realloc(graph->barriers, graph->barrier_capacity * sizeof(PlannedBarrier));
+    }
+    graph->barriers[graph->barrier_count++] = barrier;
+    batch->barrier_count++;
+}
+
+static void render_graph_plan_use(RenderGraph* graph, BarrierBatch* batch, RenderGraphResource resource_index, ResourceState* state, RenderGraphAccess access, bool write) {
+    Resource* resource = &graph->resources[resource_index];
+    AccessInfo info = access_infos[access];
+
+    bool is_image = resource->kind != RESOURCE_IMPORTED_BUFFER;
+    VkImageLayout layout = is_image ? (write ? info.write_layout : info.read_layout) : VK_IMAGE_LAYOUT_UNDEFINED;
+    VkAccessFlags2 access_mask = write ? info.read_access | info.write_access : info.read_access;
+    bool transition = is_image && layout != state->layout;
+
+    VkPipelineStageFlags2 src_stages = 0;
+    VkAccessFlags2 src_access = 0;
+    bool needs_barrier = false;
+
+    if (write || transition) {
+        // Writes and layout transitions wait for the last write and every read since
+        src_stages = state->write_stages | state->read_stages;
+        src_access = state->write_access;
+        needs_barrier = transition || src_stages != 0;
+
+        state->write_stages = info.stages;
+        state->write_access = write ? info.write_access : VK_ACCESS_2_NONE;
+        state->read_stages = write ? 0 : info.stages;
+        // A write isn't visible to anyone yet, not even its own stages, only a later barrier's dst half makes it so.
+        // A read-only transition's barrier already made the last write visible to the reader
+        state->visible_stages = write ? 0 : info.stages;
+        state->visible_access = write ? VK_ACCESS_2_NONE : access_mask;
+    } else {
+        // Reads only need a barrier when the last write isn't visible to them yet
+        if (state->write_stages != 0 &&
+            ((info.stages & ~state->visible_stages) || (access_mask & ~state->visible_access))) {
+            src_stages = state->write_stages;
+            src_access = state->write_access;
+            needs_barrier = true;
+            state->visible_stages |= info.stages;
+            state->visible_access |= access_mask;
+        }
+        state->read_stages |= info.stages;
+    }
+
+    if (!needs_barrier) {
+        state->layout = is_image ? layout : state->layout;
+        return;
+    }
+
+    if (!is_image) {
+        batch->memory_barrier.srcStageMask |= src_stages;
+        batch->memory_barrier.srcAccessMask |= src_access;
+        batch->memory_barrier.dstStageMask |= info.stages;
+        batch->memory_barrier.dstAccessMask |= access_mask;
+        batch->has_memory_barrier = true;
+        return;
+    }
+
+    render_graph_push_barrier(graph, batch, (PlannedBarrier){
+        .resource = resource_index,
+        .src_stages = src_stages,
+        .src_access = src_access,
+        .dst_stages = info.stages,
+        .dst_access = access_mask,
+        .old_layout = state->layout,
+        .new_layout = layout
+    });
+    state->layout = layout;
+}
+
+static void render_graph_init_batch(BarrierBatch* batch, u32 barrier_start) {
+    *batch = (BarrierBatch){0};
+    batch->barrier_start = barrier_start;
+    batch->memory_barrier = (VkMemoryBarrier2){
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext = NULL
+    };
+}
+
+static void render_graph_count_batch(RenderGraph* graph, BarrierBatch* batch) {
+    if (batch->barrier_count > 0 || batch->has_memory_barrier) {
+        graph->stats.barrier_batch_count++;
+    }
+    graph->stats.image_barrier_count += batch->barrier_count;
+}
+
+RenderGraphResult render_graph_compile(Device* device, RenderGraph* graph, u64 retire_value) {
+    render_graph_retire_transients(graph, retire_value);
+    graph->barrier_count = 0;
+    graph->stats = (RenderGraphStats){0};
+
+    render_graph_cull(graph);
+
+    u32 active_index = 0;
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        graph->resources[i].used = false;
+        graph->resources[i].usage = IMAGE_NO_USE;
+    }
+    for (u32 i = 0; i < graph->pass_count; i++) {
+        Pass* pass = &graph->passes[i];
+        if (!pass->active) {
+            graph->stats.culled_pass_count++;
+            continue;
+        }
+
+        for (u32 j = 0; j < pass->use_count; j++) {
+            Resource* resource = &graph->resources[pass->uses[j].resource];
+            if (!resource->used) {
+                resource->first_use = active_index;
+                resource->used = true;
+            }
+            resource->last_use = active_index;
+            resource->usage |= access_infos[pass->uses[j].access].image_usage;
+        }
+        active_index++;
+    }
+    graph->stats.active_pass_count = active_index;
+
+    RenderGraphResult transient_result = render_graph_create_transients(device, graph);
+    if (transient_result != RENDER_GRAPH_OK) {
+        render_graph_retire_transients(graph, retire_value);
+        return transient_result;
+    }
+
+    for (u32 i = 0; i < graph->pass_count; i++) {
+        Pass* pass = &graph->passes[i];
+        if (!pass->active) {
+            continue;
+        }
+        for (u32 j = 0; j < pass->use_count; j++) {
+            Resource* resource = &graph->resources[pass->uses[j].resource];
+            if (resource->kind == RESOURCE_TRANSIENT_IMAGE) {
+                AccessInfo info = access_infos[pass->uses[j].access];
+                graph->slots[resource->slot].stages |= info.stages;
+                graph->slots[resource->slot].write_access |= info.write_access;
+            }
+        }
+    }
+
+    ResourceState* states = calloc(graph->resource_count + 1, sizeof(ResourceState));
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        Resource* resource = &graph->resources[i];
+        if (resource->kind == RESOURCE_TRANSIENT_IMAGE) {
+            // Contents are discarded every frame, but the memory may still be in use by an image aliasing
+            // it or by the previous frame, so the first use waits for everything touching the slot
+            if (resource->used) {
+                MemorySlot* slot = &graph->slots[resource->slot];
+                states[i].write_stages = slot->stages;
+                states[i].write_access = slot->write_access;
+            }
+            states[i].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        } else {
+            AccessInfo info = access_infos[resource->initial_access];
+            states[i].write_stages = info.stages;
+            states[i].write_access = info.write_access;
+            states[i].layout = info.write_access != VK_ACCESS_2_NONE ? info.write_layout : info.read_layout;
+        }
+    }
+
+    for (u32 i = 0; i < graph->pass_count; i++) {
+        Pass* pass = &graph->passes[i];
+        if (!pass->active) {
+            continue;
+        }
+
+        render_graph_init_batch(&pass->batch, graph->barrier_count);
+        for (u32 j = 0; j < pass->use_count; j++) {
+            PassUse* use = &pass->uses[j];
+            render_graph_plan_use(graph, &pass->batch, use->resource, &states[use->resource], use->access, use->write);
+        }
+        render_graph_count_batch(graph, &pass->batch);
+    }
+
+    render_graph_init_batch(&graph->final_batch, graph->barrier_count);
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        Resource* resource = &graph->resources[i];
+        if (resource->kind == RESOURCE_TRANSIENT_IMAGE || resource->final_access == RENDER_GRAPH_UNDEFINED) {
+            continue;
+        }
+        bool write = access_infos[resource->final_access].write_access != VK_ACCESS_2_NONE;
+        render_graph_plan_use(graph, &graph->final_batch, i, &states[i], resource->final_access, write);
+    }
+    render_graph_count_batch(graph, &graph->final_batch);
+
+    free(states);
+    return RENDER_GRAPH_OK;
+}
+
+static void render_graph_record_batch(RenderGraph* graph, BarrierBatch* batch, void* cmd) {
+    if (batch->barrier_count == 0 && !batch->has_memory_barrier) {
+        return;
+    }
+
+    VkImageMemoryBarrier2 image_barriers[batch->barrier_count + 1]; // +1 so the VLA is never zero sized
+    for (u32 i = 0; i < batch->barrier_count; i++) {
+        PlannedBarrier* planned = &graph->barriers[batch->barrier_start + i];
+        Resource* resource = &graph->resources[planned->resource];
+
+        image_barriers[i] = (VkImageMemoryBarrier2){
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .pNext = NULL,
+            .srcStageMask = planned->src_stages,
+            .srcAccessMask = planned->src_access,
+            .dstStageMask = planned->dst_stages,
+            .dstAccessMask = planned->dst_access,
+            .oldLayout = planned->old_layout,
+            .newLayout = planned->new_layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = resource->image_handle,
+            .subresourceRange = {
+                .aspectMask = resource->aspect,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+    }
+
+    VkDependencyInfo dependency_info = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = NULL,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = batch->has_memory_barrier ? 1 : 0,
+        .pMemoryBarriers = &batch->memory_barrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = NULL,
+        .imageMemoryBarrierCount = batch->barrier_count,
+        .pImageMemoryBarriers = image_barriers
+    };
+    vkCmdPipelineBarrier2(cmd, &dependency_info);
+}
+
+void render_graph_execute(RenderGraph* graph, void* cmd) {
+    for (u32 i = 0; i < graph->pass_count; i++) {
+        Pass* pass = &graph->passes[i];
+        if (!pass->active) {
+            continue;
+        }
+
+        render_graph_record_batch(graph, &pass->batch, cmd);
+        if (pass->execute) {
+            pass->execute(graph, cmd, pass->user_data);
+        }
+    }
+    render_graph_record_batch(graph, &graph->final_batch, cmd);
+}
+
+void render_graph_get_image(RenderGraph* graph, RenderGraphResource resource, void** out_image, void** out_view) {
+    *out_image = graph->resources[resource].image_handle;
+    *out_view = graph->resources[resource].view;
+}
+
+void render_graph_get_buffer(RenderGraph* graph, RenderGraphResource resource, Buffer** out_buffer) {
+    *out_buffer = graph->resources[resource].buffer;
+}
+
+void render_graph_get_stats(RenderGraph* graph, RenderGraphStats* out_stats) {
+    *out_stats = graph->stats;
+}
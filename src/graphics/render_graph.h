@@ -0,0 +1,101 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <stdbool.h>
+#include "device.h"
+#include "buffer.h"
+#include "image.h"
+#include "formats.h"
+#include "../int_types.h"
+
+// Passes declare which images and buffers they read and write, compiling the graph culls passes nothing
+// depends on, works out the synchronization2 barriers between passes (batched into one vkCmdPipelineBarrier2
+// per pass) and places transient images whose lifetimes don't overlap in the same memory
+typedef struct RenderGraph RenderGraph;
+
+typedef u32 RenderGraphResource;
+typedef u32 RenderGraphPass;
+
+typedef enum {
+    RENDER_GRAPH_UNDEFINED, // Contents don't matter, only valid as an import's initial access
+    RENDER_GRAPH_COLOR_ATTACHMENT,
+    RENDER_GRAPH_DEPTH_ATTACHMENT, // Read only depth (tests without writes) when declared as a read
+    RENDER_GRAPH_SAMPLED_FRAGMENT,
+    RENDER_GRAPH_SAMPLED_COMPUTE,
+    RENDER_GRAPH_STORAGE_COMPUTE,
+    RENDER_GRAPH_STORAGE_VERTEX, // Buffers read/written from vertex shaders (e.g. through device addresses)
+    RENDER_GRAPH_TRANSFER, // Copy source when read, destination when written
+    RENDER_GRAPH_VERTEX_INPUT, // Vertex and index buffers
+    RENDER_GRAPH_INDIRECT, // Indirect draw/dispatch arguments and counts
+    RENDER_GRAPH_PRESENT, // Only valid as an import's final access
+} RenderGraphAccess;
+
+// Called while the graph executes, with the pass' barriers already recorded
+typedef void (*RenderGraphExecute)(RenderGraph* graph, void* cmd, void* user_data);
+
+typedef struct {
+    Extent extent;
+    ColorFormat color_format; // Set exactly one of color_format/depth_format
+    DepthFormat depth_format;
+} RenderGraphImageOptions;
+
+typedef struct {
+    void* image; // VkImage
+    void* view; // VkImageView
+    u32 aspect; // VkImageAspectFlags
+    RenderGraphAccess initial_access; // How the image was last used before the graph runs
+    RenderGraphAccess final_access; // How it's used after the graph, it's left in that layout
+} RenderGraphImportOptions;
+
+typedef struct {
+    u32 active_pass_count;
+    u32 culled_pass_count;
+    u32 barrier_batch_count; // vkCmdPipelineBarrier2 calls per execute
+    u32 image_barrier_count;
+    u64 transient_memory; // Bytes backing every transient image after aliasing
+    u64 transient_memory_unaliased; // Bytes they would take with no aliasing
+} RenderGraphStats;
+
+typedef enum {
+    RENDER_GRAPH_OK, // Successfully compiled the graph
+    RENDER_GRAPH_ERROR_CREATE_IMAGE_FAIL, // Failed to create a transient image
+    RENDER_GRAPH_ERROR_MEM_ALLOC_FAIL, // Failed to allocate memory for transient images
+    RENDER_GRAPH_ERROR_BIND_FAIL, // Failed to bind a transient image to its memory
+} RenderGraphResult;
+
+void render_graph_new(RenderGraph** out_graph);
+// Destroys everything right away, the GPU has to be done with every frame the graph recorded
+void render_graph_free(Device* device, RenderGraph* graph);
+
+// Forgets every pass and resource, e.g. to rebuild after a resize. The transient images and their memory
+// are retired until the timeline reaches retire_value (e.g. renderer_get_frame_value), see render_graph_release_retired
+void render_graph_reset(RenderGraph* graph, u64 retire_value);
+
+// Destroys every retired transient image and memory slot whose retire value completed_value has reached
+void render_graph_release_retired(Device* device, RenderGraph* graph, u64 completed_value);
+
+// Transient images only live inside the graph, their usage flags come from how passes use them
+void render_graph_create_image(RenderGraph* graph, RenderGraphImageOptions options, RenderGraphResource* out_resource);
+void render_graph_import_image(RenderGraph* graph, RenderGraphImportOptions options, RenderGraphResource* out_resource);
+void render_graph_import_buffer(RenderGraph* graph, Buffer* buffer, RenderGraphResource* out_resource);
+
+// Swaps the handles behind an imported image (e.g. this frame's swapchain image) without recompiling
+void render_graph_set_image(RenderGraph* graph, RenderGraphResource resource, void* image, void* view);
+
+// Passes that (indirectly) write an output are kept, every other pass is culled
+void render_graph_mark_output(RenderGraph* graph, RenderGraphResource resource);
+
+// Passes run in the order they're added
+void render_graph_add_pass(RenderGraph* graph, const char* name, RenderGraphExecute execute, void* user_data, RenderGraphPass* out_pass);
+void render_graph_read(RenderGraph* graph, RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access);
+void render_graph_write(RenderGraph* graph, RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access);
+
+// Transients from the previous compile are retired until retire_value like in render_graph_reset
+RenderGraphResult render_graph_compile(Device* device, RenderGraph* graph, u64 retire_value);
+void render_graph_execute(RenderGraph* graph, void* cmd);
+
+void render_graph_get_image(RenderGraph* graph, RenderGraphResource resource, void** out_image, void** out_view);
+void render_graph_get_buffer(RenderGraph* graph, RenderGraphResource resource, Buffer** out_buffer);
+void render_graph_get_stats(RenderGraph* graph, RenderGraphStats* out_stats);
+
+#endif // RENDER_GRAPH_H
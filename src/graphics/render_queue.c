@@ -0,0 +1,257 @@
+#include "render_queue.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+#define RENDER_QUEUE_ID_BITS 16
+#define RENDER_QUEUE_MAX_ID ((1u << RENDER_QUEUE_ID_BITS) - 1)
+
+typedef struct {
+    u64 key;
+    u32 index; // Packet the key belongs to
+} SortEntry;
+
+// Maps state pointers to small dense ids so they fit in the sort key, rebuilt every frame
+typedef struct {
+    const void** keys;
+    u16* ids;
+    u32 capacity; // Power of two
+    u32 count;
+} StateIds;
+
+typedef struct RenderQueue {
+    DrawPacket* packets;
+    SortEntry* entries;
+    SortEntry* scratch;
+    u32 packet_count;
+    u32 packet_capacity;
+
+    StateIds pipeline_ids;
+    StateIds vertex_buffer_ids;
+    StateIds index_buffer_ids;
+} RenderQueue;
+
+static void state_ids_init(StateIds* ids, u32 capacity) {
+    ids->capacity = capacity;
+    ids->count = 0;
+    ids->keys = calloc(capacity, sizeof(void*));
+    ids->ids = calloc(capacity, sizeof(u16));
+}
+
+static void state_ids_free(StateIds* ids) {
+    free(ids->keys);
+    free(ids->ids);
+    ids->keys = NULL;
+    ids->ids = NULL;
+}
+
+static void state_ids_clear(StateIds* ids) {
+    if (ids->count > 0) {
+        memset(ids->keys, 0, ids->capacity * sizeof(void*));
+        ids->count = 0;
+    }
+}
+
+static u32 state_ids_hash(const void* key) {
+    u64 value = (u64)(usize)key;
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    return (u32)value;
+}
+
+static void state_ids_grow(StateIds* ids);
+
+static u16 state_ids_get(StateIds* ids, const void* key) {
+    if (key == NULL) {
+        return 0;
+    }
+
+    u32 mask = ids->capacity - 1;
+    for (u32 slot = state_ids_hash(key) & mask;; slot = (slot + 1) & mask) {
+        if (ids->keys[slot] == key) {
+            return ids->ids[slot];
+        }
+        if (ids->keys[slot] == NULL) {
+            if ((ids->count + 1) * 4 > ids->capacity * 3) {
+                state_ids_grow(ids);
+                return state_ids_get(ids, key);
+            }
+
+            // 0 is NULL, ids past the key's range all share the last one (still correct, just sorts worse)
+            u32 id = ids->count + 1 < RENDER_QUEUE_MAX_ID ? ids->count + 1 : RENDER_QUEUE_MAX_ID;
+            ids->keys[slot] = key;
+            ids->ids[slot] = (u16)id;
+            ids->count++;
+            return (u16)id;
+        }
+    }
+}
+
+static void state_ids_grow(StateIds* ids) {
+    StateIds old = *ids;
+    state_ids_init(ids, old.capacity * 2);
+
+    u32 mask = ids->capacity - 1;
+    for (u32 i = 0; i < old.capacity; i++) {
+        if (old.keys[i] == NULL) {
+            continue;
+        }
+
+        u32 slot = state_ids_hash(old.keys[i]) & mask;
+        while (ids->keys[slot] != NULL) {
+            slot = (slot + 1) & mask;
+        }
+        ids->keys[slot] = old.keys[i];
+        ids->ids[slot] = old.ids[i];
+        ids->count++;
+    }
+    state_ids_free(&old);
+}
+
+// LSD radix sort on 8 bit digits, digits every key agrees on are skipped so
+// a frame with few distinct states only pays for the bytes that differ
+static void render_queue_sort(RenderQueue* queue) {
+    u32 count = queue->packet_count;
+    SortEntry* src = queue->entries;
+    SortEntry* dst = queue->scratch;
+
+    for (u32 shift = 0; shift < 64; shift += 8) {
+        u32 histogram[256] = {0};
+        for (u32 i = 0; i < count; i++) {
+            histogram[(src[i].key >> shift) & 0xFF]++;
+        }
+
+        if (histogram[(src[0].key >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        u32 offset = 0;
+        for (u32 i = 0; i < 256; i++) {
+            u32 bucket = histogram[i];
+            histogram[i] = offset;
+            offset += bucket;
+        }
+
+        for (u32 i = 0; i < count; i++) {
+            dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+        }
+
+        SortEntry* swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != queue->entries) {
+        memcpy(queue->entries, src, count * sizeof(SortEntry));
+    }
+}
+
+void render_queue_new(u32 initial_capacity, RenderQueue** out_queue) {
+    RenderQueue* queue = malloc(sizeof(RenderQueue));
+    queue->packet_capacity = initial_capacity > 0 ? initial_capacity : 64;
+    queue->packet_count = 0;
+    queue->packets = malloc(queue->packet_capacity * sizeof(DrawPacket));
+    queue->entries = malloc(queue->packet_capacity * sizeof(SortEntry));
+    queue->scratch = malloc(queue->packet_capacity * sizeof(SortEntry));
+
+    state_ids_init(&queue->pipeline_ids, 64);
+    state_ids_init(&queue->vertex_buffer_ids, 256);
+    state_ids_init(&queue->index_buffer_ids, 256);
+
+    *out_queue = queue;
+}
+
+void render_queue_free(RenderQueue* queue) {
+    free(queue->packets);
+    free(queue->entries);
+    free(queue->scratch);
+    state_ids_free(&queue->pipeline_ids);
+    state_ids_free(&queue->vertex_buffer_ids);
+    state_ids_free(&queue->index_buffer_ids);
+    free(queue);
+}
+
+void render_queue_submit(RenderQueue* queue, DrawPacket packet) {
+    if (queue->packet_count == queue->packet_capacity) {
+        queue->packet_capacity *= 2;
+        queue->packets = realloc(queue->packets, queue->packet_capacity * sizeof(DrawPacket));
+        queue->entries = realloc(queue->entries, queue->packet_capacity * sizeof(SortEntry));
+        queue->scratch = realloc(queue->scratch, queue->packet_capacity * sizeof(SortEntry));
+    }
+
+    // Most expensive state change in the highest bits: pipeline | vertex buffer | index buffer | depth
+    u64 key = (u64)state_ids_get(&queue->pipeline_ids, packet.pipeline) << 48 |
+              (u64)state_ids_get(&queue->vertex_buffer_ids, packet.vertex_buffer) << 32 |
+              (u64)state_ids_get(&queue->index_buffer_ids, packet.index_buffer) << 16 |
+              (u64)packet.depth;
+
+    u32 index = queue->packet_count++;
+    queue->packets[index] = packet;
+    queue->entries[index] = (SortEntry){
+        .key = key,
+        .index = index
+    };
+}
+
+void render_queue_record(RenderQueue* queue, void* cmd, RenderQueueStats* out_stats) {
+    RenderQueueStats stats = {0};
+    if (queue->packet_count == 0) {
+        if (out_stats) {
+            *out_stats = stats;
+        }
+        return;
+    }
+
+    render_queue_sort(queue);
+
+    StateTracker tracker;
+    state_tracker_reset(&tracker, cmd);
+    Buffer* bound_vertex_buffer = NULL;
+    Buffer* bound_index_buffer = NULL;
+
+    for (u32 i = 0; i < queue->packet_count; i++) {
+        DrawPacket* packet = &queue->packets[queue->entries[i].index];
+
+        state_tracker_bind_pipeline(&tracker, packet->pipeline);
+        state_tracker_set(&tracker, packet->dynamic_values);
+
+        if (packet->vertex_buffer != NULL && packet->vertex_buffer != bound_vertex_buffer) {
+            void* vertex_buffer_handle = NULL;
+            buffer_get_buffer(packet->vertex_buffer, &vertex_buffer_handle);
+
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(cmd, 0, 1, (VkBuffer*)&vertex_buffer_handle, &offset);
+            bound_vertex_buffer = packet->vertex_buffer;
+            stats.vertex_buffer_binds++;
+        }
+
+        if (packet->index_buffer == NULL) {
+            vkCmdDraw(cmd, packet->count, packet->instance_count, packet->first, packet->first_instance);
+        } else {
+            if (packet->index_buffer != bound_index_buffer) {
+                void* index_buffer_handle = NULL;
+                buffer_get_buffer(packet->index_buffer, &index_buffer_handle);
+                vkCmdBindIndexBuffer(cmd, index_buffer_handle, 0, VK_INDEX_TYPE_UINT32);
+                bound_index_buffer = packet->index_buffer;
+                stats.index_buffer_binds++;
+            }
+
+            vkCmdDrawIndexed(cmd, packet->count, packet->instance_count, packet->first, packet->vertex_offset, packet->first_instance);
+        }
+        stats.draw_count++;
+    }
+    stats.pipeline_binds = tracker.pipeline_binds;
+    stats.state_sets = tracker.state_sets;
+
+    if (out_stats) {
+        *out_stats = stats;
+    }
+}
+
+void render_queue_clear(RenderQueue* queue) {
+    queue->packet_count = 0;
+    state_ids_clear(&queue->pipeline_ids);
+    state_ids_clear(&queue->vertex_buffer_ids);
+    state_ids_clear(&queue->index_buffer_ids);
+}
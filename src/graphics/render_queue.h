@@ -0,0 +1,45 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "pipeline.h"
+#include "state_tracker.h"
+#include "buffer.h"
+#include "../int_types.h"
+
+// Collects draws for a frame, sorts them by state (pipeline, then vertex buffer, then index buffer)
+// and records them with every redundant bind skipped
+typedef struct RenderQueue RenderQueue;
+
+typedef struct {
+    Pipeline* pipeline;
+    PipelineDynamicValues dynamic_values; // Only the states the pipeline made dynamic are used
+    Buffer* vertex_buffer;
+    Buffer* index_buffer; // NULL for non-indexed draws, u32 indices otherwise
+
+    u32 first; // First index (indexed) or vertex (non-indexed)
+    u32 count; // Index or vertex count
+    i32 vertex_offset; // Added to each index, indexed draws only
+    u32 first_instance;
+    u32 instance_count;
+
+    u16 depth; // Orders draws that share all state, e.g. quantized view depth for front to back
+} DrawPacket;
+
+typedef struct {
+    u32 draw_count;
+    u32 pipeline_binds;
+    u32 state_sets; // Dynamic state calls recorded, the rest were skipped as redundant
+    u32 vertex_buffer_binds;
+    u32 index_buffer_binds;
+} RenderQueueStats;
+
+void render_queue_new(u32 initial_capacity, RenderQueue** out_queue);
+void render_queue_free(RenderQueue* queue);
+
+void render_queue_submit(RenderQueue* queue, DrawPacket packet);
+
+// Sorts everything submitted since the last clear and records it into cmd (inside dynamic rendering)
+void render_queue_record(RenderQueue* queue, void* cmd, RenderQueueStats* out_stats);
+void render_queue_clear(RenderQueue* queue);
+
+#endif // RENDER_QUEUE_H
@@ -2,24 +2,66 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vulkan/vulkan.h>
 
+#define RENDERER_MAX_WAITS 8
+
+typedef struct {
+    VkCommandPool pool;
+    VkCommandBuffer* cmds; // Secondary command buffers allocated from the pool so far, reused every frame
+    u32 cmd_count;
+    u32 cmd_used; // Handed out since the pool was last reset
+} WorkerCommands;
+
 typedef struct Frame {
     VkCommandPool cmd_pool;
     VkSemaphore image_available_semaphore;
-    VkSemaphore render_finished_semaphore;
-    VkFence fence;
     VkCommandBuffer cmd;
+    u64 timeline_value; // Renderer timeline value that's reached once everything this frame last submitted is done
+
+    // Recorded and submitted to the compute queue before the graphics work that depends on it
+    VkCommandPool compute_cmd_pool;
+    VkCommandBuffer compute_cmd;
+
+    // One pool per recording thread so workers never share a pool, all reset together once per frame
+    WorkerCommands* workers;
 } Frame;
 
 typedef struct Renderer {
     Frame** frames;
     Swapchain* current_swapchain;
+    TransientAllocator* transient;
+    DepthTarget* depth_target;
+
+    // Compute signals its own compute_timeline, it runs on its own queue with nothing ordering it after the
+    // previous frame's graphics, so sharing one semaphore could signal out of order. Graphics waits on its
+    // compute, so a frame's graphics value still covers everything the frame submitted.
+    // Values are only committed once their submit succeeds, a failed submit never leaves a value nothing signals
+    VkSemaphore timeline;
+    VkSemaphore compute_timeline;
+    u64 timeline_value; // Last value graphics was submitted to signal
+    u64 pending_value; // Value the frame being recorded signals once it's submitted
+    u64 compute_value; // Last value compute was submitted to signal
+
+    // Extra timeline semaphores the next graphics submission waits on (uploads, etc..)
+    VkSemaphore wait_semaphores[RENDERER_MAX_WAITS];
+    u64 wait_values[RENDERER_MAX_WAITS];
+    u32 wait_count;
 
     u32 current_image_index;
+    bool swapchain_suboptimal; // Acquire said suboptimal, recreate once the frame is presented
     u32 frame_index;
     u32 max_flight;
+    u32 worker_count;
     u32 graphics_family;
+    u32 compute_family;
+
+    bool compute_recording;
+    VkPipeline compute_bound_pipeline;
+
+    // VK_KHR_push_descriptor isn't part of core, the loader doesn't export it
+    PFN_vkCmdPushDescriptorSetKHR cmd_push_descriptor_set;
 } Renderer;
 
 static bool renderer_create_frames(Device* device, Renderer* renderer) {
@@ -33,7 +75,7 @@ static bool renderer_create_frames(Device* device, Renderer* renderer) {
         VkCommandPoolCreateInfo command_pool_info = {
           .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
           .pNext = NULL,
-          .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+          .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
           .queueFamilyIndex = renderer->graphics_family
         };
     
@@ -55,23 +97,7 @@ static bool renderer_create_frames(Device* device, Renderer* renderer) {
           return false;
         }
     
-        VkResult render_finished_semaphore_create = vkCreateSemaphore(device_handle, &semaphore_create_info, NULL, &frame->render_finished_semaphore);
-        if (image_available_semaphore_create != VK_SUCCESS) {
-          fprintf(stderr, "Failed to create vulkan render finished semaphore for index %d! %d\n", i, render_finished_semaphore_create);
-          return false;
-        }
-    
-        VkFenceCreateInfo fence_info = {
-          .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-          .pNext = NULL,
-          .flags = VK_FENCE_CREATE_SIGNALED_BIT
-        };
-    
-        VkResult fence_create = vkCreateFence(device_handle, &fence_info, NULL, &frame->fence);
-        if (fence_create != VK_SUCCESS) {
-          fprintf(stderr, "Failed to create vulkan fence for index %d! %d\n", i, fence_create);
-          return false;
-        }
+        frame->timeline_value = 0;
     
         VkCommandBufferAllocateInfo command_buffer_info = {
           .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -87,6 +113,49 @@ static bool renderer_create_frames(Device* device, Renderer* renderer) {
           return false;
         }
 
+        VkCommandPoolCreateInfo compute_command_pool_info = {
+          .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+          .pNext = NULL,
+          .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+          .queueFamilyIndex = renderer->compute_family
+        };
+
+        VkResult compute_command_pool_create = vkCreateCommandPool(device_handle, &compute_command_pool_info, NULL, &frame->compute_cmd_pool);
+        if (compute_command_pool_create != VK_SUCCESS) {
+          fprintf(stderr, "Failed to create vulkan compute command pool for index %d! %d\n", i, compute_command_pool_create);
+          return false;
+        }
+
+        VkCommandBufferAllocateInfo compute_command_buffer_info = {
+          .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+          .pNext = NULL,
+          .commandPool = frame->compute_cmd_pool,
+          .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+          .commandBufferCount = 1
+        };
+
+        VkResult compute_command_buffer_create = vkAllocateCommandBuffers(device_handle, &compute_command_buffer_info, &frame->compute_cmd);
+        if (compute_command_buffer_create != VK_SUCCESS) {
+          fprintf(stderr, "Failed to create vulkan compute command buffer for index %d! %d\n", i, compute_command_buffer_create);
+          return false;
+        }
+
+        frame->workers = calloc(renderer->worker_count, sizeof(WorkerCommands));
+        for (u32 j = 0; j < renderer->worker_count; j++) {
+          VkCommandPoolCreateInfo worker_command_pool_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .pNext = NULL,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = renderer->graphics_family
+          };
+
+          VkResult worker_command_pool_create = vkCreateCommandPool(device_handle, &worker_command_pool_info, NULL, &frame->workers[j].pool);
+          if (worker_command_pool_create != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create vulkan command pool for worker %d in index %d! %d\n", j, i, worker_command_pool_create);
+            return false;
+          }
+        }
+
         renderer->frames[i] = frame;
     }
     return true;
@@ -96,46 +165,162 @@ static void renderer_free_frames(Device* device, Renderer* renderer) {
     void* device_handle = NULL;
     device_get_device(device, &device_handle);
 
+    if (renderer->frames == NULL) {
+        return;
+    }
+
     device_wait(device);
     for (u32 i = 0; i < renderer->max_flight; i++) {
         Frame* frame = renderer->frames[i];
         vkDestroySemaphore(device_handle, frame->image_available_semaphore, NULL);
-        vkDestroySemaphore(device_handle, frame->render_finished_semaphore, NULL);
-        vkDestroyFence(device_handle, frame->fence, NULL);
         vkDestroyCommandPool(device_handle, frame->cmd_pool, NULL);
+        vkDestroyCommandPool(device_handle, frame->compute_cmd_pool, NULL);
+        for (u32 j = 0; j < renderer->worker_count; j++) {
+          vkDestroyCommandPool(device_handle, frame->workers[j].pool, NULL);
+          free(frame->workers[j].cmds);
+        }
+        free(frame->workers);
         free(frame);
     }
     free(renderer->frames);
+    renderer->frames = NULL;
 }
 
-RendererResult renderer_new(Device* device, u32 max_frames_in_flight, Renderer** out_renderer) {
+RendererResult renderer_new(Device* device, RendererOptions options, Renderer** out_renderer) {
     void* device_handle = NULL;
     device_get_device(device, &device_handle);
 
     u32 graphics_family = 0;
     device_get_graphics_family(device, &graphics_family);
 
+    u32 compute_family = 0;
+    device_get_compute_family(device, &compute_family);
+
     Renderer* renderer = malloc(sizeof(Renderer));
-    renderer->max_flight = max_frames_in_flight;
+    renderer->max_flight = options.max_frames_in_flight;
+    renderer->worker_count = options.worker_count;
     renderer->frame_index = 0;
     renderer->current_swapchain = NULL;
+    renderer->transient = NULL;
+    renderer->depth_target = options.depth_target;
+    renderer->wait_count = 0;
     renderer->current_image_index = 0;
+    renderer->swapchain_suboptimal = false;
     renderer->graphics_family = graphics_family;
+    renderer->compute_family = compute_family;
+    renderer->compute_recording = false;
+    renderer->compute_bound_pipeline = NULL;
+    renderer->timeline = NULL;
+    renderer->compute_timeline = NULL;
+    renderer->timeline_value = 0;
+    renderer->pending_value = 0;
+    renderer->compute_value = 0;
+    renderer->frames = NULL;
+
+    renderer->cmd_push_descriptor_set = (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device_handle, "vkCmdPushDescriptorSetKHR");
+    if (renderer->cmd_push_descriptor_set == NULL) {
+      fprintf(stderr, "Failed to load vkCmdPushDescriptorSetKHR for renderer!\n");
+      renderer_free(device, renderer);
+      return RENDERER_ERROR_LOAD_PUSH_DESCRIPTOR_FAIL;
+    }
+
+    VkSemaphoreTypeCreateInfo semaphore_type_info = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      .pNext = NULL,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+      .initialValue = 0
+    };
+
+    VkSemaphoreCreateInfo semaphore_info = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = &semaphore_type_info,
+      .flags = 0
+    };
+
+    VkResult timeline_create = vkCreateSemaphore(device_handle, &semaphore_info, NULL, &renderer->timeline);
+    if (timeline_create != VK_SUCCESS) {
+      fprintf(stderr, "Failed to create vulkan timeline semaphore for renderer! %d\n", timeline_create);
+      renderer->timeline = NULL;
+      renderer_free(device, renderer);
+      return RENDERER_ERROR_CREATE_TIMELINE_FAIL;
+    }
+
+    VkResult compute_timeline_create = vkCreateSemaphore(device_handle, &semaphore_info, NULL, &renderer->compute_timeline);
+    if (compute_timeline_create != VK_SUCCESS) {
+      fprintf(stderr, "Failed to create vulkan compute timeline semaphore for renderer! %d\n", compute_timeline_create);
+      renderer->compute_timeline = NULL;
+      renderer_free(device, renderer);
+      return RENDERER_ERROR_CREATE_TIMELINE_FAIL;
+    }
 
     if (!renderer_create_frames(device, renderer)) {
       renderer_free(device, renderer);
       return RENDERER_ERROR_CREATE_FRAME_FAIL;
     }
 
+    if (options.transient_size > 0) {
+      TransientAllocatorResult transient_result = transient_allocator_new(device, (TransientAllocatorOptions){
+        .partition_size = options.transient_size,
+        .partition_count = renderer->max_flight,
+        .usage = BUFFER_UNIFORM | BUFFER_STORAGE | BUFFER_VERTEX | BUFFER_INDEX | BUFFER_INDIRECT
+      }, &renderer->transient);
+      if (transient_result != TRANSIENT_ALLOCATOR_OK) {
+        fprintf(stderr, "Failed to create renderer transient memory! %d\n", transient_result);
+        renderer->transient = NULL;
+        renderer_free(device, renderer);
+        return RENDERER_ERROR_CREATE_TRANSIENT_FAIL;
+      }
+    }
+
     *out_renderer = renderer;
     return RENDERER_OK;
 }
 
 void renderer_free(Device* device, Renderer* renderer) {
     renderer_free_frames(device, renderer);
+    if (renderer->transient) {
+      transient_allocator_free(device, renderer->transient);
+      renderer->transient = NULL;
+    }
+
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+    if (renderer->timeline) {
+      vkDestroySemaphore(device_handle, renderer->timeline, NULL);
+      renderer->timeline = NULL;
+    }
+    if (renderer->compute_timeline) {
+      vkDestroySemaphore(device_handle, renderer->compute_timeline, NULL);
+      renderer->compute_timeline = NULL;
+    }
     free(renderer);
 }
 
+// Work already submitted may still use the old images, the next graphics value is past all of it
+// and past the presents queued before it, so that's when the old swapchain can go
+static bool renderer_recreate_swapchain(Device* device, Renderer* renderer, Swapchain* swapchain) {
+    printf("Recreating swapchain for index %d\n", renderer->frame_index);
+    return swapchain_resize(device, swapchain, renderer->timeline_value + 1);
+}
+
+// Follows the swapchain after a recreate, the old image is done once everything submitted so far is.
+// Called before acquiring so a failure never leaves image_available_semaphore signalled with nothing waiting on it
+static bool renderer_resize_depth_target(Device* device, Renderer* renderer, Swapchain* swapchain) {
+    if (renderer->depth_target == NULL) {
+      return true;
+    }
+
+    Extent swapchain_extent;
+    swapchain_get_extent(swapchain, &swapchain_extent);
+
+    DepthTargetResult depth_resize = depth_target_resize(device, renderer->depth_target, swapchain_extent, renderer->timeline_value);
+    if (depth_resize != DEPTH_TARGET_OK) {
+      fprintf(stderr, "Failed to resize depth target for index %d! %d\n", renderer->frame_index, depth_resize);
+      return false;
+    }
+    return true;
+}
+
 RenderBeginResult renderer_begin_rendering(Device* device, Renderer* renderer, Swapchain* swapchain, Frame** out_frame) {
     void* device_handle = NULL;
     device_get_device(device, &device_handle);
@@ -143,32 +328,75 @@ RenderBeginResult renderer_begin_rendering(Device* device, Renderer* renderer, S
     u32 frame_index = renderer->frame_index;
     Frame* frame = renderer->frames[frame_index];
 
-    VkResult wait_for_fence = vkWaitForFences(device_handle, 1, &frame->fence, VK_TRUE, UINT64_MAX);
-    if (wait_for_fence != VK_SUCCESS) {
-      fprintf(stderr, "Failed to wait on fence for index %d! %d\n", frame_index, wait_for_fence);
-      return RENDER_BEGIN_ERROR_FENCE_WAIT_FAIL;
+    VkSemaphoreWaitInfo wait_info = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .semaphoreCount = 1,
+      .pSemaphores = &renderer->timeline,
+      .pValues = &frame->timeline_value
+    };
+
+    VkResult wait_for_frame = vkWaitSemaphores(device_handle, &wait_info, UINT64_MAX);
+    if (wait_for_frame != VK_SUCCESS) {
+      fprintf(stderr, "Failed to wait on timeline for index %d! %d\n", frame_index, wait_for_frame);
+      return RENDER_BEGIN_ERROR_FRAME_WAIT_FAIL;
+    }
+
+    // Everything this frame slot submitted last time is done, so its transient partition and command pools are free again
+    if (renderer->transient) {
+      transient_allocator_reset(renderer->transient, frame_index);
+    }
+
+    vkResetCommandPool(device_handle, frame->cmd_pool, 0);
+    vkResetCommandPool(device_handle, frame->compute_cmd_pool, 0);
+    for (u32 i = 0; i < renderer->worker_count; i++) {
+      vkResetCommandPool(device_handle, frame->workers[i].pool, 0);
+      frame->workers[i].cmd_used = 0;
+    }
+
+    u64 completed_value = 0;
+    vkGetSemaphoreCounterValue(device_handle, renderer->timeline, &completed_value);
+    swapchain_release_retired(device, swapchain, completed_value);
+    if (renderer->depth_target) {
+      depth_target_release_retired(device, renderer->depth_target, completed_value);
+    }
+
+    if (!renderer_resize_depth_target(device, renderer, swapchain)) {
+      return RENDER_BEGIN_ERROR_DEPTH_TARGET_FAIL;
     }
 
     void* swapchain_handle = NULL;
     swapchain_get_swapchain(swapchain, &swapchain_handle);
 
     u32 image_index = UINT32_MAX;
-    u32 get_next_image = vkAcquireNextImageKHR(device_handle, swapchain_handle, UINT64_MAX, frame->image_available_semaphore, NULL, &image_index);
-    if (get_next_image == VK_SUBOPTIMAL_KHR || (int)get_next_image == VK_ERROR_OUT_OF_DATE_KHR) {
-      printf("Resizing swapchain for index %d\n", frame_index);
-      swapchain_resize(device, swapchain);
-      renderer_rebuild_resources(device, renderer);
-      return RENDER_BEGIN_REBUILD_SWAPCHAIN;
+    VkResult get_next_image = vkAcquireNextImageKHR(device_handle, swapchain_handle, UINT64_MAX, frame->image_available_semaphore, NULL, &image_index);
+    if (get_next_image == VK_ERROR_OUT_OF_DATE_KHR) {
+      // Nothing was acquired and the semaphore wasn't touched, so recreate and try again instead of dropping the frame
+      if (!renderer_recreate_swapchain(device, renderer, swapchain)) {
+        return RENDER_BEGIN_REBUILD_SWAPCHAIN;
+      }
+      if (!renderer_resize_depth_target(device, renderer, swapchain)) {
+        return RENDER_BEGIN_ERROR_DEPTH_TARGET_FAIL;
+      }
+
+      swapchain_get_swapchain(swapchain, &swapchain_handle);
+      get_next_image = vkAcquireNextImageKHR(device_handle, swapchain_handle, UINT64_MAX, frame->image_available_semaphore, NULL, &image_index);
+      if (get_next_image == VK_ERROR_OUT_OF_DATE_KHR) {
+        return RENDER_BEGIN_REBUILD_SWAPCHAIN;
+      }
+    }
+
+    if (get_next_image == VK_SUBOPTIMAL_KHR) {
+      // The image is still presentable, render this frame and recreate after presenting it
+      renderer->swapchain_suboptimal = true;
     } else if (get_next_image != VK_SUCCESS) {
       fprintf(stderr, "Failed to get next image for index %d! %d\n", frame_index, get_next_image);
       return RENDER_BEGIN_ERROR_IMAGE_ACQUIRE_NEXT_FAIL;
     }
 
-    VkResult reset_fence = vkResetFences(device_handle, 1, &frame->fence);
-    if (reset_fence != VK_SUCCESS) {
-      fprintf(stderr, "Failed to reset fence for index %d! %d\n", frame_index, reset_fence);
-      return RENDER_BEGIN_ERROR_FENCE_RESET_FAIL;
-    } 
+    // Committed to the frame in renderer_end_rendering once the graphics submit goes through
+    renderer->pending_value = renderer->timeline_value + 1;
 
     VkCommandBufferBeginInfo command_buffer_begin_info = {
       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -216,6 +444,10 @@ RenderBeginResult renderer_begin_rendering(Device* device, Renderer* renderer, S
 
     vkCmdPipelineBarrier2(frame->cmd, &undefined_to_color);
 
+    if (renderer->depth_target) {
+      depth_target_begin_frame(renderer->depth_target, frame->cmd);
+    }
+
     renderer->current_swapchain = swapchain;
     renderer->current_image_index = image_index;
     
@@ -261,30 +493,87 @@ RenderEndResult renderer_end_rendering(Device* device, Renderer* renderer) {
     };
 
     vkCmdPipelineBarrier2(frame->cmd, &color_to_present);
+
+    if (renderer->transient) {
+      transient_allocator_flush(device, renderer->transient);
+    }
+
     VkResult command_buffer_end = vkEndCommandBuffer(frame->cmd);
     if (command_buffer_end != VK_SUCCESS) {
       fprintf(stderr, "Failed to end vulkan command buffer for index %d! %d\n", frame_index, command_buffer_end);
       return RENDER_END_ERROR_RECORD_STOP_FAIL;
     }
 
-    VkPipelineStageFlags wait_stages = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    VkSubmitInfo submit_info = {
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+    VkSemaphoreSubmitInfo wait_infos[1 + RENDERER_MAX_WAITS];
+    wait_infos[0] = (VkSemaphoreSubmitInfo){
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
       .pNext = NULL,
-      .waitSemaphoreCount = 1,
-      .pWaitSemaphores = &frame->image_available_semaphore,
-      .pWaitDstStageMask = &wait_stages,
-      .commandBufferCount = 1,
-      .pCommandBuffers = &frame->cmd,
-      .signalSemaphoreCount = 1,
-      .pSignalSemaphores = &frame->render_finished_semaphore
+      .semaphore = frame->image_available_semaphore,
+      .value = 0,
+      .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+      .deviceIndex = 0
+    };
+    for (u32 i = 0; i < renderer->wait_count; i++) {
+      wait_infos[1 + i] = (VkSemaphoreSubmitInfo){
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = NULL,
+        .semaphore = renderer->wait_semaphores[i],
+        .value = renderer->wait_values[i],
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .deviceIndex = 0
+      };
+    }
+    u32 wait_count = 1 + renderer->wait_count;
+    renderer->wait_count = 0;
+
+    void* render_finished_semaphore = NULL;
+    swapchain_get_render_finished_semaphore(renderer->current_swapchain, renderer->current_image_index, &render_finished_semaphore);
+
+    VkSemaphoreSubmitInfo signal_infos[2] = {
+      {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = NULL,
+        .semaphore = render_finished_semaphore,
+        .value = 0,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .deviceIndex = 0
+      },
+      {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = NULL,
+        .semaphore = renderer->timeline,
+        .value = renderer->pending_value,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .deviceIndex = 0
+      }
     };
 
-    VkResult submit = vkQueueSubmit(graphics_queue, 1, &submit_info, frame->fence);
+    VkCommandBufferSubmitInfo command_buffer_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+      .pNext = NULL,
+      .commandBuffer = frame->cmd,
+      .deviceMask = 0
+    };
+
+    VkSubmitInfo2 submit_info = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+      .pNext = NULL,
+      .flags = 0,
+      .waitSemaphoreInfoCount = wait_count,
+      .pWaitSemaphoreInfos = wait_infos,
+      .commandBufferInfoCount = 1,
+      .pCommandBufferInfos = &command_buffer_info,
+      .signalSemaphoreInfoCount = 2,
+      .pSignalSemaphoreInfos = signal_infos
+    };
+
+    VkResult submit = vkQueueSubmit2(graphics_queue, 1, &submit_info, NULL);
     if (submit != VK_SUCCESS) {
       fprintf(stderr, "Failed to submit graphics for index %d! %d\n", frame_index, submit);
       return RENDER_END_ERROR_SUBMIT_FAIL;
     }
+    renderer->timeline_value = renderer->pending_value;
+    frame->timeline_value = renderer->pending_value;
     
     void* swapchain = NULL;
     swapchain_get_swapchain(renderer->current_swapchain, &swapchain);
@@ -295,7 +584,7 @@ RenderEndResult renderer_end_rendering(Device* device, Renderer* renderer) {
       .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
       .pNext = NULL,
       .waitSemaphoreCount = 1,
-      .pWaitSemaphores = &frame->render_finished_semaphore,
+      .pWaitSemaphores = (VkSemaphore*)&render_finished_semaphore,
       .swapchainCount = 1,
       .pSwapchains = swapchains,
       .pImageIndices = &renderer->current_image_index,
@@ -303,7 +592,10 @@ RenderEndResult renderer_end_rendering(Device* device, Renderer* renderer) {
     };
 
     VkResult present = vkQueuePresentKHR(graphics_queue, &present_info);
-    if (present != VK_SUCCESS) {
+    if (present == VK_SUBOPTIMAL_KHR || present == VK_ERROR_OUT_OF_DATE_KHR || renderer->swapchain_suboptimal) {
+      renderer->swapchain_suboptimal = false;
+      renderer_recreate_swapchain(device, renderer, renderer->current_swapchain);
+    } else if (present != VK_SUCCESS) {
       fprintf(stderr, "Failed to present graphics for index %d! %d\n", frame_index, present);
       return RENDER_END_ERROR_PRESENT_FAIL;
     }
@@ -314,15 +606,350 @@ RenderEndResult renderer_end_rendering(Device* device, Renderer* renderer) {
     return RENDER_END_OK;
 }
 
-void renderer_rebuild_resources(Device* device, Renderer* renderer) {
-    renderer_free_frames(device, renderer);
-    renderer_create_frames(device, renderer);
+RenderComputeResult renderer_begin_compute(Renderer* renderer, void** out_cmd) {
+    u32 frame_index = renderer->frame_index;
+    Frame* frame = renderer->frames[frame_index];
+
+    // The timeline wait in renderer_begin_rendering also covers this, the frame's graphics value comes after compute's
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = NULL,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = NULL
+    };
+
+    VkResult command_buffer_begin = vkBeginCommandBuffer(frame->compute_cmd, &command_buffer_begin_info);
+    if (command_buffer_begin != VK_SUCCESS) {
+      fprintf(stderr, "Failed to start compute command buffer for index %d! %d\n", frame_index, command_buffer_begin);
+      return RENDER_COMPUTE_ERROR_RECORD_START_FAIL;
+    }
+
+    renderer->compute_recording = true;
+    renderer->compute_bound_pipeline = NULL;
+
+    *out_cmd = frame->compute_cmd;
+    return RENDER_COMPUTE_OK;
+}
+
+RenderComputeResult renderer_end_compute(Device* device, Renderer* renderer) {
+    void* compute_queue = NULL;
+    device_get_compute_queue(device, &compute_queue);
+
+    u32 frame_index = renderer->frame_index;
+    Frame* frame = renderer->frames[frame_index];
+
+    renderer->compute_recording = false;
+    VkResult command_buffer_end = vkEndCommandBuffer(frame->compute_cmd);
+    if (command_buffer_end != VK_SUCCESS) {
+      fprintf(stderr, "Failed to end compute command buffer for index %d! %d\n", frame_index, command_buffer_end);
+      return RENDER_COMPUTE_ERROR_RECORD_STOP_FAIL;
+    }
+
+    u64 compute_value = renderer->compute_value + 1;
+
+    VkSemaphoreSubmitInfo signal_info = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+      .pNext = NULL,
+      .semaphore = renderer->compute_timeline,
+      .value = compute_value,
+      .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .deviceIndex = 0
+    };
+
+    VkCommandBufferSubmitInfo command_buffer_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+      .pNext = NULL,
+      .commandBuffer = frame->compute_cmd,
+      .deviceMask = 0
+    };
+
+    VkSubmitInfo2 submit_info = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+      .pNext = NULL,
+      .flags = 0,
+      .waitSemaphoreInfoCount = 0,
+      .pWaitSemaphoreInfos = NULL,
+      .commandBufferInfoCount = 1,
+      .pCommandBufferInfos = &command_buffer_info,
+      .signalSemaphoreInfoCount = 1,
+      .pSignalSemaphoreInfos = &signal_info
+    };
+
+    VkResult submit = vkQueueSubmit2(compute_queue, 1, &submit_info, NULL);
+    if (submit != VK_SUCCESS) {
+      fprintf(stderr, "Failed to submit compute for index %d! %d\n", frame_index, submit);
+      return RENDER_COMPUTE_ERROR_SUBMIT_FAIL;
+    }
+    renderer->compute_value = compute_value;
+
+    // Graphics picks up the results, the semaphore wait also makes the compute writes visible to it
+    renderer_wait_semaphore(renderer, renderer->compute_timeline, compute_value);
+    return RENDER_COMPUTE_OK;
+}
+
+void renderer_dispatch(Renderer* renderer, ComputePipeline* pipeline, u32 group_count_x, u32 group_count_y, u32 group_count_z) {
+    if (!renderer->compute_recording) {
+      fprintf(stderr, "Can't dispatch outside of renderer_begin_compute/renderer_end_compute!\n");
+      return;
+    }
+
+    Frame* frame = renderer->frames[renderer->frame_index];
+
+    void* pipeline_handle = NULL;
+    compute_pipeline_get_pipeline(pipeline, &pipeline_handle);
+    if (pipeline_handle != renderer->compute_bound_pipeline) {
+      vkCmdBindPipeline(frame->compute_cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_handle);
+      renderer->compute_bound_pipeline = pipeline_handle;
+    }
+
+    vkCmdDispatch(frame->compute_cmd, group_count_x, group_count_y, group_count_z);
+}
+
+RenderSecondaryResult renderer_begin_secondary(Device* device, Renderer* renderer, u32 worker_index, PipelineRenderingOptions rendering, void** out_cmd) {
+    if (worker_index >= renderer->worker_count) {
+      fprintf(stderr, "Worker %d is out of range, renderer was created with %d workers!\n", worker_index, renderer->worker_count);
+      return RENDER_SECONDARY_ERROR_INVALID_WORKER;
+    }
+
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    u32 frame_index = renderer->frame_index;
+    WorkerCommands* worker = &renderer->frames[frame_index]->workers[worker_index];
+
+    if (worker->cmd_used == worker->cmd_count) {
+      VkCommandBufferAllocateInfo command_buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = NULL,
+        .commandPool = worker->pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+        .commandBufferCount = 1
+      };
+
+      VkCommandBuffer cmd = NULL;
+      VkResult command_buffer_create = vkAllocateCommandBuffers(device_handle, &command_buffer_info, &cmd);
+      if (command_buffer_create != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create secondary command buffer for worker %d in index %d! %d\n", worker_index, frame_index, command_buffer_create);
+        return RENDER_SECONDARY_ERROR_CREATE_FAIL;
+      }
+
+      worker->cmds = realloc(worker->cmds, (worker->cmd_count + 1) * sizeof(VkCommandBuffer));
+      worker->cmds[worker->cmd_count++] = cmd;
+    }
+
+    VkCommandBuffer cmd = worker->cmds[worker->cmd_used++];
+
+    VkFormat color_formats[rendering.color_count + 1]; // +1 keeps the array non-empty
+    for (u32 i = 0; i < rendering.color_count; i++) {
+      int color_format;
+      color_format_to_vk(rendering.colors[i], &color_format);
+      color_formats[i] = color_format;
+    }
+
+    int depth_format;
+    depth_format_to_vk(rendering.depth, &depth_format);
+
+    int stencil_format;
+    depth_format_to_vk(rendering.stencil, &stencil_format);
+
+    VkCommandBufferInheritanceRenderingInfo inheritance_rendering_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .viewMask = 0,
+      .colorAttachmentCount = rendering.color_count,
+      .pColorAttachmentFormats = color_formats,
+      .depthAttachmentFormat = depth_format,
+      .stencilAttachmentFormat = stencil_format,
+      .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+    };
+
+    VkCommandBufferInheritanceInfo inheritance_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+      .pNext = &inheritance_rendering_info,
+      .renderPass = NULL,
+      .subpass = 0,
+      .framebuffer = NULL,
+      .occlusionQueryEnable = VK_FALSE,
+      .queryFlags = 0,
+      .pipelineStatistics = 0
+    };
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = NULL,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+      .pInheritanceInfo = &inheritance_info
+    };
+
+    VkResult command_buffer_begin = vkBeginCommandBuffer(cmd, &command_buffer_begin_info);
+    if (command_buffer_begin != VK_SUCCESS) {
+      fprintf(stderr, "Failed to start secondary command buffer for worker %d in index %d! %d\n", worker_index, frame_index, command_buffer_begin);
+      return RENDER_SECONDARY_ERROR_RECORD_START_FAIL;
+    }
+
+    *out_cmd = cmd;
+    return RENDER_SECONDARY_OK;
+}
+
+RenderSecondaryResult renderer_end_secondary(void* cmd) {
+    VkResult command_buffer_end = vkEndCommandBuffer(cmd);
+    if (command_buffer_end != VK_SUCCESS) {
+      fprintf(stderr, "Failed to end secondary command buffer! %d\n", command_buffer_end);
+      return RENDER_SECONDARY_ERROR_RECORD_STOP_FAIL;
+    }
+    return RENDER_SECONDARY_OK;
+}
+
+void renderer_execute_secondaries(Renderer* renderer, void** cmds, u32 cmd_count) {
+    if (cmd_count == 0) {
+      return;
+    }
+
+    Frame* frame = renderer->frames[renderer->frame_index];
+    vkCmdExecuteCommands(frame->cmd, cmd_count, (VkCommandBuffer*)cmds);
+}
+
+void renderer_wait_semaphore(Renderer* renderer, void* semaphore, u64 value) {
+    for (u32 i = 0; i < renderer->wait_count; i++) {
+      if (renderer->wait_semaphores[i] == semaphore) {
+        renderer->wait_values[i] = value > renderer->wait_values[i] ? value : renderer->wait_values[i];
+        return;
+      }
+    }
+
+    if (renderer->wait_count == RENDERER_MAX_WAITS) {
+      fprintf(stderr, "Too many semaphores for the renderer to wait on! (max %d)\n", RENDERER_MAX_WAITS);
+      return;
+    }
+
+    renderer->wait_semaphores[renderer->wait_count] = semaphore;
+    renderer->wait_values[renderer->wait_count] = value;
+    renderer->wait_count++;
+}
+
+bool renderer_alloc_transient(Renderer* renderer, u64 size, u64 alignment, TransientAllocation* out_allocation) {
+    if (renderer->transient == NULL) {
+      fprintf(stderr, "Renderer was created without transient memory!\n");
+      return false;
+    }
+    return transient_allocator_alloc(renderer->transient, size, alignment, out_allocation);
+}
+
+bool renderer_draw_instanced(Renderer* renderer, void* cmd, InstancedDraw draw) {
+    if (draw.instance_count == 0) {
+      return true;
+    }
+
+    u64 instances_size = (u64)draw.instance_stride * draw.instance_count;
+
+    TransientAllocation instances;
+    if (!renderer_alloc_transient(renderer, instances_size, 16, &instances)) {
+      fprintf(stderr, "Failed to fit %u instances in transient memory!\n", draw.instance_count);
+      return false;
+    }
+    memcpy(instances.mapped, draw.instances, instances_size);
+
+    void* vertex_buffer_handle = NULL;
+    void* index_buffer_handle = NULL;
+    buffer_get_buffer(draw.vertex_buffer, &vertex_buffer_handle);
+    buffer_get_buffer(draw.index_buffer, &index_buffer_handle);
+
+    VkDeviceSize vertex_offset = 0;
+    VkDeviceSize instance_offset = instances.offset;
+    vkCmdBindVertexBuffers(cmd, 0, 1, (VkBuffer*)&vertex_buffer_handle, &vertex_offset);
+    vkCmdBindVertexBuffers(cmd, draw.instance_binding, 1, (VkBuffer*)&instances.buffer, &instance_offset);
+    vkCmdBindIndexBuffer(cmd, index_buffer_handle, 0, VK_INDEX_TYPE_UINT32);
+
+    vkCmdDrawIndexed(cmd, draw.index_count, draw.instance_count, draw.first_index, draw.vertex_offset, 0);
+    return true;
+}
+
+bool renderer_push_descriptors(Renderer* renderer, void* cmd, PipelineBindPoint bind_point, PipelineLayout* layout, DescriptorWrite* writes, u32 write_count) {
+    u32 push_set = 0;
+    if (!pipeline_layout_get_push_set(layout, &push_set)) {
+      fprintf(stderr, "Can't push descriptors, the pipeline layout has no push set!\n");
+      return false;
+    }
+
+    void* layout_handle = NULL;
+    pipeline_layout_get_layout(layout, &layout_handle);
+
+    // One info per write, each write only points at the kind its type reads
+    VkWriteDescriptorSet descriptor_writes[write_count + 1];
+    VkDescriptorBufferInfo buffer_infos[write_count + 1];
+    VkDescriptorImageInfo image_infos[write_count + 1];
+    for (u32 i = 0; i < write_count; i++) {
+      DescriptorWrite write = writes[i];
+
+      u32 descriptor_type = 0;
+      pipeline_layout_descriptor_type_to_vk(write.type, &descriptor_type);
+
+      descriptor_writes[i] = (VkWriteDescriptorSet){
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = NULL,
+        .dstSet = NULL, // Ignored for push descriptors
+        .dstBinding = write.binding,
+        .dstArrayElement = write.array_element,
+        .descriptorCount = 1,
+        .descriptorType = descriptor_type,
+        .pImageInfo = NULL,
+        .pBufferInfo = NULL,
+        .pTexelBufferView = NULL
+      };
+
+      if (write.type == DESCRIPTOR_UNIFORM_BUFFER || write.type == DESCRIPTOR_STORAGE_BUFFER) {
+        void* buffer_handle = NULL;
+        buffer_get_buffer(write.buffer, &buffer_handle);
+        buffer_infos[i] = (VkDescriptorBufferInfo){
+          .buffer = buffer_handle,
+          .offset = write.offset,
+          .range = write.range > 0 ? write.range : VK_WHOLE_SIZE
+        };
+        descriptor_writes[i].pBufferInfo = &buffer_infos[i];
+      } else {
+        void* view_handle = NULL;
+        image_get_view(write.image, &view_handle);
+        image_infos[i] = (VkDescriptorImageInfo){
+          .sampler = write.type == DESCRIPTOR_COMBINED_IMAGE_SAMPLER ? write.sampler : NULL,
+          .imageView = view_handle,
+          .imageLayout = write.type == DESCRIPTOR_STORAGE_IMAGE ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+        };
+        descriptor_writes[i].pImageInfo = &image_infos[i];
+      }
+    }
+
+    VkPipelineBindPoint vk_bind_point = bind_point == BIND_POINT_COMPUTE ? VK_PIPELINE_BIND_POINT_COMPUTE : VK_PIPELINE_BIND_POINT_GRAPHICS;
+    renderer->cmd_push_descriptor_set(cmd, vk_bind_point, layout_handle, push_set, write_count, descriptor_writes);
+    return true;
+}
+
+void renderer_get_timeline(Renderer* renderer, void** out_timeline) {
+  *out_timeline = renderer->timeline;
+}
+
+void renderer_get_frame_value(Renderer* renderer, u64* out_value) {
+  *out_value = renderer->pending_value;
+}
+
+void renderer_get_completed_value(Device* device, Renderer* renderer, u64* out_value) {
+  void* device_handle = NULL;
+  device_get_device(device, &device_handle);
+  vkGetSemaphoreCounterValue(device_handle, renderer->timeline, out_value);
 }
 
 void renderer_get_swapchain(Renderer* renderer, Swapchain** out_swapchain) {
     *out_swapchain = renderer->current_swapchain;
 }
 
+void renderer_get_frame_index(Renderer* renderer, u32* out_frame_index) {
+  *out_frame_index = renderer->frame_index;
+}
+
+void renderer_get_compute_cmd(Renderer* renderer, void** out_cmd) {
+  *out_cmd = renderer->compute_recording ? renderer->frames[renderer->frame_index]->compute_cmd : NULL;
+}
+
 void renderer_get_image_index(Renderer* renderer, u32* out_image_index) {
   *out_image_index = renderer->current_image_index;
 }
@@ -4,23 +4,66 @@
 #include "../int_types.h"
 #include "swapchain.h"
 #include "device.h"
+#include "transient_allocator.h"
+#include "compute_pipeline.h"
+#include "pipeline.h"
+#include "pipeline_layout.h"
+#include "image.h"
+#include "depth_target.h"
 
 typedef struct Frame Frame;
 
 typedef struct Renderer Renderer;
 
+typedef struct {
+    u32 max_frames_in_flight;
+    u64 transient_size; // Per-frame scratch memory for uniforms, dynamic vertices, etc.. (0 disables it)
+    u32 worker_count; // Threads that record secondary command buffers, each gets its own command pool per frame
+    DepthTarget* depth_target; // Resized with the swapchain and transitioned at the start of every frame, NULL for none
+} RendererOptions;
+
+typedef struct {
+    Buffer* vertex_buffer; // Bound at binding 0
+    Buffer* index_buffer; // u32 indices
+    u32 index_count;
+    u32 first_index;
+    i32 vertex_offset;
+
+    const void* instances; // instance_count elements of instance_stride bytes, copied into transient memory
+    u32 instance_stride; // Must match the stride of the pipeline's INPUT_INSTANCE binding
+    u32 instance_count;
+    u32 instance_binding; // Binding the pipeline reads instances from (see instance_layout_build)
+} InstancedDraw;
+
+// One descriptor of a push descriptor set. Buffer types use buffer/offset/range, image types use image
+// (plus sampler for DESCRIPTOR_COMBINED_IMAGE_SAMPLER). Sampled images are expected in SHADER_READ_ONLY_OPTIMAL,
+// storage images in GENERAL
+typedef struct {
+    u32 binding;
+    u32 array_element;
+    DescriptorType type;
+    Buffer* buffer;
+    u64 offset;
+    u64 range; // 0 uses everything from offset to the end of the buffer
+    Image* image;
+    void* sampler; // VkSampler
+} DescriptorWrite;
+
 typedef enum {
     RENDERER_OK, // Successfully created renderer
     RENDERER_ERROR_CREATE_FRAME_FAIL, // Failed to create a frame for the renderer
+    RENDERER_ERROR_CREATE_TIMELINE_FAIL, // Failed to create the timeline semaphores frames and their compute work are tracked with
+    RENDERER_ERROR_CREATE_TRANSIENT_FAIL, // Failed to create the per-frame transient memory
+    RENDERER_ERROR_LOAD_PUSH_DESCRIPTOR_FAIL, // The driver doesn't expose vkCmdPushDescriptorSetKHR
 } RendererResult;
 
 typedef enum {
     RENDER_BEGIN_OK, // Successfully started rendering
-    RENDER_BEGIN_REBUILD_SWAPCHAIN, // Swapchain is suboptimal/out-of-date, must rebuild before rendering (DON'T TREAT AS AN ERROR!!)
-    RENDER_BEGIN_ERROR_FENCE_WAIT_FAIL, // Failed to wait for the frame to finish rendering before reusing
+    RENDER_BEGIN_REBUILD_SWAPCHAIN, // Swapchain is out-of-date and can't be recreated yet (e.g. minimized window), skip this frame (DON'T TREAT AS AN ERROR!!)
+    RENDER_BEGIN_ERROR_FRAME_WAIT_FAIL, // Failed to wait for the frame to finish rendering before reusing
     RENDER_BEGIN_ERROR_IMAGE_ACQUIRE_NEXT_FAIL, // Failed to acquire the next image in the swapchain to render to
-    RENDER_BEGIN_ERROR_FENCE_RESET_FAIL, // Failed to reset the signal that tells us when rendering is finished
-    RENDER_BEGIN_ERROR_RECORD_START_FAIL // Failed to start recording commands
+    RENDER_BEGIN_ERROR_RECORD_START_FAIL, // Failed to start recording commands
+    RENDER_BEGIN_ERROR_DEPTH_TARGET_FAIL // Failed to resize the depth target to the swapchain's extent
 } RenderBeginResult;
 
 typedef enum {
@@ -30,15 +73,70 @@ typedef enum {
     RENDER_END_ERROR_PRESENT_FAIL // Failed to present data to swapchain
 } RenderEndResult;
 
-RendererResult renderer_new(Device* device, u32 max_frames_in_flight, Renderer** out_renderer);
+typedef enum {
+    RENDER_COMPUTE_OK, // Successfully started/submitted the frame's compute work
+    RENDER_COMPUTE_ERROR_RECORD_START_FAIL, // Failed to start recording compute commands
+    RENDER_COMPUTE_ERROR_RECORD_STOP_FAIL, // Failed to stop recording compute commands
+    RENDER_COMPUTE_ERROR_SUBMIT_FAIL // Failed to submit compute commands
+} RenderComputeResult;
+
+typedef enum {
+    RENDER_SECONDARY_OK, // Successfully started/stopped recording a secondary command buffer
+    RENDER_SECONDARY_ERROR_INVALID_WORKER, // The worker index is past the renderer's worker_count
+    RENDER_SECONDARY_ERROR_CREATE_FAIL, // Failed to create another secondary command buffer for the worker
+    RENDER_SECONDARY_ERROR_RECORD_START_FAIL, // Failed to start recording commands
+    RENDER_SECONDARY_ERROR_RECORD_STOP_FAIL // Failed to stop recording commands
+} RenderSecondaryResult;
+
+RendererResult renderer_new(Device* device, RendererOptions options, Renderer** out_renderer);
 void renderer_free(Device* device, Renderer* renderer);
 
 RenderBeginResult renderer_begin_rendering(Device* device, Renderer* renderer, Swapchain* swapchain, Frame** out_frame);
 RenderEndResult renderer_end_rendering(Device* device, Renderer* renderer);
-void renderer_rebuild_resources(Device* device, Renderer* renderer);
+
+// Frame compute work on the compute queue, only call after renderer_begin_rendering succeeded.
+// renderer_end_compute submits it and makes this frame's graphics submission wait for it. Buffers shared
+// between compute and graphics should use SHARING_CONCURRENT when the queues are in different families
+RenderComputeResult renderer_begin_compute(Renderer* renderer, void** out_cmd);
+RenderComputeResult renderer_end_compute(Device* device, Renderer* renderer);
+void renderer_dispatch(Renderer* renderer, ComputePipeline* pipeline, u32 group_count_x, u32 group_count_y, u32 group_count_z);
+
+// Secondary command buffers for drawing inside the frame's dynamic rendering, only call between begin/end.
+// Each worker index must only be used by one thread at a time, different workers can record in parallel.
+// The frame's vkCmdBeginRendering needs VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT to execute them
+RenderSecondaryResult renderer_begin_secondary(Device* device, Renderer* renderer, u32 worker_index, PipelineRenderingOptions rendering, void** out_cmd);
+RenderSecondaryResult renderer_end_secondary(void* cmd);
+void renderer_execute_secondaries(Renderer* renderer, void** cmds, u32 cmd_count);
+
+// Makes the next graphics submission wait until the timeline semaphore reaches value
+void renderer_wait_semaphore(Renderer* renderer, void* semaphore, u64 value);
+
+// Scratch memory that's valid until this frame slot comes around again, only call between begin/end.
+// Safe to call from parallel secondary workers
+bool renderer_alloc_transient(Renderer* renderer, u64 size, u64 alignment, TransientAllocation* out_allocation);
+
+// Draws every instance of the geometry in one call with the bound pipeline, only call between begin/end.
+// Safe from parallel secondary workers, transient allocations are serialized internally.
+// Returns false when the frame's transient memory can't fit the instances
+bool renderer_draw_instanced(Renderer* renderer, void* cmd, InstancedDraw draw);
+
+// Writes resources into the layout's push descriptor set directly in cmd (primary, secondary or compute),
+// so per-draw resources need no descriptor pool or set updates. Stays bound for draws/dispatches that follow.
+// Returns false when the layout has no push set
+bool renderer_push_descriptors(Renderer* renderer, void* cmd, PipelineBindPoint bind_point, PipelineLayout* layout, DescriptorWrite* writes, u32 write_count);
+
+// One timeline semaphore tracks every frame, a frame's GPU work is done once it reaches that frame's value.
+// Resources used by the current frame can be released once renderer_get_completed_value reaches renderer_get_frame_value
+void renderer_get_timeline(Renderer* renderer, void** out_timeline);
+void renderer_get_frame_value(Renderer* renderer, u64* out_value);
+void renderer_get_completed_value(Device* device, Renderer* renderer, u64* out_value);
 
 void renderer_get_swapchain(Renderer* renderer, Swapchain** out_swapchain);
 void renderer_get_image_index(Renderer* renderer, u32* out_image_index);
+// Frame slot in [0, max_frames_in_flight), for resources that need one copy per frame in flight
+void renderer_get_frame_index(Renderer* renderer, u32* out_frame_index);
+// The frame's compute command buffer, NULL outside of renderer_begin_compute/renderer_end_compute
+void renderer_get_compute_cmd(Renderer* renderer, void** out_cmd);
 
 void renderer_get_frame_cmd(Frame* frame, void** out_cmd);
 
@@ -3,10 +3,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <vulkan/vulkan.h>
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_mutex.h>
 
-typedef struct Shader {
+typedef struct ShaderModule {
     VkShaderModule module;
+    u32 holders; // Pipeline creations using the module right now
+    struct ShaderModule* next;
+} ShaderModule;
+
+typedef struct Shader {
+    SDL_Mutex* lock;
+    ShaderModule* current;
+    ShaderModule* replaced; // Modules swapped out by shader_reload that are still held
     ShaderType type;
+    u32 version;
 } Shader;
 
 typedef struct {
@@ -54,13 +65,76 @@ static ShaderResult shader_read_shader_file(const char* path, ShaderSource* out_
     return SHADER_OK;
 }
 
-ShaderResult shader_new(Device* device, ShaderOptions options, Shader** out_shader) {
+static ShaderResult shader_create_module(Device* device, const u32* code, usize size, ShaderModule** out_module) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    VkShaderModuleCreateInfo shader_module_info = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .codeSize = size,
+        .pCode = code
+    };
+
+    VkShaderModule module = NULL;
+    VkResult shader_create = vkCreateShaderModule(device_handle, &shader_module_info, NULL, &module);
+    if (shader_create != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create vulkan shader module! %d\n", shader_create);
+        return SHADER_ERROR_CREATE_HANDLE_FAIL;
+    }
+
+    ShaderModule* shader_module = malloc(sizeof(ShaderModule));
+    shader_module->module = module;
+    shader_module->holders = 0;
+    shader_module->next = NULL;
+
+    *out_module = shader_module;
+    return SHADER_OK;
+}
+
+static void shader_destroy_module(Device* device, ShaderModule* module) {
     void* device_handle = NULL;
     device_get_device(device, &device_handle);
 
+    vkDestroyShaderModule(device_handle, module->module, NULL);
+    free(module);
+}
+
+ShaderResult shader_new(Device* device, ShaderOptions options, Shader** out_shader) {
     Shader* shader = malloc(sizeof(Shader));
     shader->type = options.type;
-    shader->module = NULL;
+    shader->current = NULL;
+    shader->replaced = NULL;
+    shader->version = 0;
+
+    shader->lock = SDL_CreateMutex();
+    if (shader->lock == NULL) {
+        fprintf(stderr, "Failed to create lock for shader %s! %s\n", options.shader, SDL_GetError());
+        shader_free(device, shader);
+        return SHADER_ERROR_CREATE_LOCK_FAIL;
+    }
+
+    // Archived code is used straight from the mapping, no copy to free afterwards
+    if (options.archive) {
+        const u32* code = NULL;
+        usize code_size = 0;
+        if (!shader_archive_find(options.archive, options.shader, &code, &code_size)) {
+            fprintf(stderr, "Failed to find shader %s in the shader archive!\n", options.shader);
+            shader_free(device, shader);
+            return SHADER_ERROR_NOT_IN_ARCHIVE;
+        }
+
+        ShaderResult module_create = shader_create_module(device, code, code_size, &shader->current);
+        if (module_create != SHADER_OK) {
+            fprintf(stderr, "Failed to create vulkan shader module from archived shader %s!\n", options.shader);
+            shader_free(device, shader);
+            return module_create;
+        }
+
+        *out_shader = shader;
+        return SHADER_OK;
+    }
 
     ShaderSource shader_source;
     ShaderResult shader_file_read = shader_read_shader_file(options.shader, &shader_source);
@@ -70,43 +144,96 @@ ShaderResult shader_new(Device* device, ShaderOptions options, Shader** out_shad
         return shader_file_read;
     }
 
-    VkShaderModuleCreateInfo shader_module_info = {
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .codeSize = shader_source.size,
-        .pCode = (const u32*)shader_source.source
-    };
-    
-    VkResult shader_create = vkCreateShaderModule(device_handle, &shader_module_info, NULL, &shader->module);
-    if (shader_create != VK_SUCCESS) {
-        fprintf(stderr, "Failed to create vulkan shader module from shader file %s! %d\n", options.shader, shader_create);
-        free(shader_source.source);
+    ShaderResult module_create = shader_create_module(device, (const u32*)shader_source.source, shader_source.size, &shader->current);
+    free(shader_source.source);
+    if (module_create != SHADER_OK) {
+        fprintf(stderr, "Failed to create vulkan shader module from shader file %s!\n", options.shader);
         shader_free(device, shader);
-        return SHADER_ERROR_CREATE_HANDLE_FAIL;
+        return module_create;
     }
-    free(shader_source.source);
 
     *out_shader = shader;
     return SHADER_OK;
 }
 
 void shader_free(Device* device, Shader* shader) {
-    void* device_handle = NULL;
-    device_get_device(device, &device_handle);
-
-    if (shader->module) {
-        vkDestroyShaderModule(device_handle, shader->module, NULL);
-        shader->module = NULL;
+    if (shader->current) {
+        shader_destroy_module(device, shader->current);
+        shader->current = NULL;
+    }
+    while (shader->replaced) {
+        ShaderModule* module = shader->replaced;
+        shader->replaced = module->next;
+        shader_destroy_module(device, module);
+    }
+    if (shader->lock) {
+        SDL_DestroyMutex(shader->lock);
     }
     free(shader);
 }
 
+ShaderResult shader_reload(Device* device, Shader* shader, const u32* code, usize size) {
+    ShaderModule* module = NULL;
+    ShaderResult module_create = shader_create_module(device, code, size, &module);
+    if (module_create != SHADER_OK) {
+        return module_create;
+    }
+
+    SDL_LockMutex(shader->lock);
+    ShaderModule* old = shader->current;
+    shader->current = module;
+    shader->version++;
+    if (old->holders > 0) {
+        old->next = shader->replaced;
+        shader->replaced = old;
+        old = NULL;
+    }
+    SDL_UnlockMutex(shader->lock);
+
+    if (old) {
+        shader_destroy_module(device, old);
+    }
+    return SHADER_OK;
+}
+
+void shader_acquire_module(Shader* shader, void** out_module) {
+    SDL_LockMutex(shader->lock);
+    shader->current->holders++;
+    *out_module = shader->current->module;
+    SDL_UnlockMutex(shader->lock);
+}
+
+void shader_release_module(Device* device, Shader* shader, void* module) {
+    ShaderModule* destroy = NULL;
+
+    SDL_LockMutex(shader->lock);
+    if (shader->current->module == module) {
+        shader->current->holders--;
+    } else {
+        ShaderModule** link = &shader->replaced;
+        while (*link && (*link)->module != module) {
+            link = &(*link)->next;
+        }
+        if (*link && --(*link)->holders == 0) {
+            destroy = *link;
+            *link = destroy->next;
+        }
+    }
+    SDL_UnlockMutex(shader->lock);
+
+    if (destroy) {
+        shader_destroy_module(device, destroy);
+    }
+}
 
 void shader_get_module(Shader* shader, void** out_module) {
-    *out_module = shader->module;
+    *out_module = shader->current->module;
 }
 
 void shader_get_type(Shader* shader, ShaderType* out_type) {
     *out_type = shader->type;
 }
+
+void shader_get_version(Shader* shader, u32* out_version) {
+    *out_version = shader->version;
+}
@@ -2,19 +2,30 @@
 #define SHADER_H
 
 #include "device.h"
+#include "shader_archive.h"
+#include "../int_types.h"
 
 typedef struct Shader Shader;
 
 typedef enum {
     SHADER_VERTEX,
-    SHADER_FRAGMENT
+    SHADER_FRAGMENT,
+    SHADER_COMPUTE
 } ShaderType;
 
+typedef enum {
+    SHADER_STAGE_VERTEX = 1 << 0,
+    SHADER_STAGE_FRAGMENT = 1 << 1,
+    SHADER_STAGE_COMPUTE = 1 << 2,
+    SHADER_STAGE_ALL_GRAPHICS = SHADER_STAGE_VERTEX | SHADER_STAGE_FRAGMENT
+} ShaderStage;
+
 typedef struct {
-    const char* shader;
+    const char* shader; // Path to the SPIR-V file, or its name in archive (e.g. "object.vert.spv")
     const char* name;
     const char* entry_point;
     ShaderType type;
+    ShaderArchive* archive; // NULL reads the shader from its own file
 } ShaderOptions;
 
 typedef enum {
@@ -24,12 +35,25 @@ typedef enum {
     SHADER_ERROR_FILE_READ_SIZE_BUFFER_ALLOC_FAIL, // Failed to allocate buffer that reads the shader's code size
     SHADER_ERROR_BYTES_AND_FILE_SIZE_MISMATCH, // The code size and file size do not match
     SHADER_ERROR_CREATE_HANDLE_FAIL, // Failed to create the handle for the shader
+    SHADER_ERROR_CREATE_LOCK_FAIL, // Failed to create the lock guarding the module
+    SHADER_ERROR_NOT_IN_ARCHIVE, // The archive has no shader with that name
 } ShaderResult;
 
 ShaderResult shader_new(Device* device, ShaderOptions options, Shader** out_shader);
 void shader_free(Device* device, Shader* shader);
 
+// Swaps in a module built from new SPIR-V (size in bytes). Pipelines made before keep the old code,
+// the old module is destroyed once every pipeline creation holding it has released it
+ShaderResult shader_reload(Device* device, Shader* shader, const u32* code, usize size);
+
+// Thread safe access to the current module, hold it for as long as a pipeline is being created from it
+void shader_acquire_module(Shader* shader, void** out_module);
+void shader_release_module(Device* device, Shader* shader, void* module);
+
+// Not safe against shader_reload on another thread, use shader_acquire_module off the main thread
 void shader_get_module(Shader* shader, void** out_module);
 void shader_get_type(Shader* shader, ShaderType* out_type);
+// Bumped by every shader_reload
+void shader_get_version(Shader* shader, u32* out_version);
 
 #endif // SHADER_H
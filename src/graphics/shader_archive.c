@@ -0,0 +1,159 @@
+#include "shader_archive.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+typedef struct ShaderArchive {
+    const u8* data;
+    usize size;
+    const ShaderArchiveEntry* entries;
+    u32 entry_count;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} ShaderArchive;
+
+static bool shader_archive_map(const char* path, ShaderArchive* archive, ShaderArchiveResult* out_result) {
+#ifdef _WIN32
+    archive->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (archive->file == INVALID_HANDLE_VALUE) {
+        *out_result = SHADER_ARCHIVE_ERROR_FILE_OPEN_FAIL;
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(archive->file, &file_size);
+    archive->size = (usize)file_size.QuadPart;
+
+    archive->mapping = CreateFileMappingA(archive->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    archive->data = archive->mapping ? MapViewOfFile(archive->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (archive->data == NULL) {
+        *out_result = SHADER_ARCHIVE_ERROR_MAP_FAIL;
+        return false;
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        *out_result = SHADER_ARCHIVE_ERROR_FILE_OPEN_FAIL;
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        *out_result = SHADER_ARCHIVE_ERROR_MAP_FAIL;
+        return false;
+    }
+    archive->size = (usize)file_stat.st_size;
+
+    // The mapping keeps its own reference to the file
+    void* data = mmap(NULL, archive->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        *out_result = SHADER_ARCHIVE_ERROR_MAP_FAIL;
+        return false;
+    }
+    archive->data = data;
+#endif
+    return true;
+}
+
+ShaderArchiveResult shader_archive_open(const char* path, ShaderArchive** out_archive) {
+    ShaderArchive* archive = calloc(1, sizeof(ShaderArchive));
+
+    ShaderArchiveResult map_result = SHADER_ARCHIVE_OK;
+    if (!shader_archive_map(path, archive, &map_result)) {
+        fprintf(stderr, "Failed to map shader archive %s! %d\n", path, map_result);
+        shader_archive_close(archive);
+        return map_result;
+    }
+
+    const ShaderArchiveHeader* header = (const ShaderArchiveHeader*)archive->data;
+    if (archive->size < sizeof(ShaderArchiveHeader) || header->magic != SHADER_ARCHIVE_MAGIC || header->version != SHADER_ARCHIVE_VERSION
+        || (archive->size - sizeof(ShaderArchiveHeader)) / sizeof(ShaderArchiveEntry) < header->entry_count) {
+        fprintf(stderr, "Shader archive %s isn't a version %d shader archive!\n", path, SHADER_ARCHIVE_VERSION);
+        shader_archive_close(archive);
+        return SHADER_ARCHIVE_ERROR_INVALID;
+    }
+
+    archive->entries = (const ShaderArchiveEntry*)(archive->data + sizeof(ShaderArchiveHeader));
+    archive->entry_count = header->entry_count;
+
+    // Checked once here so lookups can hand out pointers without looking at the sizes again
+    for (u32 i = 0; i < archive->entry_count; i++) {
+        ShaderArchiveEntry entry = archive->entries[i];
+        if (entry.offset % SHADER_ARCHIVE_ALIGNMENT != 0 || entry.offset > archive->size || entry.size > archive->size - entry.offset ||
+            entry.name_offset > archive->size || entry.name_size > archive->size - entry.name_offset) {
+            fprintf(stderr, "Shader archive %s is truncated!\n", path);
+            shader_archive_close(archive);
+            return SHADER_ARCHIVE_ERROR_INVALID;
+        }
+
+        // vkCreateShaderModule needs a whole number of SPIR-V words
+        if (entry.size == 0 || entry.size % 4 != 0) {
+            fprintf(stderr, "Shader archive %s has a shader of %llu bytes, which isn't SPIR-V!\n", path, (unsigned long long)entry.size);
+            shader_archive_close(archive);
+            return SHADER_ARCHIVE_ERROR_INVALID;
+        }
+    }
+
+    *out_archive = archive;
+    return SHADER_ARCHIVE_OK;
+}
+
+void shader_archive_close(ShaderArchive* archive) {
+#ifdef _WIN32
+    if (archive->data) {
+        UnmapViewOfFile(archive->data);
+    }
+    if (archive->mapping) {
+        CloseHandle(archive->mapping);
+    }
+    if (archive->file && archive->file != INVALID_HANDLE_VALUE) {
+        CloseHandle(archive->file);
+    }
+#else
+    if (archive->data) {
+        munmap((void*)archive->data, archive->size);
+    }
+#endif
+    free(archive);
+}
+
+bool shader_archive_find(ShaderArchive* archive, const char* name, const u32** out_code, usize* out_size) {
+    u64 hash = shader_archive_hash(name);
+
+    u32 low = 0;
+    u32 high = archive->entry_count;
+    while (low < high) {
+        u32 middle = low + (high - low) / 2;
+        if (archive->entries[middle].name_hash < hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    // Names that aren't in the archive can still collide with one that is, the stored name settles it
+    usize name_size = strlen(name);
+    for (u32 i = low; i < archive->entry_count && archive->entries[i].name_hash == hash; i++) {
+        const ShaderArchiveEntry* entry = &archive->entries[i];
+        if (entry->name_size == name_size && memcmp(archive->data + entry->name_offset, name, name_size) == 0) {
+            *out_code = (const u32*)(archive->data + entry->offset);
+            *out_size = entry->size;
+            return true;
+        }
+    }
+    return false;
+}
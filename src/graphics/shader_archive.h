@@ -0,0 +1,55 @@
+#ifndef SHADER_ARCHIVE_H
+#define SHADER_ARCHIVE_H
+
+#include <stdbool.h>
+#include "../int_types.h"
+
+// Every compiled shader packed into one file (built by tools/pack_shaders.c) and memory mapped once,
+// shaders are created straight from the mapping without opening or copying a file each
+typedef struct ShaderArchive ShaderArchive;
+
+#define SHADER_ARCHIVE_MAGIC 0x4B505343 // "CSPK"
+#define SHADER_ARCHIVE_VERSION 2
+#define SHADER_ARCHIVE_ALIGNMENT 16 // Blob alignment, SPIR-V only needs 4
+
+// File layout: header, entry_count entries sorted by name_hash, the names, then the blobs
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 reserved;
+} ShaderArchiveHeader;
+
+typedef struct {
+    u64 name_hash; // shader_archive_hash of the file name, e.g. "object.vert.spv"
+    u64 offset; // From the start of the file, aligned to SHADER_ARCHIVE_ALIGNMENT
+    u64 size; // In bytes, a non-zero multiple of 4
+    u32 name_offset; // From the start of the file, the name isn't NUL terminated
+    u32 name_size;
+} ShaderArchiveEntry;
+
+typedef enum {
+    SHADER_ARCHIVE_OK, // Successfully mapped the archive
+    SHADER_ARCHIVE_ERROR_FILE_OPEN_FAIL, // Failed to open the archive file
+    SHADER_ARCHIVE_ERROR_MAP_FAIL, // Failed to memory map the archive file
+    SHADER_ARCHIVE_ERROR_INVALID, // Not a shader archive, a different version, truncated, or holding invalid SPIR-V sizes
+} ShaderArchiveResult;
+
+ShaderArchiveResult shader_archive_open(const char* path, ShaderArchive** out_archive);
+// Shaders created from the archive don't reference it, it can be closed once they exist
+void shader_archive_close(ShaderArchive* archive);
+
+// out_code points into the mapping and stays valid until the archive is closed
+bool shader_archive_find(ShaderArchive* archive, const char* name, const u32** out_code, usize* out_size);
+
+// 64-bit FNV-1a, shared with the packing tool
+static inline u64 shader_archive_hash(const char* name) {
+    u64 hash = 0xcbf29ce484222325ull;
+    for (const char* c = name; *c; c++) {
+        hash ^= (u8)*c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+#endif // SHADER_ARCHIVE_H
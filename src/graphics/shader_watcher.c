@@ -0,0 +1,317 @@
+#include "shader_watcher.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+#include <glslang/Include/glslang_c_interface.h>
+#include <glslang/Public/resource_limits_c.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#define SHADER_WATCHER_POLL_MS 100 // How long the thread waits for changes before checking for shutdown
+#define SHADER_WATCHER_MAX_PATH 512
+
+typedef struct {
+    Shader* shader;
+    char* source_name;
+    ShaderType type;
+
+    // Compiled SPIR-V waiting for shader_watcher_update, guarded by the lock
+    u32* code;
+    usize code_size; // In bytes
+} WatchedShader;
+
+typedef struct ShaderWatcher {
+    char* directory;
+    int notify_fd;
+    SDL_Thread* thread;
+    SDL_AtomicInt stopping;
+
+    SDL_Mutex* lock;
+    WatchedShader* shaders;
+    u32 shader_count;
+    u32 shader_capacity;
+} ShaderWatcher;
+
+static const glslang_stage_t shader_type_to_glslang[] = {
+    [SHADER_VERTEX] = GLSLANG_STAGE_VERTEX,
+    [SHADER_FRAGMENT] = GLSLANG_STAGE_FRAGMENT,
+    [SHADER_COMPUTE] = GLSLANG_STAGE_COMPUTE
+};
+
+static char* shader_watcher_read_source(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open shader source %s!\n", path);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (file_size < 0) {
+        fprintf(stderr, "Failed to acquire file size from shader source %s!\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    char* source = malloc(file_size + 1);
+    usize bytes_read = fread(source, 1, file_size, file);
+    fclose(file);
+    if (bytes_read != (usize)file_size) {
+        fprintf(stderr, "Bytes being read doesn't match file size from shader source %s!\n", path);
+        free(source);
+        return NULL;
+    }
+
+    source[file_size] = '\0';
+    return source;
+}
+
+// Returns SPIR-V the caller frees, NULL (with the compiler's log printed) when the source doesn't compile
+static u32* shader_watcher_compile(const char* name, const char* source, ShaderType type, usize* out_size) {
+    glslang_input_t input = {
+        .language = GLSLANG_SOURCE_GLSL,
+        .stage = shader_type_to_glslang[type],
+        .client = GLSLANG_CLIENT_VULKAN,
+        .client_version = GLSLANG_TARGET_VULKAN_1_3,
+        .target_language = GLSLANG_TARGET_SPV,
+        .target_language_version = GLSLANG_TARGET_SPV_1_6,
+        .code = source,
+        .default_version = 100,
+        .default_profile = GLSLANG_NO_PROFILE,
+        .force_default_version_and_profile = false,
+        .forward_compatible = false,
+        .messages = GLSLANG_MSG_DEFAULT_BIT,
+        .resource = glslang_default_resource()
+    };
+
+    glslang_shader_t* shader = glslang_shader_create(&input);
+    if (!glslang_shader_preprocess(shader, &input) || !glslang_shader_parse(shader, &input)) {
+        fprintf(stderr, "Failed to compile shader %s!\n%s\n", name, glslang_shader_get_info_log(shader));
+        glslang_shader_delete(shader);
+        return NULL;
+    }
+
+    glslang_program_t* program = glslang_program_create();
+    glslang_program_add_shader(program, shader);
+    if (!glslang_program_link(program, GLSLANG_MSG_SPV_RULES_BIT | GLSLANG_MSG_VULKAN_RULES_BIT)) {
+        fprintf(stderr, "Failed to link shader %s!\n%s\n", name, glslang_program_get_info_log(program));
+        glslang_program_delete(program);
+        glslang_shader_delete(shader);
+        return NULL;
+    }
+
+    glslang_program_SPIRV_generate(program, input.stage);
+    usize word_count = glslang_program_SPIRV_get_size(program);
+    u32* code = malloc(word_count * sizeof(u32));
+    glslang_program_SPIRV_get(program, code);
+
+    glslang_program_delete(program);
+    glslang_shader_delete(shader);
+
+    *out_size = word_count * sizeof(u32);
+    return code;
+}
+
+static void shader_watcher_recompile(ShaderWatcher* watcher, const char* source_name) {
+    bool watched = false;
+    ShaderType type = SHADER_VERTEX;
+
+    SDL_LockMutex(watcher->lock);
+    for (u32 i = 0; i < watcher->shader_count; i++) {
+        if (strcmp(watcher->shaders[i].source_name, source_name) == 0) {
+            watched = true;
+            type = watcher->shaders[i].type;
+            break;
+        }
+    }
+    SDL_UnlockMutex(watcher->lock);
+    if (!watched) {
+        return;
+    }
+
+    char path[SHADER_WATCHER_MAX_PATH];
+    snprintf(path, sizeof(path), "%s/%s", watcher->directory, source_name);
+    char* source = shader_watcher_read_source(path);
+    if (source == NULL) {
+        return;
+    }
+
+    usize code_size = 0;
+    u32* code = shader_watcher_compile(source_name, source, type, &code_size);
+    free(source);
+    if (code == NULL) {
+        return;
+    }
+
+    // Every shader made from the source gets its own copy, a newer compile replaces one that wasn't picked up yet
+    SDL_LockMutex(watcher->lock);
+    for (u32 i = 0; i < watcher->shader_count; i++) {
+        WatchedShader* watched_shader = &watcher->shaders[i];
+        if (strcmp(watched_shader->source_name, source_name) != 0) {
+            continue;
+        }
+
+        free(watched_shader->code);
+        watched_shader->code = malloc(code_size);
+        memcpy(watched_shader->code, code, code_size);
+        watched_shader->code_size = code_size;
+    }
+    SDL_UnlockMutex(watcher->lock);
+    free(code);
+}
+
+#ifdef __linux__
+static int shader_watcher_thread(void* data) {
+    ShaderWatcher* watcher = data;
+
+    _Alignas(struct inotify_event) char events[4096];
+    while (!SDL_GetAtomicInt(&watcher->stopping)) {
+        struct pollfd poll_fd = {
+            .fd = watcher->notify_fd,
+            .events = POLLIN
+        };
+        if (poll(&poll_fd, 1, SHADER_WATCHER_POLL_MS) <= 0) {
+            continue;
+        }
+
+        ssize_t length = read(watcher->notify_fd, events, sizeof(events));
+        for (ssize_t offset = 0; offset < length;) {
+            struct inotify_event* event = (struct inotify_event*)&events[offset];
+            offset += sizeof(struct inotify_event) + event->len;
+            if (event->len > 0) {
+                shader_watcher_recompile(watcher, event->name);
+            }
+        }
+    }
+    return 0;
+}
+#endif
+
+ShaderWatcherResult shader_watcher_new(ShaderWatcherOptions options, ShaderWatcher** out_watcher) {
+#ifndef __linux__
+    (void)options;
+    (void)out_watcher;
+    fprintf(stderr, "Failed to create shader watcher, hot reload needs inotify!\n");
+    return SHADER_WATCHER_ERROR_UNSUPPORTED;
+#else
+    ShaderWatcher* watcher = calloc(1, sizeof(ShaderWatcher));
+    watcher->notify_fd = -1;
+    watcher->directory = strdup(options.directory);
+    glslang_initialize_process();
+
+    watcher->lock = SDL_CreateMutex();
+    if (watcher->lock == NULL) {
+        fprintf(stderr, "Failed to create shader watcher lock! %s\n", SDL_GetError());
+        shader_watcher_free(watcher);
+        return SHADER_WATCHER_ERROR_CREATE_LOCK_FAIL;
+    }
+
+    // Editors either rewrite the file in place or write a new one and rename it over the old one
+    watcher->notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->notify_fd < 0 || inotify_add_watch(watcher->notify_fd, options.directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        fprintf(stderr, "Failed to watch shader directory %s!\n", options.directory);
+        shader_watcher_free(watcher);
+        return SHADER_WATCHER_ERROR_WATCH_FAIL;
+    }
+
+    watcher->thread = SDL_CreateThread(shader_watcher_thread, "shader watcher", watcher);
+    if (watcher->thread == NULL) {
+        fprintf(stderr, "Failed to start shader watcher thread! %s\n", SDL_GetError());
+        shader_watcher_free(watcher);
+        return SHADER_WATCHER_ERROR_CREATE_THREAD_FAIL;
+    }
+
+    *out_watcher = watcher;
+    return SHADER_WATCHER_OK;
+#endif
+}
+
+void shader_watcher_free(ShaderWatcher* watcher) {
+    if (watcher->thread) {
+        SDL_SetAtomicInt(&watcher->stopping, 1);
+        SDL_WaitThread(watcher->thread, NULL);
+    }
+#ifdef __linux__
+    if (watcher->notify_fd >= 0) {
+        close(watcher->notify_fd);
+    }
+#endif
+
+    for (u32 i = 0; i < watcher->shader_count; i++) {
+        free(watcher->shaders[i].source_name);
+        free(watcher->shaders[i].code);
+    }
+    free(watcher->shaders);
+
+    if (watcher->lock) {
+        SDL_DestroyMutex(watcher->lock);
+    }
+    glslang_finalize_process();
+    free(watcher->directory);
+    free(watcher);
+}
+
+void shader_watcher_watch(ShaderWatcher* watcher, Shader* shader, const char* source_name) {
+    ShaderType type;
+    shader_get_type(shader, &type);
+
+    SDL_LockMutex(watcher->lock);
+    if (watcher->shader_count == watcher->shader_capacity) {
+        watcher->shader_capacity = watcher->shader_capacity > 0 ? watcher->shader_capacity * 2 : 8;
+        watcher->shaders = realloc(watcher->shaders, watcher->shader_capacity * sizeof(WatchedShader));
+    }
+    watcher->shaders[watcher->shader_count++] = (WatchedShader){
+        .shader = shader,
+        .source_name = strdup(source_name),
+        .type = type,
+        .code = NULL,
+        .code_size = 0
+    };
+    SDL_UnlockMutex(watcher->lock);
+}
+
+void shader_watcher_unwatch(ShaderWatcher* watcher, Shader* shader) {
+    SDL_LockMutex(watcher->lock);
+    u32 kept = 0;
+    for (u32 i = 0; i < watcher->shader_count; i++) {
+        if (watcher->shaders[i].shader == shader) {
+            free(watcher->shaders[i].source_name);
+            free(watcher->shaders[i].code);
+        } else {
+            watcher->shaders[kept++] = watcher->shaders[i];
+        }
+    }
+    watcher->shader_count = kept;
+    SDL_UnlockMutex(watcher->lock);
+}
+
+void shader_watcher_update(Device* device, ShaderWatcher* watcher, PipelineCompiler* compiler) {
+    SDL_LockMutex(watcher->lock);
+    for (u32 i = 0; i < watcher->shader_count; i++) {
+        WatchedShader* watched = &watcher->shaders[i];
+        if (watched->code == NULL) {
+            continue;
+        }
+
+        ShaderResult reload = shader_reload(device, watched->shader, watched->code, watched->code_size);
+        if (reload != SHADER_OK) {
+            fprintf(stderr, "Failed to reload shader %s! %d\n", watched->source_name, reload);
+        } else if (compiler) {
+            pipeline_compiler_rebuild(compiler, watched->shader);
+        }
+
+        free(watched->code);
+        watched->code = NULL;
+        watched->code_size = 0;
+    }
+    SDL_UnlockMutex(watcher->lock);
+}
@@ -0,0 +1,38 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include "device.h"
+#include "shader.h"
+#include "pipeline_compiler.h"
+#include "../int_types.h"
+
+// Hot reloads shaders while the engine runs. A background thread watches a directory of GLSL sources
+// (inotify), recompiles a changed source to SPIR-V in-process with glslang and hands the result to
+// shader_watcher_update, which swaps it in at a frame boundary and queues the affected pipelines
+typedef struct ShaderWatcher ShaderWatcher;
+
+typedef struct {
+    const char* directory; // Directory holding the GLSL sources, e.g. the source tree's content/
+} ShaderWatcherOptions;
+
+typedef enum {
+    SHADER_WATCHER_OK, // Successfully started watching
+    SHADER_WATCHER_ERROR_UNSUPPORTED, // The platform has no file change notifications (inotify)
+    SHADER_WATCHER_ERROR_WATCH_FAIL, // Failed to start watching the directory
+    SHADER_WATCHER_ERROR_CREATE_LOCK_FAIL, // Failed to create the lock guarding compiled shaders
+    SHADER_WATCHER_ERROR_CREATE_THREAD_FAIL, // Failed to start the watcher thread
+} ShaderWatcherResult;
+
+ShaderWatcherResult shader_watcher_new(ShaderWatcherOptions options, ShaderWatcher** out_watcher);
+void shader_watcher_free(ShaderWatcher* watcher);
+
+// Reloads shader whenever source_name (a file in the watched directory, e.g. "object.frag") changes
+void shader_watcher_watch(ShaderWatcher* watcher, Shader* shader, const char* source_name);
+void shader_watcher_unwatch(ShaderWatcher* watcher, Shader* shader);
+
+// Call once per frame before recording, before pipeline_compiler_update. Reloads every shader whose source
+// finished compiling and rebuilds the pipelines made from it on compiler (can be NULL). The old pipelines
+// are retired by pipeline_compiler_update like any other replaced pipeline
+void shader_watcher_update(Device* device, ShaderWatcher* watcher, PipelineCompiler* compiler);
+
+#endif // SHADER_WATCHER_H
@@ -0,0 +1,94 @@
+#include "state_tracker.h"
+#include <vulkan/vulkan.h>
+
+void state_tracker_reset(StateTracker* tracker, void* cmd) {
+    *tracker = (StateTracker){0};
+    tracker->cmd = cmd;
+}
+
+void state_tracker_bind_pipeline(StateTracker* tracker, Pipeline* pipeline) {
+    if (pipeline == tracker->pipeline) {
+        return;
+    }
+
+    void* pipeline_handle = NULL;
+    pipeline_get_pipeline(pipeline, &pipeline_handle);
+    vkCmdBindPipeline(tracker->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_handle);
+
+    PipelineDynamicState dynamic_state = PIPELINE_DYNAMIC_NONE;
+    pipeline_get_dynamic_state(pipeline, &dynamic_state);
+
+    // A pipeline with a state baked in overwrites whatever was set for it
+    tracker->known &= dynamic_state;
+    tracker->pipeline = pipeline;
+    tracker->pipeline_dynamic_state = dynamic_state;
+    tracker->pipeline_binds++;
+}
+
+// Whether a dynamic state has to be recorded, updates the counters
+static bool state_tracker_needs(StateTracker* tracker, PipelineDynamicState flag, bool changed) {
+    if (!(tracker->pipeline_dynamic_state & flag)) {
+        return false;
+    }
+    if ((tracker->known & flag) && !changed) {
+        tracker->state_skips++;
+        return false;
+    }
+
+    tracker->known |= flag;
+    tracker->state_sets++;
+    return true;
+}
+
+void state_tracker_set(StateTracker* tracker, PipelineDynamicValues values) {
+    VkCommandBuffer cmd = tracker->cmd;
+    PipelineDynamicValues* current = &tracker->values;
+
+    if (state_tracker_needs(tracker, PIPELINE_DYNAMIC_CULL_MODE, values.cull_mode != current->cull_mode)) {
+        u32 cull_mode = 0;
+        pipeline_cull_mode_to_vk(values.cull_mode, &cull_mode);
+        vkCmdSetCullMode(cmd, cull_mode);
+        current->cull_mode = values.cull_mode;
+    }
+
+    if (state_tracker_needs(tracker, PIPELINE_DYNAMIC_FRONT_FACE, values.front_face_direction != current->front_face_direction)) {
+        u32 front_face = 0;
+        pipeline_front_face_to_vk(values.front_face_direction, &front_face);
+        vkCmdSetFrontFace(cmd, front_face);
+        current->front_face_direction = values.front_face_direction;
+    }
+
+    if (state_tracker_needs(tracker, PIPELINE_DYNAMIC_TOPOLOGY, values.topology != current->topology)) {
+        u32 topology = 0;
+        pipeline_topology_to_vk(values.topology, &topology);
+        vkCmdSetPrimitiveTopology(cmd, topology);
+        current->topology = values.topology;
+    }
+
+    if (state_tracker_needs(tracker, PIPELINE_DYNAMIC_DEPTH_TEST, values.depth_test != current->depth_test)) {
+        vkCmdSetDepthTestEnable(cmd, values.depth_test);
+        current->depth_test = values.depth_test;
+    }
+
+    if (state_tracker_needs(tracker, PIPELINE_DYNAMIC_DEPTH_WRITE, values.depth_write != current->depth_write)) {
+        vkCmdSetDepthWriteEnable(cmd, values.depth_write);
+        current->depth_write = values.depth_write;
+    }
+
+    if (state_tracker_needs(tracker, PIPELINE_DYNAMIC_DEPTH_COMPARE_OP, values.depth_compare_op != current->depth_compare_op)) {
+        u32 compare_op = 0;
+        pipeline_compare_op_to_vk(values.depth_compare_op, &compare_op);
+        vkCmdSetDepthCompareOp(cmd, compare_op);
+        current->depth_compare_op = values.depth_compare_op;
+    }
+
+    if (state_tracker_needs(tracker, PIPELINE_DYNAMIC_DEPTH_BIAS, values.depth_bias != current->depth_bias)) {
+        vkCmdSetDepthBiasEnable(cmd, values.depth_bias);
+        current->depth_bias = values.depth_bias;
+    }
+
+    if (state_tracker_needs(tracker, PIPELINE_DYNAMIC_PRIMITIVE_RESTART, values.primitive_restart != current->primitive_restart)) {
+        vkCmdSetPrimitiveRestartEnable(cmd, values.primitive_restart);
+        current->primitive_restart = values.primitive_restart;
+    }
+}
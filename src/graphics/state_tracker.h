@@ -0,0 +1,30 @@
+#ifndef STATE_TRACKER_H
+#define STATE_TRACKER_H
+
+#include "pipeline.h"
+#include "../int_types.h"
+
+// Tracks the pipeline and dynamic state recorded into a command buffer so redundant binds and
+// vkCmdSet* calls are skipped. Binding a pipeline that bakes a state forgets the tracked value,
+// the next pipeline that has it dynamic gets it set again
+typedef struct {
+    void* cmd;
+    Pipeline* pipeline;
+    PipelineDynamicState pipeline_dynamic_state; // States the bound pipeline expects to be set
+    PipelineDynamicState known; // States whose value in the command buffer is the one in values
+    PipelineDynamicValues values;
+
+    u32 pipeline_binds;
+    u32 state_sets; // vkCmdSet* calls recorded
+    u32 state_skips; // vkCmdSet* calls skipped because the value was already set
+} StateTracker;
+
+// Starts tracking cmd, nothing is known about a fresh command buffer
+void state_tracker_reset(StateTracker* tracker, void* cmd);
+
+void state_tracker_bind_pipeline(StateTracker* tracker, Pipeline* pipeline);
+
+// Sets the bound pipeline's dynamic states to values, states the pipeline bakes are ignored
+void state_tracker_set(StateTracker* tracker, PipelineDynamicValues values);
+
+#endif // STATE_TRACKER_H
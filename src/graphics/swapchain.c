@@ -4,24 +4,71 @@
 #include <stdlib.h>
 #include <vulkan/vulkan.h>
 
+// An old swapchain's handles, kept alive until the frames that used them are done
+typedef struct {
+    VkSwapchainKHR swapchain;
+    VkImage* images;
+    VkImageView* image_views;
+    VkSemaphore* render_finished_semaphores;
+    u32 image_count;
+    u64 retire_value;
+} RetiredSwapchain;
+
 typedef struct Swapchain {
     VkSwapchainKHR swapchain;
     VkSurfaceKHR surface;
     VkImage* images;
     VkImageView* image_views;
+    VkSemaphore* render_finished_semaphores;
     
     Extent extent;
     ColorFormat color_format;
     ColorSpace color_space;
+    PresentMode requested_present_mode;
+    PresentMode present_mode;
     
     u32 min_image_count;
     u32 image_count;
+
+    RetiredSwapchain* retired;
+    u32 retired_count;
+    u32 retired_capacity;
 } Swapchain;
 
 static VkColorSpaceKHR color_space_to_vk[] = {
   [COLOR_SPACE_SRGB_NLINEAR] = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR
 };
 
+static VkPresentModeKHR present_mode_to_vk[] = {
+  [PRESENT_MODE_FIFO] = VK_PRESENT_MODE_FIFO_KHR,
+  [PRESENT_MODE_FIFO_RELAXED] = VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+  [PRESENT_MODE_MAILBOX] = VK_PRESENT_MODE_MAILBOX_KHR,
+  [PRESENT_MODE_IMMEDIATE] = VK_PRESENT_MODE_IMMEDIATE_KHR
+};
+
+// Walks the requested mode's fallback chain until the surface supports one, FIFO always is
+static PresentMode swapchain_choose_present_mode(void* physical_device, void* surface, PresentMode requested) {
+    u32 supported_count = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &supported_count, NULL);
+
+    VkPresentModeKHR supported[supported_count + 1]; // +1 so the VLA is never zero sized
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &supported_count, supported);
+
+    PresentMode candidates[3] = {requested, PRESENT_MODE_FIFO, PRESENT_MODE_FIFO};
+    if (requested == PRESENT_MODE_IMMEDIATE) {
+      candidates[1] = PRESENT_MODE_MAILBOX;
+    }
+
+    for (u32 i = 0; i < 3; i++) {
+      for (u32 j = 0; j < supported_count; j++) {
+        if (supported[j] == present_mode_to_vk[candidates[i]]) {
+          return candidates[i];
+        }
+      }
+    }
+    return PRESENT_MODE_FIFO;
+}
+
 static bool swapchain_create_images(Device* device, Swapchain* swapchain) {
     void* device_handle = NULL;
     device_get_device(device, &device_handle);
@@ -35,10 +82,25 @@ static bool swapchain_create_images(Device* device, Swapchain* swapchain) {
     swapchain->images = swapchain_images;
     swapchain->image_count = swapchain_image_count;
 
+    VkSemaphoreCreateInfo semaphore_info = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0
+    };
+
+    swapchain->render_finished_semaphores = calloc(swapchain_image_count, sizeof(VkSemaphore));
+    swapchain->image_views = calloc(swapchain_image_count, sizeof(VkImageView));
+    for (u32 i = 0; i < swapchain_image_count; i++) {
+      VkResult semaphore_create = vkCreateSemaphore(device_handle, &semaphore_info, NULL, &swapchain->render_finished_semaphores[i]);
+      if (semaphore_create != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create vulkan render finished semaphore for index %d! %d\n", i, semaphore_create);
+        return false;
+      }
+    }
+
     int color_format = 0;
     color_format_to_vk(swapchain->color_format, &color_format);
     
-    swapchain->image_views = malloc(swapchain_image_count * sizeof(VkImageView));
     for (u32 i = 0; i < swapchain_image_count; i++) {
       VkImageViewCreateInfo image_view_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -71,23 +133,41 @@ static bool swapchain_create_images(Device* device, Swapchain* swapchain) {
     return true;
 }
 
-static void swapchain_free_images(Device* device, Swapchain* swapchain) {
+static void swapchain_destroy_retired(Device* device, RetiredSwapchain* retired) {
   void* device_handle = NULL;
   device_get_device(device, &device_handle);
   
-  for (u32 i = 0; i < swapchain->image_count; i++) {
-      vkDestroyImageView(device_handle, swapchain->image_views[i], NULL);
+  for (u32 i = 0; i < retired->image_count; i++) {
+      vkDestroyImageView(device_handle, retired->image_views[i], NULL);
+      vkDestroySemaphore(device_handle, retired->render_finished_semaphores[i], NULL);
   }
-  free(swapchain->image_views);
-  free(swapchain->images);
+  free(retired->render_finished_semaphores);
+  free(retired->image_views);
+  free(retired->images);
+  vkDestroySwapchainKHR(device_handle, retired->swapchain, NULL);
+}
+
+static RetiredSwapchain swapchain_take_handles(Swapchain* swapchain, u64 retire_value) {
+  return (RetiredSwapchain){
+    .swapchain = swapchain->swapchain,
+    .images = swapchain->images,
+    .image_views = swapchain->image_views,
+    .render_finished_semaphores = swapchain->render_finished_semaphores,
+    .image_count = swapchain->image_count,
+    .retire_value = retire_value
+  };
 }
 
 static void swapchain_free_resources(Device* device, Swapchain* swapchain) {
-  void* device_handle = NULL;
-  device_get_device(device, &device_handle);
+  RetiredSwapchain current = swapchain_take_handles(swapchain, 0);
+  swapchain_destroy_retired(device, &current);
 
-  swapchain_free_images(device, swapchain);
-  vkDestroySwapchainKHR(device_handle, swapchain->swapchain, NULL);
+  for (u32 i = 0; i < swapchain->retired_count; i++) {
+      swapchain_destroy_retired(device, &swapchain->retired[i]);
+  }
+  free(swapchain->retired);
+  swapchain->retired = NULL;
+  swapchain->retired_count = 0;
 }
 
 SwapchainResult swapchain_new(Device* device, SwapchainOptions options, Swapchain** out_swapchain) {
@@ -97,13 +177,39 @@ SwapchainResult swapchain_new(Device* device, SwapchainOptions options, Swapchai
     void* physical_device = NULL;
     device_get_physical_device(device, &physical_device);
 
-    Swapchain* swapchain = malloc(sizeof(Swapchain));
-
     VkSurfaceCapabilitiesKHR surfaceCapabilities;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, options.surface, &surfaceCapabilities);
 
     u32 width = surfaceCapabilities.currentExtent.width;
     u32 height = surfaceCapabilities.currentExtent.height;
+    if (width == 0 || height == 0) {
+      return SWAPCHAIN_ERROR_ZERO_EXTENT;
+    }
+
+    Swapchain* swapchain = malloc(sizeof(Swapchain));
+    swapchain->images = NULL;
+    swapchain->image_views = NULL;
+    swapchain->render_finished_semaphores = NULL;
+    swapchain->image_count = 0;
+    swapchain->retired = NULL;
+    swapchain->retired_count = 0;
+    swapchain->retired_capacity = 0;
+
+    u32 image_count = options.min_image_count > 0 ? options.min_image_count : surfaceCapabilities.minImageCount + 1;
+    if (image_count < surfaceCapabilities.minImageCount) {
+      image_count = surfaceCapabilities.minImageCount;
+    }
+    // maxImageCount of 0 means there's no limit
+    if (surfaceCapabilities.maxImageCount > 0 && image_count > surfaceCapabilities.maxImageCount) {
+      image_count = surfaceCapabilities.maxImageCount;
+    }
+
+    // Resizes re-resolve it since support can change with the surface, but only say so when the fallback changes
+    PresentMode present_mode = swapchain_choose_present_mode(physical_device, options.surface, options.present_mode);
+    bool fallback_changed = options.oldSwapchain == NULL || options.oldSwapchain->present_mode != present_mode;
+    if (present_mode != options.present_mode && fallback_changed) {
+      printf("Present mode %d isn't supported, using %d instead\n", options.present_mode, present_mode);
+    }
 
     // FORMAT:VK_FORMAT_B8G8R8A8_SRGB
     // COLORSPACE:VK_COLOR_SPACE_SRGB_NONLINEAR_KHR
@@ -116,7 +222,7 @@ SwapchainResult swapchain_new(Device* device, SwapchainOptions options, Swapchai
       .pNext = NULL,
       .flags = 0,
       .surface = options.surface,
-      .minImageCount = options.min_image_count,
+      .minImageCount = image_count,
       .imageFormat = color_format,
       .imageColorSpace = color_space_to_vk[options.color_space],
       .imageExtent = {width, height},
@@ -127,7 +233,7 @@ SwapchainResult swapchain_new(Device* device, SwapchainOptions options, Swapchai
       .pQueueFamilyIndices = NULL,
       .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
       .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-      .presentMode = VK_PRESENT_MODE_FIFO_KHR,
+      .presentMode = present_mode_to_vk[present_mode],
       .clipped = VK_TRUE
     };
 
@@ -147,6 +253,8 @@ SwapchainResult swapchain_new(Device* device, SwapchainOptions options, Swapchai
     swapchain->surface = options.surface;
     swapchain->color_format = options.format;
     swapchain->color_space = options.color_space;
+    swapchain->requested_present_mode = options.present_mode;
+    swapchain->present_mode = present_mode;
     swapchain->min_image_count = options.min_image_count;
     swapchain->extent = extent;
 
@@ -163,25 +271,52 @@ void swapchain_free(Device* device, Swapchain* swapchain) {
     free(swapchain);
 }
 
-void swapchain_resize(Device* device, Swapchain* swapchain) {
-    device_wait(device);
-
+bool swapchain_resize(Device* device, Swapchain* swapchain, u64 retire_value) {
     Swapchain* new_swapchain = NULL;
     SwapchainResult recreate_swapchain = swapchain_new(device, (SwapchainOptions){
         .oldSwapchain = swapchain,
         .surface = swapchain->surface,
         .min_image_count = swapchain->min_image_count,
+        .present_mode = swapchain->requested_present_mode,
         .format = swapchain->color_format,
         .color_space = swapchain->color_space
     }, &new_swapchain);
-    if (recreate_swapchain != SWAPCHAIN_OK) {
-        fprintf(stderr, "Failed to create new swapchain! %d", recreate_swapchain);
-        return;
+    if (recreate_swapchain == SWAPCHAIN_ERROR_ZERO_EXTENT) {
+        return false;
+    } else if (recreate_swapchain != SWAPCHAIN_OK) {
+        fprintf(stderr, "Failed to create new swapchain! %d\n", recreate_swapchain);
+        return false;
     }
-    
-    swapchain_free_resources(device, swapchain);
+
+    // Frames still in flight may be rendering to or presenting the old images
+    if (swapchain->retired_count == swapchain->retired_capacity) {
+        swapchain->retired_capacity = swapchain->retired_capacity > 0 ? swapchain->retired_capacity * 2 : 4;
+        swapchain->retired = realloc(swapchain->retired, swapchain->retired_capacity * sizeof(RetiredSwapchain));
+    }
+    swapchain->retired[swapchain->retired_count++] = swapchain_take_handles(swapchain, retire_value);
+
+    RetiredSwapchain* retired = swapchain->retired;
+    u32 retired_count = swapchain->retired_count;
+    u32 retired_capacity = swapchain->retired_capacity;
+
     *swapchain = *new_swapchain;
+    swapchain->retired = retired;
+    swapchain->retired_count = retired_count;
+    swapchain->retired_capacity = retired_capacity;
     free(new_swapchain);
+    return true;
+}
+
+void swapchain_release_retired(Device* device, Swapchain* swapchain, u64 completed_value) {
+    u32 kept = 0;
+    for (u32 i = 0; i < swapchain->retired_count; i++) {
+        if (swapchain->retired[i].retire_value <= completed_value) {
+            swapchain_destroy_retired(device, &swapchain->retired[i]);
+        } else {
+            swapchain->retired[kept++] = swapchain->retired[i];
+        }
+    }
+    swapchain->retired_count = kept;
 }
 
 void swapchain_get_swapchain(Swapchain* swapchain, void** out_swapchain) {
@@ -216,3 +351,11 @@ void swapchain_get_image_count(Swapchain* swapchain, u32* out_image_count) {
   *out_image_count = swapchain->image_count;
 }
 
+void swapchain_get_present_mode(Swapchain* swapchain, PresentMode* out_present_mode) {
+  *out_present_mode = swapchain->present_mode;
+}
+
+void swapchain_get_render_finished_semaphore(Swapchain* swapchain, u32 image_index, void** out_semaphore) {
+  *out_semaphore = swapchain->render_finished_semaphores[image_index];
+}
+
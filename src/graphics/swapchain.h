@@ -11,28 +11,38 @@ typedef enum {
     SWAPCHAIN_OK, // Successfully created a swapchain
     SWAPCHAIN_ERROR_CREATE_HANDLE_FAIL, // Failed to create a handle for the swapchain
     SWAPCHAIN_ERROR_IMAGE_VIEW_FAIL, // Failed to create a view (how we can access and modify images) for the swapchain images
+    SWAPCHAIN_ERROR_ZERO_EXTENT, // The surface has no area (e.g. a minimized window), try again once it does
 } SwapchainResult;
 
 typedef enum {
     COLOR_SPACE_SRGB_NLINEAR
 } ColorSpace;
 
+typedef enum {
+    PRESENT_MODE_FIFO, // Waits for vblank, always supported
+    PRESENT_MODE_FIFO_RELAXED, // Waits for vblank unless the frame is late, then tears (falls back to FIFO)
+    PRESENT_MODE_MAILBOX, // Newest frame replaces the queued one, low latency without tearing (falls back to FIFO)
+    PRESENT_MODE_IMMEDIATE // Presents right away and tears, lowest latency (falls back to MAILBOX, then FIFO)
+} PresentMode;
+
 typedef struct {
     Swapchain* oldSwapchain;
     void* surface;
-    u32 min_image_count;
+    u32 min_image_count; // Clamped to what the surface supports, 0 picks one more than the surface's minimum
+    PresentMode present_mode;
     ColorFormat format;
     ColorSpace color_space;
 } SwapchainOptions;
 
-typedef struct {
-    u32 width;
-    u32 height;
-} Extent;
-
 SwapchainResult swapchain_new(Device* device, SwapchainOptions options, Swapchain** out_swapchain);
 void swapchain_free(Device* device, Swapchain* swapchain);
-void swapchain_resize(Device* device, Swapchain* swapchain);
+// Recreates the swapchain in place without waiting on the GPU, the old one is passed as oldSwapchain and its
+// images, views and semaphores are retired until the timeline value retire_value is reached (see swapchain_release_retired).
+// Returns false when it couldn't be recreated, the current swapchain stays as is
+bool swapchain_resize(Device* device, Swapchain* swapchain, u64 retire_value);
+
+// Destroys every retired swapchain whose retire value completed_value has reached
+void swapchain_release_retired(Device* device, Swapchain* swapchain, u64 completed_value);
 
 void swapchain_get_swapchain(Swapchain* swapchain, void** out_swapchain);
 void swapchain_get_surface(Swapchain* swapchain, void** out_surface);
@@ -42,5 +52,11 @@ void swapchain_get_extent(Swapchain* swapchain, Extent* out_extent);
 void swapchain_get_color_format(Swapchain* swapchain, ColorFormat* out_color_format);
 void swapchain_get_color_space(Swapchain* swapchain, ColorSpace* out_color_space);
 void swapchain_get_image_count(Swapchain* swapchain, u32* out_image_count);
+// The present mode actually in use after falling back
+void swapchain_get_present_mode(Swapchain* swapchain, PresentMode* out_present_mode);
+
+// Binary semaphore presenting image_index waits on. One per image rather than per frame in flight,
+// since it's only safe to signal again once the image it was presented with has been acquired again
+void swapchain_get_render_finished_semaphore(Swapchain* swapchain, u32 image_index, void** out_semaphore);
 
 #endif // SWAPCHAIN_H
@@ -0,0 +1,107 @@
+#include "transient_allocator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <SDL3/SDL_atomic.h>
+
+// Partitions start on this boundary so any alignment up to it holds for the absolute buffer offset,
+// 256 covers every uniform/storage offset alignment the spec allows
+#define TRANSIENT_PARTITION_ALIGNMENT 256
+
+typedef struct TransientAllocator {
+    Buffer* buffer;
+    void* buffer_handle;
+    u8* mapped;
+
+    u64 partition_size;
+    u32 partition_count;
+
+    u32 partition; // Partition allocations currently come from
+    u64 head; // Bytes used in the current partition
+    SDL_SpinLock head_lock; // Guards head, secondary workers allocate in parallel
+} TransientAllocator;
+
+static u64 align_up(u64 value, u64 alignment) {
+    if (alignment <= 1) {
+        return value;
+    }
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+TransientAllocatorResult transient_allocator_new(Device* device, TransientAllocatorOptions options, TransientAllocator** out_allocator) {
+    TransientAllocator* allocator = malloc(sizeof(TransientAllocator));
+    allocator->buffer = NULL;
+    allocator->buffer_handle = NULL;
+    allocator->mapped = NULL;
+    allocator->partition_size = align_up(options.partition_size, TRANSIENT_PARTITION_ALIGNMENT);
+    allocator->partition_count = options.partition_count;
+    allocator->partition = 0;
+    allocator->head = 0;
+    allocator->head_lock = 0;
+
+    BufferResult buffer_result = buffer_new(device, (BufferOptions){
+        .size = allocator->partition_size * allocator->partition_count,
+        .usage = options.usage,
+        .sharing = SHARING_EXCLUSIVE,
+        .memory_access = MEMORY_ACCESS_CPU_TO_GPU,
+        .initial_data = NULL
+    }, &allocator->buffer);
+    if (buffer_result != BUFFER_OK) {
+        fprintf(stderr, "Failed to create transient buffer! %d\n", buffer_result);
+        allocator->buffer = NULL;
+        transient_allocator_free(device, allocator);
+        return TRANSIENT_ALLOCATOR_ERROR_CREATE_BUFFER_FAIL;
+    }
+
+    void* mapped = NULL;
+    buffer_get_buffer(allocator->buffer, &allocator->buffer_handle);
+    buffer_get_mapped_ptr(allocator->buffer, &mapped);
+    allocator->mapped = mapped;
+
+    *out_allocator = allocator;
+    return TRANSIENT_ALLOCATOR_OK;
+}
+
+void transient_allocator_free(Device* device, TransientAllocator* allocator) {
+    if (allocator->buffer) {
+        buffer_free(device, allocator->buffer);
+        allocator->buffer = NULL;
+    }
+    free(allocator);
+}
+
+void transient_allocator_reset(TransientAllocator* allocator, u32 partition) {
+    allocator->partition = partition % allocator->partition_count;
+    allocator->head = 0;
+}
+
+bool transient_allocator_alloc(TransientAllocator* allocator, u64 size, u64 alignment, TransientAllocation* out_allocation) {
+    SDL_LockSpinlock(&allocator->head_lock);
+    u64 offset = align_up(allocator->head, alignment);
+    if (offset + size > allocator->partition_size) {
+        SDL_UnlockSpinlock(&allocator->head_lock);
+        fprintf(stderr, "Transient partition is out of space! (%llu + %llu > %llu)\n",
+            (unsigned long long)offset, (unsigned long long)size, (unsigned long long)allocator->partition_size);
+        return false;
+    }
+    allocator->head = offset + size;
+    SDL_UnlockSpinlock(&allocator->head_lock);
+
+    u64 buffer_offset = (u64)allocator->partition * allocator->partition_size + offset;
+    *out_allocation = (TransientAllocation){
+        .buffer = allocator->buffer_handle,
+        .offset = buffer_offset,
+        .mapped = allocator->mapped + buffer_offset
+    };
+    return true;
+}
+
+void transient_allocator_flush(Device* device, TransientAllocator* allocator) {
+    if (allocator->head == 0) {
+        return;
+    }
+    buffer_flush(device, allocator->buffer, (u64)allocator->partition * allocator->partition_size, allocator->head);
+}
+
+void transient_allocator_get_used(TransientAllocator* allocator, u64* out_used) {
+    *out_used = allocator->head;
+}
@@ -0,0 +1,46 @@
+#ifndef TRANSIENT_ALLOCATOR_H
+#define TRANSIENT_ALLOCATOR_H
+
+#include <stdbool.h>
+#include "device.h"
+#include "buffer.h"
+#include "../int_types.h"
+
+// Bump allocator over one persistently mapped buffer split into equal partitions,
+// one per frame in flight. A partition is only reset once the frame that used it is done.
+typedef struct TransientAllocator TransientAllocator;
+
+typedef struct {
+    void* buffer; // Buffer handle shared by every transient allocation
+    u64 offset; // Offset into the buffer, use it for binds and dynamic offsets
+    void* mapped; // Host pointer to write the data through
+} TransientAllocation;
+
+typedef struct {
+    u64 partition_size; // Bytes available to a single frame
+    u32 partition_count; // Usually the number of frames in flight
+    BufferUsage usage; // What the transient data gets bound as
+} TransientAllocatorOptions;
+
+typedef enum {
+    TRANSIENT_ALLOCATOR_OK, // Successfully created a transient allocator
+    TRANSIENT_ALLOCATOR_ERROR_CREATE_BUFFER_FAIL, // Failed to create the mapped buffer backing every partition
+} TransientAllocatorResult;
+
+TransientAllocatorResult transient_allocator_new(Device* device, TransientAllocatorOptions options, TransientAllocator** out_allocator);
+void transient_allocator_free(Device* device, TransientAllocator* allocator);
+
+// Makes partition the one allocations come from and empties it, only call once the GPU is done with it.
+// Reset, flush and get_used must not race with alloc, call them from the thread that owns the frame
+void transient_allocator_reset(TransientAllocator* allocator, u32 partition);
+
+// Safe to call from several threads at once (e.g. secondary recording workers).
+// Returns false when the current partition is out of space
+bool transient_allocator_alloc(TransientAllocator* allocator, u64 size, u64 alignment, TransientAllocation* out_allocation);
+
+// Flushes everything allocated from the current partition since the last reset (no-op on coherent memory)
+void transient_allocator_flush(Device* device, TransientAllocator* allocator);
+
+void transient_allocator_get_used(TransientAllocator* allocator, u64* out_used);
+
+#endif // TRANSIENT_ALLOCATOR_H
@@ -0,0 +1,546 @@
+#include "uploader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+
+#define UPLOADER_MAX_BATCHES 8
+#define UPLOADER_STAGING_ALIGNMENT 16
+
+typedef struct {
+    VkCommandBuffer cmd;
+    UploadTicket ticket; // Timeline value the batch signals once its copies are done
+    u64 ring_end; // Ring head at submission, everything before it is free once this batch retires
+} UploadBatch;
+
+typedef struct {
+    VkBuffer buffer;
+    u64 offset;
+    u64 size;
+} OwnershipTransfer;
+
+typedef struct {
+    OwnershipTransfer* transfers;
+    u32 count;
+    u32 capacity;
+} OwnershipTransferList;
+
+typedef struct Uploader {
+    Buffer* staging;
+    VkBuffer staging_buffer;
+    u64 staging_size;
+
+    // Monotonic byte positions into the staging ring, the buffer offset is position % staging_size
+    u64 ring_head;
+    u64 ring_tail;
+
+    VkQueue queue;
+    u32 queue_family;
+    u32 graphics_family;
+    bool cross_family; // Copies run on their own queue family and need ownership transfers + a semaphore wait
+
+    VkSemaphore timeline; // Counts finished batches, the value is the ticket of the newest finished batch
+    VkCommandPool cmd_pool;
+    UploadBatch batches[UPLOADER_MAX_BATCHES];
+    u32 batch_index; // Batch being recorded (or recorded next), the in flight batches sit right before it
+    u32 in_flight_count;
+    bool recording;
+
+    OwnershipTransferList releases; // Exclusive buffers written by the batch being recorded
+    OwnershipTransferList acquires; // Released by submitted batches, the graphics side still has to acquire them
+    UploadTicket graphics_wait_ticket; // Newest ticket the graphics queue hasn't been told to wait on yet
+
+    UploadTicket next_ticket;
+    UploadTicket completed_ticket;
+} Uploader;
+
+static u64 align_up(u64 value, u64 alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static void ownership_transfer_list_push(OwnershipTransferList* list, VkBuffer buffer, u64 offset, u64 size) {
+    // Chunks of one upload land back to back, so they collapse into a single barrier
+    if (list->count > 0) {
+        OwnershipTransfer* last = &list->transfers[list->count - 1];
+        if (last->buffer == buffer && last->offset + last->size == offset) {
+            last->size += size;
+            return;
+        }
+    }
+
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity == 0 ? 16 : list->capacity * 2;
+        list->transfers = realloc(list->transfers, list->capacity * sizeof(OwnershipTransfer));
+    }
+    list->transfers[list->count++] = (OwnershipTransfer){
+        .buffer = buffer,
+        .offset = offset,
+        .size = size
+    };
+}
+
+static void ownership_transfer_list_free(OwnershipTransferList* list) {
+    if (list->transfers) {
+        free(list->transfers);
+        list->transfers = NULL;
+    }
+    list->count = 0;
+    list->capacity = 0;
+}
+
+static void uploader_record_ownership_transfers(Uploader* uploader, VkCommandBuffer cmd, OwnershipTransferList* list, bool release) {
+    if (list->count == 0) {
+        return;
+    }
+
+    // Release only needs to make the copy writes available, acquire makes them visible to whatever graphics does next
+    VkBufferMemoryBarrier2 barriers[list->count];
+    for (u32 i = 0; i < list->count; i++) {
+        barriers[i] = (VkBufferMemoryBarrier2){
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+            .pNext = NULL,
+            .srcStageMask = release ? VK_PIPELINE_STAGE_2_COPY_BIT : VK_PIPELINE_STAGE_2_NONE,
+            .srcAccessMask = release ? VK_ACCESS_2_TRANSFER_WRITE_BIT : VK_ACCESS_2_NONE,
+            .dstStageMask = release ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .dstAccessMask = release ? VK_ACCESS_2_NONE : VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+            .srcQueueFamilyIndex = uploader->queue_family,
+            .dstQueueFamilyIndex = uploader->graphics_family,
+            .buffer = list->transfers[i].buffer,
+            .offset = list->transfers[i].offset,
+            .size = list->transfers[i].size
+        };
+    }
+
+    VkDependencyInfo ownership_transfer = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = NULL,
+        .dependencyFlags = 0,
+        .bufferMemoryBarrierCount = list->count,
+        .pBufferMemoryBarriers = barriers
+    };
+
+    vkCmdPipelineBarrier2(cmd, &ownership_transfer);
+}
+
+static bool uploader_retire_oldest(Device* device, Uploader* uploader, bool wait) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    u32 oldest = (uploader->batch_index + UPLOADER_MAX_BATCHES - uploader->in_flight_count) % UPLOADER_MAX_BATCHES;
+    UploadBatch* batch = &uploader->batches[oldest];
+
+    if (wait) {
+        VkSemaphoreWaitInfo wait_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .semaphoreCount = 1,
+            .pSemaphores = &uploader->timeline,
+            .pValues = &batch->ticket
+        };
+
+        VkResult wait_for_semaphore = vkWaitSemaphores(device_handle, &wait_info, UINT64_MAX);
+        if (wait_for_semaphore != VK_SUCCESS) {
+            fprintf(stderr, "Failed to wait on upload batch %llu! %d\n", (unsigned long long)batch->ticket, wait_for_semaphore);
+            return false;
+        }
+    } else {
+        u64 completed = 0;
+        vkGetSemaphoreCounterValue(device_handle, uploader->timeline, &completed);
+        if (completed < batch->ticket) {
+            return false;
+        }
+    }
+
+    uploader->ring_tail = batch->ring_end;
+    uploader->completed_ticket = batch->ticket;
+    uploader->in_flight_count--;
+    return true;
+}
+
+static UploadResult uploader_reserve(Device* device, Uploader* uploader, u64 size, u64* out_offset) {
+    for (;;) {
+        if (uploader->ring_head == uploader->ring_tail) {
+            uploader->ring_head = 0;
+            uploader->ring_tail = 0;
+        }
+
+        // Copies need contiguous staging memory, so skip the tail end of the ring if it won't fit
+        u64 start = align_up(uploader->ring_head, UPLOADER_STAGING_ALIGNMENT);
+        u64 position = start % uploader->staging_size;
+        if (position + size > uploader->staging_size) {
+            start += uploader->staging_size - position;
+        }
+
+        if (start + size - uploader->ring_tail <= uploader->staging_size) {
+            uploader->ring_head = start + size;
+            *out_offset = start % uploader->staging_size;
+            return UPLOAD_OK;
+        }
+
+        // Ring is full, push out what's been recorded and wait for the oldest batch to give its space back
+        if (uploader->in_flight_count == 0) {
+            UploadTicket ticket = 0;
+            UploadResult submit = uploader_submit(uploader, &ticket);
+            if (submit != UPLOAD_OK) {
+                return submit;
+            }
+        }
+
+        if (!uploader_retire_oldest(device, uploader, true)) {
+            return UPLOAD_ERROR_WAIT_FAIL;
+        }
+    }
+}
+
+static UploadResult uploader_begin_batch(Device* device, Uploader* uploader) {
+    if (uploader->recording) {
+        return UPLOAD_OK;
+    }
+
+    if (uploader->in_flight_count == UPLOADER_MAX_BATCHES && !uploader_retire_oldest(device, uploader, true)) {
+        return UPLOAD_ERROR_WAIT_FAIL;
+    }
+
+    UploadBatch* batch = &uploader->batches[uploader->batch_index];
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = NULL
+    };
+
+    VkResult command_buffer_begin = vkBeginCommandBuffer(batch->cmd, &command_buffer_begin_info);
+    if (command_buffer_begin != VK_SUCCESS) {
+        fprintf(stderr, "Failed to start upload command buffer! %d\n", command_buffer_begin);
+        return UPLOAD_ERROR_RECORD_START_FAIL;
+    }
+
+    uploader->recording = true;
+    return UPLOAD_OK;
+}
+
+UploaderResult uploader_new(Device* device, UploaderOptions options, Uploader** out_uploader) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    u32 graphics_family = 0;
+    device_get_graphics_family(device, &graphics_family);
+
+    u32 transfer_family = 0;
+    device_get_transfer_family(device, &transfer_family);
+
+    void* transfer_queue = NULL;
+    device_get_transfer_queue(device, &transfer_queue);
+
+    Uploader* uploader = calloc(1, sizeof(Uploader));
+    uploader->staging_size = options.staging_size;
+    uploader->queue = transfer_queue;
+    uploader->queue_family = transfer_family;
+    uploader->graphics_family = graphics_family;
+    uploader->cross_family = transfer_family != graphics_family;
+    uploader->next_ticket = 1;
+
+    BufferResult staging_result = buffer_new(device, (BufferOptions){
+        .size = options.staging_size,
+        .usage = BUFFER_TRANSFER_SRC,
+        .sharing = SHARING_EXCLUSIVE,
+        .memory_access = MEMORY_ACCESS_CPU_TO_GPU,
+        .initial_data = NULL
+    }, &uploader->staging);
+    if (staging_result != BUFFER_OK) {
+        fprintf(stderr, "Failed to create upload staging buffer! %d\n", staging_result);
+        uploader->staging = NULL;
+        uploader_free(device, uploader);
+        return UPLOADER_ERROR_STAGING_BUFFER_FAIL;
+    }
+
+    void* staging_buffer = NULL;
+    buffer_get_buffer(uploader->staging, &staging_buffer);
+    uploader->staging_buffer = staging_buffer;
+
+    VkCommandPoolCreateInfo command_pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = transfer_family
+    };
+
+    VkResult command_pool_create = vkCreateCommandPool(device_handle, &command_pool_info, NULL, &uploader->cmd_pool);
+    if (command_pool_create != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create upload command pool! %d\n", command_pool_create);
+        uploader_free(device, uploader);
+        return UPLOADER_ERROR_CREATE_COMMAND_POOL_FAIL;
+    }
+
+    VkSemaphoreTypeCreateInfo semaphore_type_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext = NULL,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0
+    };
+
+    VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &semaphore_type_info,
+        .flags = 0
+    };
+
+    VkResult semaphore_create = vkCreateSemaphore(device_handle, &semaphore_info, NULL, &uploader->timeline);
+    if (semaphore_create != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create upload timeline semaphore! %d\n", semaphore_create);
+        uploader_free(device, uploader);
+        return UPLOADER_ERROR_CREATE_SEMAPHORE_FAIL;
+    }
+
+    for (u32 i = 0; i < UPLOADER_MAX_BATCHES; i++) {
+        UploadBatch* batch = &uploader->batches[i];
+
+        VkCommandBufferAllocateInfo command_buffer_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext = NULL,
+            .commandPool = uploader->cmd_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+
+        VkResult command_buffer_create = vkAllocateCommandBuffers(device_handle, &command_buffer_info, &batch->cmd);
+        if (command_buffer_create != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create upload command buffer for batch %d! %d\n", i, command_buffer_create);
+            uploader_free(device, uploader);
+            return UPLOADER_ERROR_CREATE_BATCH_FAIL;
+        }
+    }
+
+    *out_uploader = uploader;
+    return UPLOADER_OK;
+}
+
+void uploader_free(Device* device, Uploader* uploader) {
+    void* device_handle = NULL;
+    device_get_device(device, &device_handle);
+
+    while (uploader->in_flight_count > 0 && uploader_retire_oldest(device, uploader, true)) {}
+
+    if (uploader->recording) {
+        vkEndCommandBuffer(uploader->batches[uploader->batch_index].cmd);
+        uploader->recording = false;
+    }
+
+    if (uploader->timeline) {
+        vkDestroySemaphore(device_handle, uploader->timeline, NULL);
+        uploader->timeline = NULL;
+    }
+
+    if (uploader->cmd_pool) {
+        vkDestroyCommandPool(device_handle, uploader->cmd_pool, NULL);
+        uploader->cmd_pool = NULL;
+    }
+
+    if (uploader->staging) {
+        buffer_free(device, uploader->staging);
+        uploader->staging = NULL;
+    }
+
+    ownership_transfer_list_free(&uploader->releases);
+    ownership_transfer_list_free(&uploader->acquires);
+    free(uploader);
+}
+
+UploadResult uploader_upload(Device* device, Uploader* uploader, Buffer* buffer, u64 offset, u64 size, const void* data) {
+    void* dst_buffer = NULL;
+    buffer_get_buffer(buffer, &dst_buffer);
+
+    SharingMode sharing = SHARING_EXCLUSIVE;
+    buffer_get_sharing(buffer, &sharing);
+
+    // Uploads bigger than the ring are split up, each piece waits for space as needed
+    const u8* bytes = data;
+    while (size > 0) {
+        u64 chunk = size < uploader->staging_size ? size : uploader->staging_size;
+
+        u64 staging_offset = 0;
+        UploadResult reserve = uploader_reserve(device, uploader, chunk, &staging_offset);
+        if (reserve != UPLOAD_OK) {
+            return reserve;
+        }
+
+        UploadResult begin = uploader_begin_batch(device, uploader);
+        if (begin != UPLOAD_OK) {
+            return begin;
+        }
+
+        buffer_write(device, uploader->staging, staging_offset, chunk, bytes);
+
+        VkBufferCopy region = {
+            .srcOffset = staging_offset,
+            .dstOffset = offset,
+            .size = chunk
+        };
+        vkCmdCopyBuffer(uploader->batches[uploader->batch_index].cmd, uploader->staging_buffer, dst_buffer, 1, &region);
+
+        if (uploader->cross_family && sharing == SHARING_EXCLUSIVE) {
+            ownership_transfer_list_push(&uploader->releases, dst_buffer, offset, chunk);
+        }
+
+        bytes += chunk;
+        offset += chunk;
+        size -= chunk;
+    }
+    return UPLOAD_OK;
+}
+
+UploadResult uploader_buffer_new(Device* device, Uploader* uploader, BufferOptions options, Buffer** out_buffer) {
+    const void* initial_data = options.initial_data;
+    options.initial_data = NULL;
+    options.usage |= BUFFER_TRANSFER_DST;
+
+    Buffer* buffer = NULL;
+    BufferResult buffer_result = buffer_new(device, options, &buffer);
+    if (buffer_result != BUFFER_OK) {
+        fprintf(stderr, "Failed to create buffer for upload! %d\n", buffer_result);
+        return UPLOAD_ERROR_CREATE_BUFFER_FAIL;
+    }
+
+    if (initial_data != NULL) {
+        // Memory that ended up host visible anyway (e.g. on integrated GPUs) skips the staging copy
+        void* mapped = NULL;
+        buffer_get_mapped_ptr(buffer, &mapped);
+        if (mapped != NULL) {
+            buffer_write(device, buffer, 0, options.size, initial_data);
+        } else {
+            UploadResult upload = uploader_upload(device, uploader, buffer, 0, options.size, initial_data);
+            if (upload != UPLOAD_OK) {
+                buffer_free(device, buffer);
+                return upload;
+            }
+        }
+    }
+
+    *out_buffer = buffer;
+    return UPLOAD_OK;
+}
+
+UploadResult uploader_submit(Uploader* uploader, UploadTicket* out_ticket) {
+    if (!uploader->recording) {
+        *out_ticket = uploader->next_ticket - 1;
+        return UPLOAD_OK;
+    }
+
+    UploadBatch* batch = &uploader->batches[uploader->batch_index];
+
+    if (uploader->cross_family) {
+        // Exclusive buffers are handed over to the graphics family, uploader_acquire records the other half
+        uploader_record_ownership_transfers(uploader, batch->cmd, &uploader->releases, true);
+    } else {
+        // Same queue as rendering, a barrier is enough to order the copies before later submissions
+        VkMemoryBarrier2 transfer_to_all_barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+            .pNext = NULL,
+            .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+            .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT
+        };
+
+        VkDependencyInfo transfer_to_all = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .pNext = NULL,
+            .dependencyFlags = 0,
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers = &transfer_to_all_barrier
+        };
+
+        vkCmdPipelineBarrier2(batch->cmd, &transfer_to_all);
+    }
+
+    uploader->recording = false;
+    VkResult command_buffer_end = vkEndCommandBuffer(batch->cmd);
+    if (command_buffer_end != VK_SUCCESS) {
+        fprintf(stderr, "Failed to end upload command buffer! %d\n", command_buffer_end);
+        return UPLOAD_ERROR_RECORD_STOP_FAIL;
+    }
+
+    UploadTicket ticket = uploader->next_ticket;
+
+    VkCommandBufferSubmitInfo command_buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .pNext = NULL,
+        .commandBuffer = batch->cmd,
+        .deviceMask = 0
+    };
+
+    VkSemaphoreSubmitInfo signal_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = NULL,
+        .semaphore = uploader->timeline,
+        .value = ticket,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .deviceIndex = 0
+    };
+
+    VkSubmitInfo2 submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .pNext = NULL,
+        .flags = 0,
+        .waitSemaphoreInfoCount = 0,
+        .pWaitSemaphoreInfos = NULL,
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = &command_buffer_info,
+        .signalSemaphoreInfoCount = 1,
+        .pSignalSemaphoreInfos = &signal_info
+    };
+
+    VkResult submit = vkQueueSubmit2(uploader->queue, 1, &submit_info, NULL);
+    if (submit != VK_SUCCESS) {
+        fprintf(stderr, "Failed to submit upload batch! %d\n", submit);
+        return UPLOAD_ERROR_SUBMIT_FAIL;
+    }
+
+    for (u32 i = 0; i < uploader->releases.count; i++) {
+        OwnershipTransfer release = uploader->releases.transfers[i];
+        ownership_transfer_list_push(&uploader->acquires, release.buffer, release.offset, release.size);
+    }
+    uploader->releases.count = 0;
+
+    if (uploader->cross_family) {
+        uploader->graphics_wait_ticket = ticket;
+    }
+
+    batch->ticket = ticket;
+    batch->ring_end = uploader->ring_head;
+    uploader->next_ticket++;
+    uploader->in_flight_count++;
+    uploader->batch_index = (uploader->batch_index + 1) % UPLOADER_MAX_BATCHES;
+
+    *out_ticket = ticket;
+    return UPLOAD_OK;
+}
+
+void uploader_acquire(Uploader* uploader, void* cmd, UploadWait* out_wait) {
+    *out_wait = (UploadWait){
+        .semaphore = uploader->timeline,
+        .value = uploader->graphics_wait_ticket
+    };
+    uploader->graphics_wait_ticket = 0;
+
+    uploader_record_ownership_transfers(uploader, cmd, &uploader->acquires, false);
+    uploader->acquires.count = 0;
+}
+
+bool uploader_is_complete(Device* device, Uploader* uploader, UploadTicket ticket) {
+    while (uploader->completed_ticket < ticket && uploader->in_flight_count > 0) {
+        if (!uploader_retire_oldest(device, uploader, false)) {
+            break;
+        }
+    }
+    return uploader->completed_ticket >= ticket;
+}
+
+void uploader_wait(Device* device, Uploader* uploader, UploadTicket ticket) {
+    while (uploader->completed_ticket < ticket && uploader->in_flight_count > 0) {
+        if (!uploader_retire_oldest(device, uploader, true)) {
+            break;
+        }
+    }
+}
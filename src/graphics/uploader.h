@@ -0,0 +1,61 @@
+#ifndef UPLOADER_H
+#define UPLOADER_H
+
+#include <stdbool.h>
+#include "device.h"
+#include "buffer.h"
+#include "../int_types.h"
+
+typedef struct Uploader Uploader;
+
+// Completion handle for a submitted batch of uploads, batches complete in submission order
+typedef u64 UploadTicket;
+
+typedef struct {
+    void* semaphore; // Timeline semaphore the uploads signal
+    u64 value; // Value to wait for, 0 when there's nothing to wait on
+} UploadWait;
+
+typedef struct {
+    u64 staging_size; // Size of the host visible staging ring shared by every upload
+} UploaderOptions;
+
+typedef enum {
+    UPLOADER_OK, // Successfully created an uploader
+    UPLOADER_ERROR_STAGING_BUFFER_FAIL, // Failed to create the staging ring buffer
+    UPLOADER_ERROR_CREATE_COMMAND_POOL_FAIL, // Failed to create the command pool uploads are recorded from
+    UPLOADER_ERROR_CREATE_SEMAPHORE_FAIL, // Failed to create the timeline semaphore batches signal
+    UPLOADER_ERROR_CREATE_BATCH_FAIL, // Failed to create the command buffer for a batch
+} UploaderResult;
+
+typedef enum {
+    UPLOAD_OK, // Successfully queued/submitted the upload
+    UPLOAD_ERROR_CREATE_BUFFER_FAIL, // Failed to create the destination buffer
+    UPLOAD_ERROR_RECORD_START_FAIL, // Failed to start recording the batch's copy commands
+    UPLOAD_ERROR_RECORD_STOP_FAIL, // Failed to stop recording the batch's copy commands
+    UPLOAD_ERROR_SUBMIT_FAIL, // Failed to submit the batch
+    UPLOAD_ERROR_WAIT_FAIL, // Failed to wait for an older batch to free up staging space
+} UploadResult;
+
+UploaderResult uploader_new(Device* device, UploaderOptions options, Uploader** out_uploader);
+void uploader_free(Device* device, Uploader* uploader);
+
+// Copies data into the staging ring and records a copy into the current batch,
+// nothing reaches the GPU until uploader_submit
+UploadResult uploader_upload(Device* device, Uploader* uploader, Buffer* buffer, u64 offset, u64 size, const void* data);
+
+// buffer_new that also accepts initial_data for memory the CPU can't map (e.g. MEMORY_ACCESS_GPU)
+UploadResult uploader_buffer_new(Device* device, Uploader* uploader, BufferOptions options, Buffer** out_buffer);
+
+// Submits every upload recorded since the last submit as one command buffer on the transfer queue
+UploadResult uploader_submit(Uploader* uploader, UploadTicket* out_ticket);
+
+// Records the graphics side of the queue family ownership transfers for everything submitted so far into cmd
+// (a graphics command buffer), the submission cmd goes out with has to wait on out_wait when its value isn't 0.
+// With no dedicated transfer family this records nothing and there's nothing to wait on
+void uploader_acquire(Uploader* uploader, void* cmd, UploadWait* out_wait);
+
+bool uploader_is_complete(Device* device, Uploader* uploader, UploadTicket ticket);
+void uploader_wait(Device* device, Uploader* uploader, UploadTicket ticket);
+
+#endif // UPLOADER_H
@@ -5,14 +5,34 @@
 
 #include "game/game.h"
 #include "graphics/buffer.h"
+#include "graphics/depth_target.h"
 #include "graphics/geometry.h"
+#include "graphics/geometry_pool.h"
 #include "graphics/pipeline.h"
+#include "graphics/pipeline_compiler.h"
 #include "graphics/pipeline_layout.h"
+#include "graphics/pipeline_registry.h"
 #include "graphics/swapchain.h"
 #include "graphics/renderer.h"
+#include "graphics/render_queue.h"
+#include "graphics/shader_watcher.h"
 #include "graphics/device.h"
-
-#define MAX_FRAMES_IN_FLIGHT 2
+#include "graphics/uploader.h"
+
+#define MAX_FRAMES_IN_FLIGHT 2 // Independent of the swapchain's image count, fewer means less latency
+#define SWAPCHAIN_IMAGE_COUNT 3
+#define SWAPCHAIN_PRESENT_MODE PRESENT_MODE_MAILBOX
+#define UPLOAD_STAGING_SIZE (16 * 1024 * 1024)
+#define TRANSIENT_FRAME_SIZE (4 * 1024 * 1024)
+#define GEOMETRY_POOL_VERTICES (256 * 1024)
+#define GEOMETRY_POOL_INDICES (1024 * 1024)
+#define DEPTH_FORMAT DEPTH32_SFLOAT
+#define PIPELINE_CACHE_PATH "pipeline_cache.bin"
+#define SHADER_ARCHIVE_PATH "content/shaders.pak"
+
+#ifndef SHADER_SOURCE_DIRECTORY
+#define SHADER_SOURCE_DIRECTORY "content" // GLSL sources next to the executable, CMake points this at the source tree
+#endif
 
 int main() {
   Game* game = NULL; 
@@ -23,7 +43,9 @@ int main() {
   }
 
   Device* device = NULL;
-  DeviceResult device_result = device_new(&device);
+  DeviceResult device_result = device_new((DeviceOptions){
+    .pipeline_cache_path = PIPELINE_CACHE_PATH
+  }, &device);
   if (device_result != DEVICE_OK) {
     fprintf(stderr, "Failed to create device! %d\n", device_result);
     return -1;
@@ -43,7 +65,8 @@ int main() {
   SwapchainResult swapchain_result = swapchain_new(device, (SwapchainOptions){
     .oldSwapchain = NULL,
     .surface = surface,
-    .min_image_count = MAX_FRAMES_IN_FLIGHT,
+    .min_image_count = SWAPCHAIN_IMAGE_COUNT,
+    .present_mode = SWAPCHAIN_PRESENT_MODE,
     .format = COLOR_BGRA8_SRGB,
     .color_space = COLOR_SPACE_SRGB_NLINEAR
   }, &swapchain);
@@ -52,8 +75,23 @@ int main() {
     return -1;
   }
 
+  // A single pass scene, so depth never leaves the rendering and can stay in lazily allocated memory
+  DepthTarget* depth_target = NULL;
+  DepthTargetResult depth_target_result = depth_target_new(device, (DepthTargetOptions){
+    .format = DEPTH_FORMAT,
+    .prepass = false
+  }, &depth_target);
+  if (depth_target_result != DEPTH_TARGET_OK) {
+    fprintf(stderr, "Failed to create depth target! %d\n", depth_target_result);
+    return -1;
+  }
+
   Renderer* renderer = NULL;
-  RendererResult renderer_result = renderer_new(device, MAX_FRAMES_IN_FLIGHT, &renderer);
+  RendererResult renderer_result = renderer_new(device, (RendererOptions){
+    .max_frames_in_flight = MAX_FRAMES_IN_FLIGHT,
+    .transient_size = TRANSIENT_FRAME_SIZE,
+    .depth_target = depth_target
+  }, &renderer);
   if (renderer_result != RENDERER_OK) {
     fprintf(stderr, "Failed to create renderer! %d\n", renderer_result);
     return -1;
@@ -85,36 +123,52 @@ int main() {
   geometry_set_index(geometry, 2, 4);
   geometry_set_index(geometry, 3, 5);
 
-  Buffer* vertex_buffer = NULL;
-  BufferResult vertex_buffer_result = buffer_new(device, (BufferOptions){
-    .size = geometry->vertex_count * sizeof(Vertex),
-    .usage = BUFFER_VERTEX,
-    .sharing = SHARING_EXCLUSIVE,
-    .memory_access = MEMORY_ACCESS_CPU_TO_GPU,
-    .initial_data = geometry->vertices
-  }, &vertex_buffer);
-  if (vertex_buffer_result != BUFFER_OK) {
-    fprintf(stderr, "Failed to create vertex buffer! %d\n", vertex_buffer_result);
+  Uploader* uploader = NULL;
+  UploaderResult uploader_result = uploader_new(device, (UploaderOptions){
+    .staging_size = UPLOAD_STAGING_SIZE
+  }, &uploader);
+  if (uploader_result != UPLOADER_OK) {
+    fprintf(stderr, "Failed to create uploader! %d\n", uploader_result);
+    return -1;
+  }
+
+  GeometryPool* geometry_pool = NULL;
+  GeometryPoolResult geometry_pool_result = geometry_pool_new(device, (GeometryPoolOptions){
+    .max_vertices = GEOMETRY_POOL_VERTICES,
+    .max_indices = GEOMETRY_POOL_INDICES
+  }, &geometry_pool);
+  if (geometry_pool_result != GEOMETRY_POOL_OK) {
+    fprintf(stderr, "Failed to create geometry pool! %d\n", geometry_pool_result);
+    return -1;
+  }
+
+  GeometryRange quad_range;
+  GeometryUploadResult quad_upload_result = geometry_upload(device, geometry_pool, uploader, geometry, &quad_range);
+  if (quad_upload_result != GEOMETRY_UPLOAD_OK) {
+    fprintf(stderr, "Failed to upload geometry! %d\n", quad_upload_result);
+    return -1;
+  }
+
+  // Both copies go out in one submission, the first frame acquires them and waits for it to finish
+  UploadTicket geometry_ticket = 0;
+  UploadResult geometry_upload_result = uploader_submit(uploader, &geometry_ticket);
+  if (geometry_upload_result != UPLOAD_OK) {
+    fprintf(stderr, "Failed to submit geometry upload! %d\n", geometry_upload_result);
     return -1;
   }
 
-  Buffer* index_buffer = NULL;
-  BufferResult index_buffer_result = buffer_new(device, (BufferOptions){
-    .size = geometry->index_count * sizeof(u32),
-    .usage = BUFFER_INDEX,
-    .sharing = SHARING_EXCLUSIVE,
-    .memory_access = MEMORY_ACCESS_CPU_TO_GPU,
-    .initial_data = geometry->indices
-  }, &index_buffer);
-  if (index_buffer_result != BUFFER_OK) {
-    fprintf(stderr, "Failed to create index buffer! %d\n", index_buffer_result);
+  ShaderArchive* shader_archive = NULL;
+  ShaderArchiveResult shader_archive_result = shader_archive_open(SHADER_ARCHIVE_PATH, &shader_archive);
+  if (shader_archive_result != SHADER_ARCHIVE_OK) {
+    fprintf(stderr, "Failed to open shader archive! %d\n", shader_archive_result);
     return -1;
   }
 
   Shader* vertex_shader = NULL;
   ShaderResult vertex_shader_result = shader_new(device, (ShaderOptions){
-    .shader = "content/object.vert.spv",
-    .type = SHADER_VERTEX
+    .shader = "object.vert.spv",
+    .type = SHADER_VERTEX,
+    .archive = shader_archive
   }, &vertex_shader);
   if (vertex_shader_result != SHADER_OK) {
     fprintf(stderr, "Failed to create vertex shader! %d\n", vertex_shader_result);
@@ -123,18 +177,23 @@ int main() {
 
   Shader* fragment_shader = NULL;
   ShaderResult fragment_shader_result = shader_new(device, (ShaderOptions){
-    .shader = "content/object.frag.spv",
-    .type = SHADER_FRAGMENT
+    .shader = "object.frag.spv",
+    .type = SHADER_FRAGMENT,
+    .archive = shader_archive
   }, &fragment_shader);
   if (fragment_shader_result != SHADER_OK) {
     fprintf(stderr, "Failed to create fragment shader! %d\n", fragment_shader_result);
     return -1;
   }
+  shader_archive_close(shader_archive);
 
   Shader* shaders[2] = {vertex_shader, fragment_shader};
 
   PipelineLayout* layout = NULL;
-  PipelineLayoutResult layout_result = pipeline_layout_new(device, &layout);
+  PipelineLayoutResult layout_result = pipeline_layout_new(device, (PipelineLayoutOptions){
+    .push_constant_ranges = NULL,
+    .push_constant_range_count = 0
+  }, &layout);
   if (layout_result != PIPELINE_LAYOUT_OK) {
     fprintf(stderr, "Failed to create pipeline layout! %d\n", layout_result);
     return -1;
@@ -165,8 +224,17 @@ int main() {
   ColorFormat swapchain_color;
   swapchain_get_color_format(swapchain, &swapchain_color);
 
-  Pipeline* pipeline = NULL;
-  PipelineResult pipeline_result = pipeline_new(device, (PipelineOptions){
+  PipelineDepthStencilOptions depth_stencil;
+  depth_target_get_depth_stencil(depth_target, DEPTH_PASS_MAIN, &depth_stencil);
+
+  PipelineRegistry* pipeline_registry = NULL;
+  PipelineRegistryResult pipeline_registry_result = pipeline_registry_new(16, &pipeline_registry);
+  if (pipeline_registry_result != PIPELINE_REGISTRY_OK) {
+    fprintf(stderr, "Failed to create pipeline registry! %d\n", pipeline_registry_result);
+    return -1;
+  }
+
+  PipelineOptions pipeline_options = {
     .shader_stages = {
       .shaders = shaders,
       .shader_count = 2
@@ -206,18 +274,10 @@ int main() {
         swapchain_color
       },
       .color_count = 1,
-      .depth = DEPTH_UNDEFINED,
+      .depth = DEPTH_FORMAT,
       .stencil = DEPTH_UNDEFINED
     },
-    .depth_stencil = {
-      .depth_bounds_test = false,
-      .depth_test = false,
-      .max_depth_bounds = 0,
-      .min_depth_bounds = 0,
-      .depth_write = false,
-      .depth_compare_op = COMPARE_OP_LESS,
-      .stencil_test = false,
-    },
+    .depth_stencil = depth_stencil,
     .color_blending = {
       .blend = false,
       .logic_op_enable = false,
@@ -229,13 +289,51 @@ int main() {
                            COLOR_COMPONENT_B | COLOR_COMPONENT_A
       }
     },
-    .layout = layout
-  }, &pipeline);
+    .layout = layout,
+    .dynamic_state = PIPELINE_DYNAMIC_CULL_MODE | PIPELINE_DYNAMIC_FRONT_FACE
+  };
+
+  Pipeline* pipeline = NULL;
+  PipelineResult pipeline_result = pipeline_registry_acquire(device, pipeline_registry, pipeline_options, &pipeline);
   if (pipeline_result != PIPELINE_OK) {
     fprintf(stderr, "Failed to create pipeline! %d\n", pipeline_result);
     return -1;
   }
 
+  PipelineCompiler* pipeline_compiler = NULL;
+  PipelineCompilerResult pipeline_compiler_result = pipeline_compiler_new(device, (PipelineCompilerOptions){
+    .thread_count = 0
+  }, &pipeline_compiler);
+  if (pipeline_compiler_result != PIPELINE_COMPILER_OK) {
+    fprintf(stderr, "Failed to create pipeline compiler! %d\n", pipeline_compiler_result);
+    return -1;
+  }
+
+  // Hot reloaded copy of the pipeline, the registry's pipeline is drawn with until it's compiled
+  AsyncPipeline* async_pipeline = NULL;
+  pipeline_compiler_request(pipeline_compiler, pipeline_options, &async_pipeline);
+
+  // Hot reload is a convenience, the engine runs the same without it
+  ShaderWatcher* shader_watcher = NULL;
+  ShaderWatcherResult shader_watcher_result = shader_watcher_new((ShaderWatcherOptions){
+    .directory = SHADER_SOURCE_DIRECTORY
+  }, &shader_watcher);
+  if (shader_watcher_result == SHADER_WATCHER_OK) {
+    shader_watcher_watch(shader_watcher, vertex_shader, "object.vert");
+    shader_watcher_watch(shader_watcher, fragment_shader, "object.frag");
+  } else {
+    fprintf(stderr, "Shader hot reload is disabled! %d\n", shader_watcher_result);
+    shader_watcher = NULL;
+  }
+
+  Buffer* pool_vertex_buffer = NULL;
+  Buffer* pool_index_buffer = NULL;
+  geometry_pool_get_vertex_buffer(geometry_pool, &pool_vertex_buffer);
+  geometry_pool_get_index_buffer(geometry_pool, &pool_index_buffer);
+
+  RenderQueue* render_queue = NULL;
+  render_queue_new(64, &render_queue);
+
   while (game_is_alive(game)) {
     game_update(game);
     
@@ -251,6 +349,28 @@ int main() {
     void* cmd = NULL;
     renderer_get_frame_cmd(frame, &cmd);
 
+    u64 completed_value = 0;
+    u64 frame_value = 0;
+    renderer_get_completed_value(device, renderer, &completed_value);
+    renderer_get_frame_value(renderer, &frame_value);
+    if (shader_watcher) {
+      shader_watcher_update(device, shader_watcher, pipeline_compiler);
+    }
+    pipeline_compiler_update(device, pipeline_compiler, completed_value, frame_value);
+
+    Pipeline* draw_pipeline = NULL;
+    AsyncPipelineState draw_pipeline_state;
+    async_pipeline_get(async_pipeline, &draw_pipeline, &draw_pipeline_state);
+    if (draw_pipeline == NULL) {
+      draw_pipeline = pipeline;
+    }
+
+    UploadWait upload_wait;
+    uploader_acquire(uploader, cmd, &upload_wait);
+    if (upload_wait.value > 0) {
+      renderer_wait_semaphore(renderer, upload_wait.semaphore, upload_wait.value);
+    }
+
     Swapchain* current_swapchain = NULL;
     renderer_get_swapchain(renderer, &current_swapchain);
 
@@ -276,6 +396,9 @@ int main() {
       }
     };
 
+    VkRenderingAttachmentInfo depth_attachment;
+    depth_target_get_attachment(depth_target, DEPTH_PASS_MAIN, &depth_attachment);
+
     Extent swapchain_extent;
     swapchain_get_extent(swapchain, &swapchain_extent);
 
@@ -289,7 +412,7 @@ int main() {
       .colorAttachmentCount = 1,
       .pColorAttachments = &rendering_attachment,
       .pStencilAttachment = NULL,
-      .pDepthAttachment = NULL
+      .pDepthAttachment = &depth_attachment
     };
 
     vkCmdBeginRendering(cmd, &rendering_info);
@@ -307,23 +430,24 @@ int main() {
       .extent = {800, 600}
     };
 
-    void* vertex_buffer_handle = NULL;
-    void* index_buffer_handle = NULL;
-
-    buffer_get_buffer(vertex_buffer, &vertex_buffer_handle);
-    buffer_get_buffer(index_buffer, &index_buffer_handle);
-
-    void* pipeline_handle = NULL;
-    pipeline_get_pipeline(pipeline, &pipeline_handle);
-
-    VkDeviceSize offsets = 0;
-    
     vkCmdSetViewport(cmd, 0, 1, &viewport);
     vkCmdSetScissor(cmd, 0, 1, &scissor);
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_handle);
-    vkCmdBindVertexBuffers(cmd, 0, 1,(VkBuffer*)&vertex_buffer_handle, &offsets);
-    vkCmdBindIndexBuffer(cmd, index_buffer_handle, 0, VK_INDEX_TYPE_UINT32);
-    vkCmdDrawIndexed(cmd, geometry->index_count, 1, 0, 0, 0);
+
+    render_queue_submit(render_queue, (DrawPacket){
+      .pipeline = draw_pipeline,
+      .dynamic_values = {
+        .cull_mode = CULL_NONE,
+        .front_face_direction = FRONT_FACING_C_CLOCKWISE
+      },
+      .vertex_buffer = pool_vertex_buffer,
+      .index_buffer = pool_index_buffer,
+      .first = quad_range.first_index,
+      .count = quad_range.index_count,
+      .vertex_offset = quad_range.vertex_offset,
+      .instance_count = 1
+    });
+    render_queue_record(render_queue, cmd, NULL);
+    render_queue_clear(render_queue);
 
     vkCmdEndRendering(cmd);
     renderer_end_rendering(device, renderer);
@@ -331,14 +455,22 @@ int main() {
 
   device_wait(device);
 
+  if (shader_watcher) {
+    shader_watcher_free(shader_watcher);
+  }
+  pipeline_compiler_free(device, pipeline_compiler);
+
   geometry_free(geometry);
   shader_free(device, vertex_shader);
   shader_free(device, fragment_shader);
-  buffer_free(device, vertex_buffer);
-  buffer_free(device, index_buffer);
-  pipeline_free(device, pipeline);
+  geometry_pool_free(device, geometry_pool);
+  uploader_free(device, uploader);
+  render_queue_free(render_queue);
+  pipeline_registry_release(device, pipeline_registry, pipeline);
+  pipeline_registry_free(device, pipeline_registry);
   pipeline_layout_free(device, layout);
   renderer_free(device, renderer);
+  depth_target_free(device, depth_target);
   swapchain_free(device, swapchain);
   vkDestroySurfaceKHR(instance, surface, NULL);
   device_free(device);
@@ -0,0 +1,139 @@
+// Packs compiled shaders into one archive shader_archive_open can map, see src/graphics/shader_archive.h
+// Usage: pack_shaders <output> <shader.spv>...
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/graphics/shader_archive.h"
+
+typedef struct {
+    const char* path;
+    const char* name; // File name without the directory, what shaders are looked up by
+    ShaderArchiveEntry entry;
+    u8* data;
+} PackedShader;
+
+static const char* file_name(const char* path) {
+    const char* name = path;
+    for (const char* c = path; *c; c++) {
+        if (*c == '/' || *c == '\\') {
+            name = c + 1;
+        }
+    }
+    return name;
+}
+
+static bool read_file(const char* path, u8** out_data, u64* out_size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open shader %s!\n", path);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (file_size < 0) {
+        fprintf(stderr, "Failed to acquire file size from shader %s!\n", path);
+        fclose(file);
+        return false;
+    }
+
+    u8* data = malloc(file_size > 0 ? file_size : 1);
+    usize bytes_read = fread(data, 1, file_size, file);
+    fclose(file);
+    if (bytes_read != (usize)file_size) {
+        fprintf(stderr, "Bytes being read doesn't match file size from shader %s!\n", path);
+        free(data);
+        return false;
+    }
+
+    *out_data = data;
+    *out_size = (u64)file_size;
+    return true;
+}
+
+static int compare_shaders(const void* a, const void* b) {
+    u64 hash_a = ((const PackedShader*)a)->entry.name_hash;
+    u64 hash_b = ((const PackedShader*)b)->entry.name_hash;
+    return (hash_a > hash_b) - (hash_a < hash_b);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <output> <shader.spv>...\n", argv[0]);
+        return 1;
+    }
+
+    u32 shader_count = (u32)(argc - 2);
+    PackedShader* shaders = calloc(shader_count > 0 ? shader_count : 1, sizeof(PackedShader));
+    for (u32 i = 0; i < shader_count; i++) {
+        shaders[i].path = argv[i + 2];
+        shaders[i].name = file_name(shaders[i].path);
+        shaders[i].entry.name_hash = shader_archive_hash(shaders[i].name);
+        if (!read_file(shaders[i].path, &shaders[i].data, &shaders[i].entry.size)) {
+            return 1;
+        }
+        if (shaders[i].entry.size == 0 || shaders[i].entry.size % 4 != 0) {
+            fprintf(stderr, "Shader %s is %llu bytes, which isn't SPIR-V!\n", shaders[i].path, (unsigned long long)shaders[i].entry.size);
+            return 1;
+        }
+    }
+
+    qsort(shaders, shader_count, sizeof(PackedShader), compare_shaders);
+
+    u64 offset = sizeof(ShaderArchiveHeader) + shader_count * sizeof(ShaderArchiveEntry);
+    for (u32 i = 0; i < shader_count; i++) {
+        shaders[i].entry.name_offset = (u32)offset;
+        shaders[i].entry.name_size = (u32)strlen(shaders[i].name);
+        offset += shaders[i].entry.name_size;
+    }
+    u64 names_end = offset;
+
+    for (u32 i = 0; i < shader_count; i++) {
+        if (i > 0 && shaders[i].entry.name_hash == shaders[i - 1].entry.name_hash) {
+            fprintf(stderr, "Shaders %s and %s have the same name hash!\n", shaders[i - 1].path, shaders[i].path);
+            return 1;
+        }
+
+        offset = (offset + SHADER_ARCHIVE_ALIGNMENT - 1) & ~(u64)(SHADER_ARCHIVE_ALIGNMENT - 1);
+        shaders[i].entry.offset = offset;
+        offset += shaders[i].entry.size;
+    }
+
+    FILE* file = fopen(argv[1], "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open shader archive %s for writing!\n", argv[1]);
+        return 1;
+    }
+
+    ShaderArchiveHeader header = {
+        .magic = SHADER_ARCHIVE_MAGIC,
+        .version = SHADER_ARCHIVE_VERSION,
+        .entry_count = shader_count,
+        .reserved = 0
+    };
+    fwrite(&header, sizeof(header), 1, file);
+    for (u32 i = 0; i < shader_count; i++) {
+        fwrite(&shaders[i].entry, sizeof(ShaderArchiveEntry), 1, file);
+    }
+
+    for (u32 i = 0; i < shader_count; i++) {
+        fwrite(shaders[i].name, 1, shaders[i].entry.name_size, file);
+    }
+
+    u64 written = names_end;
+    static const u8 padding[SHADER_ARCHIVE_ALIGNMENT] = {0};
+    for (u32 i = 0; i < shader_count; i++) {
+        fwrite(padding, 1, shaders[i].entry.offset - written, file);
+        fwrite(shaders[i].data, 1, shaders[i].entry.size, file);
+        written = shaders[i].entry.offset + shaders[i].entry.size;
+        free(shaders[i].data);
+    }
+    free(shaders);
+
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Failed to write shader archive %s!\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}